@@ -0,0 +1,43 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include "common.h"
+
+// Cold store for finished auctions. A background compactor moves ITEM_SOLD records whose
+// end time is more than config.archive_after_s in the past out of the live segments and
+// into items_dir/archive.dat:
+//
+//   - the archive is append-only: a fixed header (id, seller, winner, encoding, length)
+//     followed by the record, LZ-compressed with the wire codec (codec.h)
+//   - it is made durable before anything is removed from the live store
+//   - the live slot is then zeroed (hole-punched where the filesystem supports it) and
+//     emptied in the read snapshot, so the hot working set follows the active auctions
+//
+// IDs never change: an archived ID simply resolves to the archive instead of its segment.
+// The archive is indexed in memory by ID and by seller/winner, rebuilt from the headers
+// at startup, so transaction history still reaches archived rows.
+
+// Function Prototypes
+
+/**
+ * Loads the archive index and starts the compactor (archive_after_s = 0 leaves it off).
+ * Returns 0, or -1 if the archive cannot be opened.
+ */
+int archive_init();
+
+/**
+ * Moves every eligible closed auction into the archive. Returns the number moved.
+ */
+int archive_compact();
+
+/**
+ * Archived auctions where user_id was the seller or the winner, most recently archived first.
+ */
+int archive_history(int user_id, Item *buffer, int max_items);
+
+/**
+ * 1 if the ID has been archived.
+ */
+int archive_contains(int item_id);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef AUTH_POOL_H
+#define AUTH_POOL_H
+
+// Password hashing is deliberately slow (scrypt, see kdf.h), so it runs on a small fixed
+// pool of auth threads instead of on whichever connection thread asked. The job queue is
+// bounded: when it is full, callers block until a slot frees up, which caps the CPU and
+// memory that a burst of logins can take (config.auth_threads x one scrypt table).
+//
+// Until auth_pool_start() is called (e.g. in bench_micro) the work runs inline.
+
+// Function Prototypes
+
+/**
+ * Starts config.auth_threads workers with a queue of config.auth_queue jobs.
+ */
+void auth_pool_start();
+
+/**
+ * Hashes `secret` with the configured cost (config.kdf_log_n, kdf_r, kdf_p).
+ * `out` must hold KDF_HASH_LEN + 1 bytes. Returns 0, or -1 on failure.
+ */
+int auth_hash(const char *secret, char *out);
+
+/**
+ * Returns 1 if `secret` matches the stored hash, 0 otherwise.
+ */
+int auth_verify(const char *secret, const char *stored);
+
+#endif
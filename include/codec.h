@@ -0,0 +1,60 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Wire encodings for multi-record replies (listings, my bids, history), shared by the
+// server and the client. DisplayItem / HistoryRecord are fixed-width with mostly-empty
+// char[50] fields, so a negotiated connection gets them in a compact form instead:
+//
+//   compact:  per record, varint (zigzag) integers and length-prefixed strings
+//   lz:       the compact bytes compressed with an LZ4-style block codec (in-tree)
+//
+// Negotiation: the client sends OP_HELLO with the WIRE_* flags it supports in the payload;
+// the server answers OP_SUCCESS with the flags it granted. Servers that predate OP_HELLO
+// answer with something else and the client stays on fixed-width records.
+//
+// With WIRE_COMPACT granted, a multi-record reply is a Response whose message is
+// "<count>|<bytes>", then a frame of <bytes>:
+//
+//   [method: 1 byte, CODEC_RAW or CODEC_LZ][compact length: varint][body]
+
+#define WIRE_COMPACT 1
+#define WIRE_LZ 2
+#define WIRE_SHM 4 // Not an encoding: move the connection onto shared memory (Unix socket only, see transport.h)
+
+#define RECORD_DISPLAY 0 // DisplayItem
+#define RECORD_HISTORY 1 // HistoryRecord
+
+#define CODEC_RAW 0
+#define CODEC_LZ 1
+#define CODEC_LZ_MIN_BYTES 128 // Smaller bodies are not worth compressing
+
+// Function Prototypes
+
+/**
+ * Upper bound on the frame size for `count` records; size the pack buffer with this.
+ */
+size_t codec_max_frame(int kind, int count);
+
+/**
+ * Encodes `count` records of `kind` into a frame, compressed if `flags` has WIRE_LZ
+ * and that makes it smaller. Returns the frame length.
+ */
+size_t codec_pack(int kind, const void *records, int count, int flags, uint8_t *out);
+
+/**
+ * Decodes a frame into `count` records. Returns 0, or -1 if the frame is malformed.
+ */
+int codec_unpack(int kind, const uint8_t *frame, size_t len, void *records, int count);
+
+/**
+ * LZ4 block format. lz_compress returns the compressed size, or 0 if the output
+ * would not be smaller than the input (or would not fit in `cap`).
+ * lz_decompress returns 0 if exactly `out_len` bytes were produced, -1 otherwise.
+ */
+size_t lz_compress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap);
+int lz_decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t out_len);
+
+#endif
@@ -2,9 +2,12 @@
 #define COMMON_H
 
 #define PORT 8085
+#define METRICS_PORT 9095 // Prometheus text endpoint, bound to 127.0.0.1 only
 #define BUFFER_SIZE 1024
 #define MAX_CLIENTS 10
 #define MAX_BIDDERS 20
+#define MAX_BULK_ENTRIES 1000 // Max entries in one bulk create/bid frame
+#define BID_INCREMENT 1 // Step a proxy bid raises the price by over its competitor
 
 // Operation Codes (Client -> Server)
 #define OP_LOGIN 1
@@ -22,6 +25,15 @@
 #define OP_CHECK_ACTIVE_BIDS 13
 #define OP_RESET_PASSWORD 14
 #define OP_FORGOT_PASSWORD 15
+#define OP_PROXY_BID 16
+#define OP_BULK_CREATE_ITEMS 17
+#define OP_BULK_BID 18
+#define OP_SEARCH_ITEMS 19
+#define OP_METRICS 20 // Admin only
+#define OP_LOCK_PROFILE 21 // Admin only
+#define OP_HELLO 22 // Payload: WIRE_* flags the client supports (see codec.h)
+#define OP_COND_BID 23 // Payload: "ItemID|Amount|ExpectedPrice|ExpectedVersion" (version 0 = any)
+                       // Reply message: "<code>|<price>|<version>", code as for OP_BID (1 = accepted)
 #define OP_SUCCESS 100
 #define OP_ERROR 101
 
@@ -52,11 +64,15 @@ typedef struct {
     int current_winner_id;  // Who has the highest bid (-1 if none)
     int base_price;
     int current_bid;        // Current highest price
+    int winner_max;         // Escrow held from the winner (proxy ceiling or plain bid)
     time_t end_time;        // Auction end time
     int status;             // ITEM_ACTIVE or ITEM_SOLD
     int past_bidders[MAX_BIDDERS];
     int past_bid_amounts[MAX_BIDDERS];
     int past_bidders_count;
+    int soft_close_window;  // Bids in the last N seconds extend the auction (0 = off)
+    int soft_close_extend;  // Seconds added to end_time per late bid
+    unsigned int version;   // Bumped on every write of the record (1 = as created)
 } Item;
 
 // Protocol Message
@@ -95,6 +111,23 @@ typedef struct {
     int my_bid_amount;
 } DisplayItem;
 
+// Bulk frames: a Request whose payload holds the entry count,
+// followed directly by that many entries. The reply is a Response
+// holding the count, followed by one int status per entry.
+typedef struct {
+    char name[50];
+    char description[100];
+    int base_price;
+    int duration_minutes;
+    int soft_close_window;
+    int soft_close_extend;
+} BulkItemEntry;
+
+typedef struct {
+    int item_id;
+    int amount;
+} BulkBidEntry;
+
 void get_username(int user_id, char *buffer);
 void hash_password(const char *str, char *output);
 
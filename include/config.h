@@ -0,0 +1,107 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdio.h>
+
+// Runtime settings. Each value comes from, in increasing precedence: the built-in
+// default, the config file (server.conf, or -c <file>), an AUCTION_<KEY> environment
+// variable, then --key=value on the command line.
+//
+// MAX_BIDDERS and BUFFER_SIZE stay compile-time: they size the on-disk Item record and
+// the wire structs, so changing them needs a rebuild of both client and server anyway.
+
+#define CONFIG_PATH_LEN 256
+#define DEFAULT_CONFIG_FILE "server.conf"
+
+// Durability of record writes
+#define SYNC_NONE 0     // Leave flushing to the kernel (original behaviour)
+#define SYNC_ALWAYS 1   // fdatasync after every record write
+#define SYNC_INTERVAL 2 // A background thread flushes the data files every sync_interval_ms
+
+// Storage backend for record reads and writes (see record_io.h)
+#define IO_BACKEND_AUTO 0   // io_uring when the kernel supports it, otherwise posix
+#define IO_BACKEND_POSIX 1  // pread / pwrite
+#define IO_BACKEND_URING 2  // io_uring or refuse to start
+
+// Same-host clients (see transport.h)
+#define LOCAL_TRANSPORT_OFF 0   // TCP only
+#define LOCAL_TRANSPORT_UNIX 1  // Also listen on unix_socket
+#define LOCAL_TRANSPORT_SHM 2   // ... and move clients that ask onto shared-memory rings
+
+typedef struct {
+    int port;
+    int backlog;            // listen() backlog, per listener
+    int listen_threads;     // SO_REUSEPORT listener threads (0 = one per CPU)
+    int max_clients;        // Concurrent logged-in sessions
+    int max_connections;    // Concurrent connection threads (0 = unlimited)
+    int monitor_batch;      // Auctions the monitor expires per wake-up
+    int bid_combining;      // Plain bids on one item are decided in combined passes
+    int sched_slots;        // Requests running at once, all classes (0 = no scheduling, see request_sched.h)
+    int sched_bid_slots;    // Per-class limits
+    int sched_account_slots;
+    int sched_scan_slots;
+    int sched_bid_weight;   // Per-class shares of contended slots
+    int sched_account_weight;
+    int sched_scan_weight;
+    int sync;               // SYNC_NONE / SYNC_ALWAYS / SYNC_INTERVAL
+    int sync_interval_ms;
+    int io_backend;         // IO_BACKEND_AUTO / IO_BACKEND_POSIX / IO_BACKEND_URING
+    int metrics_port;       // 0 disables the Prometheus listener
+    int local_transport;    // LOCAL_TRANSPORT_OFF / LOCAL_TRANSPORT_UNIX / LOCAL_TRANSPORT_SHM
+    char unix_socket[CONFIG_PATH_LEN];
+    int shm_ring_bytes;     // Data bytes in each direction of a shared-memory session
+    char users_file[CONFIG_PATH_LEN];
+    char items_file[CONFIG_PATH_LEN];   // Legacy single-file store, migrated into items_dir
+    char items_dir[CONFIG_PATH_LEN];    // Item segment files and their directory
+    char log_file[CONFIG_PATH_LEN];
+    char trace_file[CONFIG_PATH_LEN];
+    char lock_profile_file[CONFIG_PATH_LEN];
+    int lock_profile;           // Record lock profiler on/off
+    int lock_profile_interval;  // Seconds between dumps (0 = on demand only)
+    int trace;                  // Request tracing on/off
+    int trace_slow_us;          // Requests slower than this are written out
+    int trace_sample;           // Write every Nth slow request
+    int kdf_log_n;              // scrypt cost for new password hashes: N = 2^kdf_log_n
+    int kdf_r;                  // scrypt block size
+    int kdf_p;                  // scrypt parallelism
+    int auth_threads;           // Password hashing workers
+    int auth_queue;             // Hashing jobs that may wait before callers block
+    int connect_ip_rate;        // Token buckets (see rate_limit.h): per minute, 0 = off
+    int connect_ip_burst;
+    int login_ip_rate;
+    int login_ip_burst;
+    int login_user_rate;
+    int login_user_burst;
+    int rate_limit_idle_s;      // Idle buckets are dropped after this long
+    int zerocopy_min_bytes;     // Listing replies this large use MSG_ZEROCOPY (0 = never)
+    int wire_compression;       // Grant WIRE_LZ to clients that ask for it
+    int user_writeback_ms;      // Period of the user store's dirty-record write-back
+    int item_segment_items;     // Item records per segment file (fixed once the store exists)
+    int load_threads;           // Segments loaded in parallel at startup
+    int archive_after_s;        // Closed auctions older than this move to the archive (0 = never)
+    int archive_interval_s;     // Seconds between compactor passes
+} ServerConfig;
+
+extern ServerConfig config;
+
+// Function Prototypes
+
+/**
+ * Builds the configuration from the file, environment and command line.
+ * Returns 0 on success, 1 if --help or --print-config was printed, -1 on a bad file, option or value.
+ */
+int config_load(int argc, char *argv[]);
+
+/**
+ * Individual steps, for tools that parse their own options (e.g. bench_micro).
+ * config_load_file returns -1 if the file cannot be read or has a bad line.
+ */
+int config_load_file(const char *path);
+int config_apply_env();
+
+/**
+ * Writes every setting as "key = value" lines (the config file format).
+ */
+void config_print(FILE *out);
+
+#endif
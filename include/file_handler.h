@@ -11,8 +11,10 @@
  * type: F_WRLCK (Write/Exclusive) or F_RDLCK (Read/Shared)
  * offset: Byte offset where the record begins
  * size: Size of the record in bytes
+ * site: Name of the calling function, for the lock profiler (filled in by lock_record)
  */
-int lock_record(int fd, int type, off_t offset, size_t size);
+int lock_record_at(int fd, int type, off_t offset, size_t size, const char *site);
+#define lock_record(fd, type, offset, size) lock_record_at(fd, type, offset, size, __func__)
 
 /**
  * Releases a record-level lock.
@@ -22,4 +24,22 @@ int lock_record(int fd, int type, off_t offset, size_t size);
  */
 int unlock_record(int fd, off_t offset, size_t size);
 
+/**
+ * Reserves space for records at [offset, offset + len) without growing the file.
+ */
+void preallocate_records(int fd, off_t offset, off_t len);
+
+/**
+ * Zeroes records at [offset, offset + len), freeing their disk blocks where the
+ * filesystem can punch holes. Returns 0, or -1 on error.
+ */
+int release_records(int fd, off_t offset, off_t len);
+
+/**
+ * Sync policy (config.sync). Call sync_record_write after each record write;
+ * start_sync_thread starts the periodic flusher when the policy is "interval".
+ */
+void sync_record_write(int fd);
+void start_sync_thread();
+
 #endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+// HDR-style log-linear latency histogram: 16 linear sub-buckets per power of two
+// (~6% relative error), covering 0 ns up to ~68 s. Values above the range land in the last bucket.
+#define HIST_SUB_BITS 4
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_MAX_EXP 36
+#define HIST_BUCKETS ((HIST_MAX_EXP - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+} Histogram;
+
+// Function Prototypes
+void hist_record(Histogram *h, uint64_t value_ns);
+void hist_merge(Histogram *into, const Histogram *from);
+
+/**
+ * Value at the given percentile (0-100), reported as the upper edge of its bucket.
+ */
+uint64_t hist_percentile(const Histogram *h, double percentile);
+
+/**
+ * Bucket helpers (used when exporting buckets, e.g. Prometheus "le" labels)
+ */
+int hist_bucket_index(uint64_t value_ns);
+uint64_t hist_bucket_upper(int index);
+
+#endif
@@ -3,13 +3,31 @@
 
 #include "common.h"
 
-int create_item(char *name, char *desc, int base_price, int duration_minutes, int seller_id);
+// OP_COND_BID: the bid goes through only if the item still shows the price (and, when
+// expected_version is nonzero, the version) the client last saw. Either way price and
+// version are filled in with the item's state after the attempt, so a client that lost
+// the race can retry straight away.
+typedef struct {
+    int expected_price;
+    unsigned int expected_version; // 0 = price only
+    int price;                     // Out
+    unsigned int version;          // Out (0 if the item could not be read)
+} BidCondition;
+
+int create_item(char *name, char *desc, int base_price, int duration_minutes, int seller_id,
+                int soft_close_window, int soft_close_extend);
+int create_items_bulk(BulkItemEntry *entries, int count, int seller_id, int *status);
 int get_all_items(Item *buffer, int max_items);
 int place_bid(int item_id, int user_id, int bid_amount);
+int place_proxy_bid(int item_id, int user_id, int max_amount);
+int place_conditional_bid(int item_id, int user_id, int bid_amount, BidCondition *cond); // -9 on a mismatch
+void place_bids_bulk(BulkBidEntry *entries, int count, int user_id, int *status);
 int close_auction(int item_id, int seller_id);
+int search_items(const char *query, Item *buffer, int max_items);
 int get_my_bids(int user_id, Item *buffer, int max_items);
 int get_transaction_history(int user_id, Item *buffer, int max_items);
 int is_user_seller(int user_id);
+void init_items();
 void check_expired_items();
 int withdraw_bid(int item_id, int user_id);
 int has_active_bids(int user_id);
@@ -0,0 +1,71 @@
+#ifndef ITEM_STORE_H
+#define ITEM_STORE_H
+
+#include <sys/types.h>
+#include "common.h"
+
+// Item records are partitioned by ID range into segment files under config.items_dir:
+//
+//   items_dir/segments.dir     directory: segment size and number of segments
+//   items_dir/seg-00000.dat    IDs 1 .. S
+//   items_dir/seg-00001.dat    IDs S+1 .. 2S, and so on
+//
+// S (config.item_segment_items) is fixed when the store is created and recorded in the
+// directory, so changing the setting later does not move existing records. Within a
+// segment a record sits at ((id - 1) % S) * sizeof(Item), and record locks work exactly
+// as they did on the single file; they just never span two segments.
+//
+// A legacy single items_file is migrated into segments on first start and renamed to
+// <items_file>.migrated.
+
+// Function Prototypes
+
+/**
+ * Opens (or creates, or migrates into) the segment store. Returns 0, or -1 on error.
+ */
+int item_store_init();
+
+/**
+ * Opens the segment holding `item_id` with open(2) `flags`; the caller closes the fd.
+ * Each call gets its own open file description, so OFD record locks taken through it
+ * exclude other threads. Returns -1 if the segment does not exist.
+ */
+int item_store_open(int item_id, int flags);
+
+/**
+ * record_io slot of the segment holding `item_id` (kept open by the store), or -1.
+ * Record data goes through this; the lock still needs a descriptor from item_store_open.
+ */
+int item_store_file(int item_id);
+
+/**
+ * Position of the record within its segment.
+ */
+off_t item_store_offset(int item_id);
+
+/**
+ * Segment number of an ID, and the last ID that segment can hold.
+ */
+int item_store_segment_of(int item_id);
+int item_store_segment_last_id(int segment);
+
+/**
+ * Makes sure the segments for a freshly claimed ID range exist, and reserves disk
+ * space ahead of the range a block at a time.
+ */
+void item_store_reserve(int first_id, int last_id);
+
+/**
+ * Reads every segment, several at a time, passing each batch of written records to
+ * `fn` (called from multiple threads). Returns the highest slot seen, which is where
+ * ID allocation resumes.
+ */
+typedef void (*ItemLoadFn)(Item *items, int count);
+int item_store_load(ItemLoadFn fn);
+
+/**
+ * fdatasync on every segment (sync = interval).
+ */
+void item_store_sync();
+
+#endif
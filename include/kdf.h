@@ -0,0 +1,40 @@
+#ifndef KDF_H
+#define KDF_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Password hashing with scrypt (RFC 7914), implemented in-tree on top of SHA-256.
+// Stored form fits the 50-byte User.password / User.security_answer fields:
+//
+//     $s$<logN:2 hex><r:2 hex><p:1 hex>$<salt: 16 base64>$<hash: 22 base64>   (48 chars)
+//
+// Anything not starting with '$' is a legacy DJB2 hash from before this format.
+
+#define KDF_HASH_LEN 48
+
+// Function Prototypes
+
+/**
+ * Hashes `secret` with a fresh random salt and the given cost (N = 2^log_n).
+ * `out` must hold KDF_HASH_LEN + 1 bytes. Returns 0, or -1 on bad parameters / no memory.
+ */
+int kdf_hash(const char *secret, int log_n, int r, int p, char *out);
+
+/**
+ * Returns 1 if `secret` matches `stored` (either format), 0 otherwise.
+ */
+int kdf_verify(const char *secret, const char *stored);
+
+/**
+ * Returns 1 if `stored` is a legacy hash or uses different cost parameters.
+ */
+int kdf_needs_rehash(const char *stored, int log_n, int r, int p);
+
+/**
+ * Raw scrypt, exposed for testing against the RFC 7914 vectors.
+ */
+int kdf_scrypt(const uint8_t *pass, size_t pass_len, const uint8_t *salt, size_t salt_len,
+               uint64_t n, uint32_t r, uint32_t p, uint8_t *out, size_t out_len);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef LISTING_H
+#define LISTING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "transport.h"
+
+// The OP_LIST_ITEMS reply (Response header + DisplayItem rows), serialized once per catalog
+// snapshot version and shared by every connection that asks for it. Blobs are immutable
+// and reference counted; a new one is built only when an item write publishes a new
+// snapshot, reusing the previous rows (and their resolved winner names) where possible.
+//
+// Connections that negotiated a compact encoding (codec.h) get a frame encoded from the same
+// rows, built at most once per blob and encoding.
+//
+// Blobs of at least config.zerocopy_min_bytes go out with MSG_ZEROCOPY when the socket
+// supports it; the blob stays pinned until the kernel reports the send complete. Connections
+// on the Unix socket or shared memory (transport.h) always get a plain copy.
+
+#define LISTING_MAX_ITEMS 50
+#define LISTING_ZC_PENDING 16 // Zero-copy sends in flight per connection
+
+typedef struct ListingBlob ListingBlob;
+
+// Per-connection zero-copy bookkeeping
+typedef struct {
+    Transport *transport;
+    int sock;              // transport->sock
+    int zerocopy;          // SO_ZEROCOPY enabled on this socket
+    int wire;              // WIRE_* flags negotiated with OP_HELLO (0 = fixed-width rows)
+    uint32_t issued;       // Zero-copy sends made (the kernel numbers them from 0)
+    uint32_t completed;    // Sends the kernel has reported done, in order
+    ListingBlob *pending[LISTING_ZC_PENDING]; // Indexed by send number % LISTING_ZC_PENDING
+} ListingConn;
+
+// Function Prototypes
+
+/**
+ * Pins the blob for the current catalog, rebuilding it first if items have changed.
+ * Must be paired with listing_release().
+ */
+ListingBlob *listing_acquire();
+void listing_release(ListingBlob *blob);
+const void *listing_data(const ListingBlob *blob, size_t *len);
+
+/**
+ * The same reply in the given WIRE_* encoding (0 = fixed-width, as listing_data).
+ * Returns NULL if it could not be built.
+ */
+const void *listing_encoded(ListingBlob *blob, int wire, size_t *len);
+
+/**
+ * Per-connection setup and teardown. listing_conn_close() waits (briefly) for
+ * outstanding zero-copy sends so their blobs can be released.
+ */
+void listing_conn_init(ListingConn *lc, Transport *t);
+void listing_conn_close(ListingConn *lc);
+
+/**
+ * Sends the current listing on the connection. Returns 0, or -1 if it could not all be
+ * sent; the peer may then have part of a reply, so the caller should drop the connection.
+ */
+int listing_send(ListingConn *lc);
+
+#endif
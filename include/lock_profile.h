@@ -0,0 +1,34 @@
+#ifndef LOCK_PROFILE_H
+#define LOCK_PROFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// Optional record-lock contention profiler. Off unless config.lock_profile is set
+// (AUCTION_LOCK_PROFILE=1); when off, lock_record pays a single branch.
+// Stats are kept per lock site (calling function + lock type) and per locked range
+// (file + offset + length).
+
+// Function Prototypes
+
+/**
+ * Reads config.lock_profile and config.lock_profile_interval (seconds between
+ * dumps to config.lock_profile_file, 0 = on demand only). Call once at startup.
+ */
+void lock_profile_init();
+int lock_profile_enabled();
+
+/**
+ * Called by lock_record / unlock_record.
+ */
+void lock_profile_acquired(int fd, int type, off_t offset, size_t size, const char *site, uint64_t wait_ns);
+void lock_profile_released(int fd, off_t offset, size_t size);
+
+/**
+ * Renders the site table and the most contended ranges as text.
+ * Returns a malloc'd buffer (caller frees) and its length in *len.
+ */
+char *lock_profile_render(size_t *len);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Server metrics. Every thread records into its own block (no locks on the hot path);
+// blocks are linked into a lock-free list and summed only when someone reads them.
+// Blocks of exited threads are recycled, so counters stay cumulative.
+
+#define METRICS_MAX_OP 32 // Opcodes 1..31 get their own slot; anything else counts as "unknown"
+
+// Function Prototypes
+uint64_t metrics_now_ns();
+const char *metrics_op_name(int op); // Short opcode name, "unknown" for anything unrecognised
+
+/**
+ * Records one handled request: its opcode and the time since `start_ns` (metrics_now_ns()).
+ */
+void metrics_record_request(int op, uint64_t start_ns);
+
+void metrics_record_lock_wait(uint64_t wait_ns);
+void metrics_record_queue_wait(int cls, uint64_t wait_ns); // RC_* class (request_sched.h)
+void metrics_record_monitor_tick(uint64_t tick_ns, int expired);
+
+void metrics_connection_opened();
+void metrics_connection_closed();
+
+/**
+ * Renders every metric in the Prometheus text format.
+ * Returns a malloc'd, NUL-terminated buffer (caller frees) and its length in *len.
+ */
+char *metrics_render(size_t *len);
+
+/**
+ * Starts a thread serving metrics_render() over HTTP on 127.0.0.1:port.
+ * Returns 0 on success, -1 if the port could not be bound.
+ */
+int metrics_start_listener(int port);
+
+#endif
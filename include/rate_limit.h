@@ -0,0 +1,36 @@
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include <stdint.h>
+
+// In-memory token buckets that reject abusive traffic before it reaches users.dat.
+// Each limit has its own table keyed by a string (source IP or username). A bucket holds
+// up to `burst` tokens and refills at `rate` tokens per minute; a request spends one.
+// Buckets idle for config.rate_limit_idle_s seconds are dropped by a sweeper thread.
+// A rate of 0 turns that limit off.
+
+#define RL_CONNECT_IP 0  // New connections per source IP (accept loop)
+#define RL_LOGIN_IP 1    // OP_LOGIN / OP_FORGOT_PASSWORD attempts per source IP
+#define RL_LOGIN_USER 2  // Attempts per target username, whatever the source
+#define RL_LIMITS 3
+
+// Function Prototypes
+
+/**
+ * Starts the idle-bucket sweeper. Rates come from config (see config.h).
+ */
+void rate_limit_init();
+
+/**
+ * Takes one token from `key`'s bucket in `limit`.
+ * Returns 1 if the request may go ahead, 0 if it should be rejected.
+ */
+int rate_limit_allow(int limit, const char *key);
+
+/**
+ * Rejections per limit since startup, and the limit's name (for metrics).
+ */
+uint64_t rate_limit_rejected(int limit);
+const char *rate_limit_name(int limit);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef RECORD_IO_H
+#define RECORD_IO_H
+
+#include <sys/types.h>
+
+// Storage reads and writes for the record files (users.dat, the item segments, the archive).
+// Files are registered once and stay open for the life of the process; callers name them
+// by the slot record_io_register returned. Two backends (config.io_backend):
+//
+//   - io_uring: each thread gets its own small ring with every registered file attached
+//     as a fixed file, so a batch of record operations costs one system call
+//   - posix: plain pread / pwrite / fdatasync, used when io_uring is off or unavailable
+//
+// Record locks are unaffected: they are still taken on a descriptor the caller opened
+// (see file_handler.h). Both backends operate on the same files, so data written by one
+// is immediately visible to the other.
+
+#define RECORD_FILES_MAX 16448   // Every item segment, plus users.dat and the archive
+
+// Operation kinds
+#define RECORD_READ 0
+#define RECORD_WRITE 1
+#define RECORD_SYNC 2   // fdatasync; runs after every operation before it in the batch
+
+typedef struct {
+    int kind;        // RECORD_READ / RECORD_WRITE / RECORD_SYNC
+    int file;        // Slot from record_io_register
+    void *buf;
+    size_t len;
+    off_t offset;
+    ssize_t result;  // Bytes transferred (0 for a sync), or -errno
+} RecordOp;
+
+// Function Prototypes
+
+/**
+ * Picks the backend from config.io_backend. Returns 0, or -1 if io_uring was
+ * required and cannot be used.
+ */
+int record_io_init();
+
+/**
+ * "io_uring" or "posix".
+ */
+const char *record_io_backend();
+
+/**
+ * Keeps `fd` open for good and returns its slot, or -1 if the table is full.
+ */
+int record_io_register(int fd);
+
+/**
+ * Single-record read and write. Return bytes transferred, or -1 with errno set.
+ */
+ssize_t record_read(int file, void *buf, size_t len, off_t offset);
+ssize_t record_write(int file, const void *buf, size_t len, off_t offset);
+
+/**
+ * Runs a batch of operations and waits for all of them. Each op's result is filled in.
+ * Returns 0 if every operation transferred its full length, -1 otherwise.
+ */
+int record_io_submit(RecordOp *ops, int count);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef REQUEST_SCHED_H
+#define REQUEST_SCHED_H
+
+#include <stdint.h>
+
+// Admission for request handlers. Each opcode belongs to a class, and a connection thread
+// takes a slot in its request's class before running the handler. At most
+// config.sched_slots requests run at once overall, and at most the class limit
+// (config.sched_*_slots) from any one class. Requests that cannot start queue FIFO
+// per class. When a slot frees, the classes with eligible waiters share it by weighted
+// round robin (config.sched_*_weight), highest priority first within a round. So a wave
+// of listings waits behind bids instead of beside them, and it still gets its share.
+//
+// Logins, registrations and password changes are not scheduled: auth_pool.h already
+// bounds them, and holding a slot through an scrypt hash would starve everyone else.
+// Neither are OP_HELLO, OP_EXIT or the admin opcodes. sched_slots = 0 turns
+// scheduling off.
+
+#define RC_NONE -1    // Not scheduled
+#define RC_BID 0      // Bids (plain, proxy, conditional, bulk), withdrawals, closes
+#define RC_ACCOUNT 1  // Balance and small per-user lookups, single creates
+#define RC_SCAN 2     // Listings, search, bid and transaction history, bulk creates
+#define RC_CLASSES 3
+
+// Function Prototypes
+
+/**
+ * Reads the slot limits and weights from config.
+ */
+void request_sched_init();
+
+/**
+ * The class an opcode is scheduled in, or RC_NONE.
+ */
+int request_class(int op);
+
+/**
+ * Blocks until a request of class `cls` may run and takes its slot.
+ * Returns the time spent queued in ns (0 for RC_NONE, or when scheduling is off).
+ */
+uint64_t request_sched_enter(int cls);
+
+/**
+ * Gives the slot back and starts the next queued request, if any.
+ */
+void request_sched_leave(int cls);
+
+/**
+ * Requests of the class running and queued right now, and its name (for metrics).
+ */
+int request_sched_running(int cls);
+int request_sched_queued(int cls);
+const char *request_class_name(int cls);
+
+#endif
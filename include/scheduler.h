@@ -0,0 +1,27 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <time.h>
+
+// Function Prototypes
+
+/**
+ * Adds an item to the expiry queue, or moves it if it is already queued.
+ * item_id: Item to track
+ * end_time: Absolute time at which the auction should close
+ */
+void schedule_item(int item_id, time_t end_time);
+
+/**
+ * Removes an item from the expiry queue (e.g. after a manual close).
+ */
+void unschedule_item(int item_id);
+
+/**
+ * Blocks until at least one queued item has reached its end time, then
+ * pops up to max_ids due items into ids.
+ * Returns the number of item IDs written.
+ */
+int wait_for_expired(int *ids, int max_ids);
+
+#endif
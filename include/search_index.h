@@ -0,0 +1,22 @@
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include "common.h"
+
+// Function Prototypes
+
+/**
+ * Brings the index in line with an item record: active items are indexed
+ * (or have their end time refreshed), closed items are pruned.
+ */
+void search_index_item(const Item *item);
+
+/**
+ * Finds active items whose name or description contains every query word.
+ * The last query word also matches as a prefix ("lam" finds "lamp").
+ * Results are ordered by end time, soonest first.
+ * Returns the number of item IDs written to ids.
+ */
+int search_index_query(const char *query, int *ids, int max_ids);
+
+#endif
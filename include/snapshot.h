@@ -0,0 +1,46 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "common.h"
+
+// An immutable, versioned view of every item record.
+// Readers pin one with snapshot_acquire() and never take a file lock;
+// writers publish a new version after each item write.
+typedef struct CatalogSnapshot CatalogSnapshot;
+
+// Function Prototypes
+
+/**
+ * Pins the current snapshot. Must be paired with snapshot_release().
+ */
+CatalogSnapshot *snapshot_acquire();
+void snapshot_release(CatalogSnapshot *snap);
+
+/**
+ * Number of item slots (highest item ID) and the record for slot index (id - 1).
+ */
+int snapshot_count(const CatalogSnapshot *snap);
+const Item *snapshot_get(const CatalogSnapshot *snap, int index);
+unsigned long snapshot_version(const CatalogSnapshot *snap);
+
+/**
+ * First slot index >= index that holds a record (id != 0), or snapshot_count() if none.
+ * Ranges with no live record (archived, or never written) are skipped a subtree at a
+ * time, so a scan costs what is live, not every ID ever allocated.
+ */
+int snapshot_next(const CatalogSnapshot *snap, int index);
+
+/**
+ * Publishes new versions of item records (copy-on-write of the touched chunks).
+ * Call while still holding the record's write lock so versions stay in order.
+ */
+void snapshot_publish_item(const Item *item);
+void snapshot_publish_items(const Item *items, int count);
+
+/**
+ * Publishes a version with these IDs emptied (id 0), for records moved out of the
+ * live store. Call with no record lock held; the records must no longer change.
+ */
+void snapshot_remove_items(const int *ids, int count);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Request tracing. Each request gets an ID and a list of timed stage spans, kept in a
+// per-thread ring of recent requests. Requests slower than the threshold are appended
+// to config.trace_file in Chrome trace-event format (open it in chrome://tracing or Perfetto).
+//
+// Off unless config.trace is set. config.trace_slow_us sets the threshold and
+// config.trace_sample=N writes only every Nth slow request.
+
+// Function Prototypes
+void trace_init();
+int trace_enabled();
+
+/**
+ * Starts tracing a request on this thread. `received_ns` (metrics_now_ns()) is when
+ * its first byte arrived, so the receive stage is covered too.
+ */
+void trace_request_begin(int op, uint64_t received_ns);
+void trace_request_end();
+
+/**
+ * Stage spans. trace_span_begin() returns 0 when no request is being traced,
+ * and trace_span_end() ignores a 0 start, so the pair costs one branch when off.
+ *
+ *     uint64_t span = trace_span_begin();
+ *     update_balance(...);
+ *     trace_span_end("escrow", span);
+ */
+uint64_t trace_span_begin();
+void trace_span_end(const char *stage, uint64_t start_ns);
+
+/**
+ * Same, with a detail string (e.g. the lock site) shown in the span's args.
+ * Both strings must outlive the request: use literals or __func__.
+ */
+void trace_span_end_detail(const char *stage, const char *detail, uint64_t start_ns);
+
+#endif
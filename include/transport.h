@@ -0,0 +1,91 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+// A client connection's byte stream. It starts on the accepted socket: TCP, or the Unix
+// socket at config.unix_socket for clients on the same host. A client on the Unix socket
+// may offer WIRE_SHM in OP_HELLO. If the server grants it, the HELLO reply is followed by
+// one byte carrying a memfd (SCM_RIGHTS), and from then on both directions run through
+// two rings in that memory. The rings carry exactly the bytes the socket would have
+// (the same Request / Response protocol):
+//
+//   [ShmHeader][request ring: ShmRing, ring_bytes of data][response ring: ShmRing, data]
+//
+// Each ring has one writer and one reader. head and tail count bytes and only grow
+// (mod 2^32); ring_bytes is a power of two. The writer copies in at tail and advances
+// it, the reader copies out at head and advances it. A side with nothing to do spins
+// briefly, then sets its *_waiting flag and futex-waits on the counter it needs to move
+// (tail for a reader, head for a writer); the other side wakes it after advancing.
+// The socket stays open for the life of the session: closing it ends the session.
+
+#define SHM_MAGIC "AUCSHM01"
+
+typedef struct {
+    _Atomic uint32_t head;            // Bytes consumed
+    _Atomic uint32_t tail;            // Bytes produced
+    _Atomic uint32_t reader_waiting;  // Reader is asleep (or about to be) on tail
+    _Atomic uint32_t writer_waiting;  // Writer is asleep (or about to be) on head
+    uint8_t pad[48];                  // Data starts on its own cache line
+} ShmRing;
+
+typedef struct {
+    char magic[8];
+    uint32_t ring_bytes;       // Data bytes per ring
+    uint32_t request_offset;   // Ring offsets from the start of the mapping
+    uint32_t response_offset;
+    uint8_t pad[44];
+} ShmHeader;
+
+typedef struct ShmChannel ShmChannel;
+
+typedef struct {
+    int sock;
+    int local;          // Unix socket: shared memory can be offered
+    ShmChannel *shm;    // Set once the connection runs over shared memory
+    ShmChannel *offer;  // Mapped by transport_shm_offer, not yet handed over
+} Transport;
+
+// Function Prototypes
+
+/**
+ * Wraps a connected socket.
+ */
+void transport_init(Transport *t, int sock);
+
+/**
+ * Reads exactly `len` bytes. Returns len, 0 if the peer closed, or -1 on error.
+ */
+int transport_recv(Transport *t, void *buf, size_t len);
+
+/**
+ * Blocks until at least one byte can be read. Returns 1, or 0 if the peer closed.
+ */
+int transport_wait_readable(Transport *t);
+
+/**
+ * Writes all `len` bytes. Returns len, or -1 if the peer is gone.
+ */
+int transport_send(Transport *t, const void *buf, size_t len);
+
+/**
+ * Server side. transport_shm_offer maps a fresh channel with rings of `ring_bytes`
+ * (rounded up to a power of two); grant WIRE_SHM only if it returns 0. After the HELLO
+ * reply has gone out, transport_shm_start passes the memfd and switches over.
+ */
+int transport_shm_offer(Transport *t, size_t ring_bytes);
+int transport_shm_start(Transport *t);
+
+/**
+ * Client side: after a HELLO reply granting WIRE_SHM, receives the memfd and switches over.
+ */
+int transport_shm_attach(Transport *t);
+
+/**
+ * Unmaps any channel and closes the socket.
+ */
+void transport_close(Transport *t);
+
+#endif
@@ -1,9 +1,12 @@
 #ifndef USER_HANDLER_H
 #define USER_HANDLER_H
 
+// Call init_users() (user_store.h) before any of these.
+
 int register_user(const char *username, const char *password, int role, int initial_balance, const char *sec_answer);
 int authenticate_user(const char *username, const char *password);
 int get_user_balance(int user_id);
+int get_user_role(int user_id);
 int transfer_funds(int from_user_id, int to_user_id, int amount);
 int update_balance(int user_id, int amount_change);
 int get_user_cooldown(int user_id);
@@ -0,0 +1,67 @@
+#ifndef USER_STORE_H
+#define USER_STORE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "common.h"
+
+// Every user record, held in memory for the life of the server. users.dat is loaded once
+// by init_users() and from then on the store is its only writer:
+//
+//   - each record has its own mutex (ordered by ID when taking two, as in transfer_funds)
+//   - changed records are marked dirty and written back by a background thread every
+//     config.user_writeback_ms as one record_io batch, or immediately (with fdatasync)
+//     when sync = always
+//   - new users take the next ID from an atomic counter and are written through to their
+//     own slot, so registrations run in parallel; a user becomes visible once
+//     its record is on disk. Slots are preallocated a chunk at a time.
+//
+// Usernames are resolved through a hash map instead of a scan of users.dat.
+
+typedef struct {
+    pthread_mutex_t lock;
+    User rec;
+    int dirty;   // Queued for write-back
+    atomic_int live; // Record is on disk; user_store_get ignores the entry until then
+} UserEntry;
+
+// Function Prototypes
+
+/**
+ * Loads config.users_file and starts the write-back thread. Returns 0, or -1 on error.
+ */
+int init_users();
+
+/**
+ * The entry for a user ID, or NULL if there is no such user.
+ * Entries never move or go away, so the pointer stays valid.
+ */
+UserEntry *user_store_get(int user_id);
+
+/**
+ * One past the highest ID handed out so far.
+ */
+int user_store_next_id();
+
+/**
+ * The ID registered under `username`, or -1.
+ */
+int user_store_find(const char *username);
+
+/**
+ * Registers a new user (rec->id is assigned). Returns the ID, -2 if the username is
+ * taken, or -1 if the record could not be written.
+ */
+int user_store_add(User *rec);
+
+/**
+ * Records a change to an entry. Call with entry->lock held.
+ */
+void user_store_mark_dirty(UserEntry *entry);
+
+/**
+ * Writes every dirty record now (the write-back thread does this periodically).
+ */
+void user_store_flush();
+
+#endif
@@ -0,0 +1,408 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "config.h"
+#include "file_handler.h"
+#include "item_store.h"
+#include "snapshot.h"
+#include "codec.h"
+#include "logger.h"
+#include "archive.h"
+#include "record_io.h"
+
+#define ARCHIVE_MAGIC "AUCARC02"  // 02: Item records carry a version
+#define ARCHIVE_BATCH 1024                            // Records per append and fdatasync
+#define ARCHIVE_MAX_DATA (sizeof(Item) + sizeof(Item) / 255 + 16) // Worst-case LZ output
+
+typedef struct {
+    int id;
+    int seller_id;
+    int winner_id;   // -1 if the auction closed without bids
+    int method;      // CODEC_RAW or CODEC_LZ
+    int length;      // Bytes of record data that follow
+} ArchiveHeader;
+
+typedef struct {
+    ArchiveHeader header;
+    off_t offset;    // Where the record data starts
+} IndexEntry;
+
+// Auctions a user sold or won, as indexes into entries[]
+typedef struct {
+    int user_id;     // 0 = free slot
+    int count, capacity;
+    int *entries;
+} UserList;
+
+static int archive_fd = -1;
+static int archive_file = -1;   // Its record_io slot
+static off_t archive_end = 0;   // Append point; only the compactor moves it
+
+// The whole index sits under one rwlock: the compactor writes once per batch
+static pthread_rwlock_t index_lock = PTHREAD_RWLOCK_INITIALIZER;
+static IndexEntry *entries = NULL;
+static int entry_count = 0, entry_capacity = 0;
+static int *id_slots = NULL;        // ID -> entry, open addressing (-1 = empty)
+static size_t id_capacity = 0;      // Power of two
+static UserList *user_lists = NULL; // user ID -> UserList, open addressing
+static size_t user_capacity = 0, user_used = 0;
+
+static size_t hash_int(int key) {
+    return (uint32_t)key * 2654435761u;
+}
+
+// Caller holds index_lock
+static int find_id(int item_id) {
+    if (id_capacity == 0) return -1;
+    for (size_t i = hash_int(item_id) & (id_capacity - 1); id_slots[i] != -1; i = (i + 1) & (id_capacity - 1)) {
+        if (entries[id_slots[i]].header.id == item_id) return id_slots[i];
+    }
+    return -1;
+}
+
+// Points the ID at entry e (a re-archived ID moves to its newest copy)
+static int index_id(int e) {
+    if ((size_t)entry_count * 2 > id_capacity) {
+        size_t capacity = id_capacity ? id_capacity * 2 : 1024;
+        int *slots = malloc(capacity * sizeof(int));
+        if (slots == NULL) return -1;
+        memset(slots, 0xff, capacity * sizeof(int));
+        int *old = id_slots;
+        size_t old_capacity = id_capacity;
+        id_slots = slots;
+        id_capacity = capacity;
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old[i] != -1) index_id(old[i]);
+        }
+        free(old);
+    }
+    size_t i = hash_int(entries[e].header.id) & (id_capacity - 1);
+    while (id_slots[i] != -1 && entries[id_slots[i]].header.id != entries[e].header.id) {
+        i = (i + 1) & (id_capacity - 1);
+    }
+    id_slots[i] = e;
+    return 0;
+}
+
+static UserList *find_user(int user_id) {
+    if (user_capacity == 0) return NULL;
+    for (size_t i = hash_int(user_id) & (user_capacity - 1); user_lists[i].user_id != 0; i = (i + 1) & (user_capacity - 1)) {
+        if (user_lists[i].user_id == user_id) return &user_lists[i];
+    }
+    return NULL;
+}
+
+static UserList *add_user(int user_id) {
+    UserList *list = find_user(user_id);
+    if (list) return list;
+
+    if ((user_used + 1) * 2 > user_capacity) {
+        size_t capacity = user_capacity ? user_capacity * 2 : 256;
+        UserList *grown = calloc(capacity, sizeof(UserList));
+        if (grown == NULL) return NULL;
+        for (size_t i = 0; i < user_capacity; i++) {
+            if (user_lists[i].user_id == 0) continue;
+            size_t j = hash_int(user_lists[i].user_id) & (capacity - 1);
+            while (grown[j].user_id != 0) j = (j + 1) & (capacity - 1);
+            grown[j] = user_lists[i];
+        }
+        free(user_lists);
+        user_lists = grown;
+        user_capacity = capacity;
+    }
+    size_t i = hash_int(user_id) & (user_capacity - 1);
+    while (user_lists[i].user_id != 0) i = (i + 1) & (user_capacity - 1);
+    user_lists[i].user_id = user_id;
+    user_used++;
+    return &user_lists[i];
+}
+
+static int add_to_user(int user_id, int e) {
+    UserList *list = add_user(user_id);
+    if (list == NULL) return -1;
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 4;
+        int *grown = realloc(list->entries, capacity * sizeof(int));
+        if (grown == NULL) return -1;
+        list->entries = grown;
+        list->capacity = capacity;
+    }
+    list->entries[list->count++] = e;
+    return 0;
+}
+
+// Caller holds index_lock for writing
+static int add_entry(const ArchiveHeader *header, off_t offset) {
+    if (entry_count == entry_capacity) {
+        int capacity = entry_capacity ? entry_capacity * 2 : 1024;
+        IndexEntry *grown = realloc(entries, capacity * sizeof(IndexEntry));
+        if (grown == NULL) return -1;
+        entries = grown;
+        entry_capacity = capacity;
+    }
+    int e = entry_count++;
+    entries[e].header = *header;
+    entries[e].offset = offset;
+
+    if (index_id(e) == -1 || add_to_user(header->seller_id, e) == -1) return -1;
+    if (header->winner_id > 0 && header->winner_id != header->seller_id &&
+        add_to_user(header->winner_id, e) == -1) return -1;
+    return 0;
+}
+
+int archive_contains(int item_id) {
+    pthread_rwlock_rdlock(&index_lock);
+    int found = find_id(item_id) != -1;
+    pthread_rwlock_unlock(&index_lock);
+    return found;
+}
+
+int archive_history(int user_id, Item *buffer, int max_items) {
+    pthread_rwlock_rdlock(&index_lock);
+    UserList *list = find_user(user_id);
+
+    // Pick the rows, most recently archived first, read them all in one batch, then decode
+    int limit = list == NULL || max_items <= 0 ? 0 : list->count < max_items ? list->count : max_items;
+    int *picked = malloc((limit + 1) * sizeof(int));
+    uint8_t *data = malloc(limit * ARCHIVE_MAX_DATA + 1);
+    RecordOp *reads = malloc((limit + 1) * sizeof(RecordOp));
+    int wanted = 0;
+    for (int i = limit > 0 ? list->count - 1 : -1; wanted < limit && picked && data && reads && i >= 0; i--) {
+        int e = list->entries[i];
+        if (find_id(entries[e].header.id) == e) picked[wanted++] = e; // Not superseded by a later copy
+    }
+    for (int r = 0; r < wanted; r++) {
+        const IndexEntry *entry = &entries[picked[r]];
+        reads[r] = (RecordOp){ RECORD_READ, archive_file, data + r * ARCHIVE_MAX_DATA, entry->header.length, entry->offset, 0 };
+    }
+    record_io_submit(reads, wanted);
+
+    int count = 0;
+    for (int r = 0; r < wanted; r++) {
+        const ArchiveHeader *h = &entries[picked[r]].header;
+        if (reads[r].result != h->length) continue;
+        if (h->method == CODEC_LZ) {
+            if (lz_decompress(reads[r].buf, h->length, (uint8_t *)&buffer[count], sizeof(Item)) != 0) continue;
+        } else {
+            if (h->length != sizeof(Item)) continue;
+            memcpy(&buffer[count], reads[r].buf, sizeof(Item));
+        }
+        count++;
+    }
+    pthread_rwlock_unlock(&index_lock);
+
+    free(picked); free(data); free(reads);
+    return count;
+}
+
+// Archives one batch of candidate IDs. Returns the number removed from the live store.
+static int archive_batch(const int *ids, int count) {
+    uint8_t *out = malloc(count * (sizeof(ArchiveHeader) + ARCHIVE_MAX_DATA));
+    ArchiveHeader *headers = malloc(count * sizeof(ArchiveHeader));
+    off_t *data_offsets = malloc(count * sizeof(off_t));
+    int *moved = malloc(count * sizeof(int));
+    Item *items = malloc(count * sizeof(Item));
+    RecordOp *reads = malloc(count * sizeof(RecordOp));
+    int *read_ids = malloc(count * sizeof(int));
+    if (!out || !headers || !data_offsets || !moved || !items || !reads || !read_ids) {
+        free(out); free(headers); free(data_offsets); free(moved);
+        free(items); free(reads); free(read_ids);
+        return 0;
+    }
+
+    // 1. Read the candidates a segment at a time: lock them, one batched read, unlock.
+    //    Sold records never change again, so the record lock is only needed for a clean read.
+    int reading = 0, removable = 0;
+    for (int start = 0; start < count; ) {
+        int segment = item_store_segment_of(ids[start]);
+        int end = start;
+        while (end < count && item_store_segment_of(ids[end]) == segment) end++;
+
+        int fd = item_store_open(ids[start], O_RDONLY);
+        int first = reading;
+        for (int i = start; fd != -1 && i < end; i++) {
+            if (archive_contains(ids[i])) {
+                moved[removable++] = ids[i]; // Archived before a crash but never removed
+                continue;
+            }
+            off_t offset = item_store_offset(ids[i]);
+            if (lock_record(fd, F_RDLCK, offset, sizeof(Item)) == -1) continue;
+            read_ids[reading] = ids[i];
+            reads[reading] = (RecordOp){ RECORD_READ, item_store_file(ids[i]), &items[reading], sizeof(Item), offset, 0 };
+            reading++;
+        }
+        record_io_submit(reads + first, reading - first);
+        for (int r = first; r < reading; r++) unlock_record(fd, reads[r].offset, sizeof(Item));
+        if (fd != -1) close(fd);
+        start = end;
+    }
+
+    // Encode each record behind its header
+    size_t len = 0;
+    int appended = 0;
+    for (int r = 0; r < reading; r++) {
+        const Item *item = &items[r];
+        if (reads[r].result != sizeof(Item) || item->id != read_ids[r] || item->status != ITEM_SOLD) continue;
+
+        ArchiveHeader *h = &headers[appended];
+        uint8_t *data = out + len + sizeof(ArchiveHeader);
+        h->id = item->id;
+        h->seller_id = item->seller_id;
+        h->winner_id = item->current_winner_id;
+        h->length = lz_compress((const uint8_t *)item, sizeof(Item), data, ARCHIVE_MAX_DATA);
+        h->method = CODEC_LZ;
+        if (h->length == 0) { // Did not fit; store it as is
+            memcpy(data, item, sizeof(Item));
+            h->length = sizeof(Item);
+            h->method = CODEC_RAW;
+        }
+        memcpy(out + len, h, sizeof(ArchiveHeader));
+        data_offsets[appended] = archive_end + len + sizeof(ArchiveHeader);
+        len += sizeof(ArchiveHeader) + h->length;
+        appended++;
+        moved[removable++] = item->id;
+    }
+
+    // 2. One append and one fdatasync. Nothing leaves the live store until this holds.
+    RecordOp append[2] = {
+        { RECORD_WRITE, archive_file, out, len, archive_end, 0 },
+        { RECORD_SYNC, archive_file, NULL, 0, 0, 0 },
+    };
+    if (len > 0 && record_io_submit(append, 2) == -1) {
+        fprintf(stderr, "archive: append failed; %d records stay in the live store\n", appended);
+        ftruncate(archive_fd, archive_end);
+        removable = 0;
+        appended = 0;
+    }
+
+    // 3. Index the new rows
+    pthread_rwlock_wrlock(&index_lock);
+    for (int i = 0; i < appended; i++) {
+        if (add_entry(&headers[i], data_offsets[i]) == -1) {
+            removable = 0; // Cannot be found through the index, so keep the live copy
+            break;
+        }
+    }
+    archive_end += len;
+    pthread_rwlock_unlock(&index_lock);
+
+    // 4. Zero the live slots, then drop them from the snapshot
+    int fd = -1, segment = -1;
+    for (int i = 0; i < removable; i++) {
+        if (item_store_segment_of(moved[i]) != segment) {
+            if (fd != -1) close(fd);
+            fd = item_store_open(moved[i], O_RDWR);
+            segment = fd == -1 ? -1 : item_store_segment_of(moved[i]);
+        }
+        if (fd == -1) continue;
+        off_t offset = item_store_offset(moved[i]);
+        if (lock_record(fd, F_WRLCK, offset, sizeof(Item)) == -1) continue;
+        release_records(fd, offset, sizeof(Item));
+        unlock_record(fd, offset, sizeof(Item));
+    }
+    if (fd != -1) close(fd);
+    snapshot_remove_items(moved, removable);
+
+    free(out); free(headers); free(data_offsets); free(moved);
+    free(items); free(reads); free(read_ids);
+    return removable;
+}
+
+int archive_compact() {
+    time_t cutoff = time(NULL) - config.archive_after_s;
+
+    // Candidates come from the snapshot; each is re-read under its lock before it moves
+    int *ids = NULL, count = 0, capacity = 0;
+    CatalogSnapshot *snap = snapshot_acquire();
+    int total = snapshot_count(snap);
+    for (int i = snapshot_next(snap, 0); i < total; i = snapshot_next(snap, i + 1)) {
+        const Item *item = snapshot_get(snap, i);
+        if (item->status != ITEM_SOLD || item->end_time >= cutoff) continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            int *grown = realloc(ids, capacity * sizeof(int));
+            if (grown == NULL) break;
+            ids = grown;
+        }
+        ids[count++] = item->id;
+    }
+    snapshot_release(snap);
+
+    int moved = 0;
+    for (int i = 0; i < count; i += ARCHIVE_BATCH) {
+        moved += archive_batch(ids + i, count - i < ARCHIVE_BATCH ? count - i : ARCHIVE_BATCH);
+    }
+    free(ids);
+    return moved;
+}
+
+static void *compactor_thread(void *arg) {
+    (void)arg;
+    struct timespec period = { config.archive_interval_s, 0 };
+    while (1) {
+        nanosleep(&period, NULL);
+        int moved = archive_compact();
+        if (moved > 0) {
+            char log_msg[100];
+            sprintf(log_msg, "Archive: moved %d closed auctions out of the live store", moved);
+            write_log(log_msg);
+        }
+    }
+    return NULL;
+}
+
+int archive_init() {
+    char path[CONFIG_PATH_LEN + 32];
+    snprintf(path, sizeof(path), "%s/archive.dat", config.items_dir);
+    archive_fd = open(path, O_RDWR | O_CREAT, 0666);
+    if (archive_fd == -1) {
+        perror(path);
+        return -1;
+    }
+    archive_file = record_io_register(archive_fd);
+    if (archive_file == -1) return -1;
+
+    struct stat st;
+    fstat(archive_fd, &st);
+    char magic[8];
+    if (st.st_size == 0) {
+        if (pwrite(archive_fd, ARCHIVE_MAGIC, sizeof(magic), 0) != sizeof(magic)) return -1;
+        archive_end = sizeof(magic);
+    } else if (pread(archive_fd, magic, sizeof(magic), 0) != sizeof(magic) ||
+               memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) != 0) {
+        fprintf(stderr, "%s: not an item archive (or one from an older record format)\n", path);
+        return -1;
+    } else {
+        // Rebuild the index from the headers; a torn append at the end is cut off
+        off_t offset = sizeof(magic);
+        ArchiveHeader h;
+        while (offset < st.st_size) {
+            if (pread(archive_fd, &h, sizeof(h), offset) != sizeof(h) ||
+                h.length <= 0 || h.length > (int)ARCHIVE_MAX_DATA ||
+                offset + (off_t)sizeof(h) + h.length > st.st_size) {
+                fprintf(stderr, "%s: dropping incomplete record at offset %ld\n", path, (long)offset);
+                ftruncate(archive_fd, offset);
+                break;
+            }
+            if (add_entry(&h, offset + sizeof(h)) == -1) {
+                fprintf(stderr, "%s: out of memory loading the index\n", path);
+                return -1;
+            }
+            offset += sizeof(h) + h.length;
+        }
+        archive_end = offset;
+    }
+
+    if (config.archive_after_s > 0) {
+        pthread_t tid;
+        pthread_create(&tid, NULL, compactor_thread, NULL);
+        pthread_detach(tid);
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "auth_pool.h"
+#include "config.h"
+#include "kdf.h"
+#include "trace.h"
+
+#define JOB_HASH 0
+#define JOB_VERIFY 1
+
+typedef struct {
+    int kind;
+    const char *secret;
+    const char *stored; // JOB_VERIFY
+    char *out;          // JOB_HASH
+    int result;
+    int done;
+    pthread_cond_t finished;
+} AuthJob;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t not_full = PTHREAD_COND_INITIALIZER;
+static AuthJob **queue = NULL; // Ring of config.auth_queue pending jobs
+static int queue_cap = 0;
+static int queue_head = 0;
+static int queue_count = 0;
+static int started = 0;
+
+static void run_job(AuthJob *job) {
+    if (job->kind == JOB_HASH) {
+        job->result = kdf_hash(job->secret, config.kdf_log_n, config.kdf_r, config.kdf_p, job->out);
+    } else {
+        job->result = kdf_verify(job->secret, job->stored);
+    }
+}
+
+static void *auth_worker(void *arg) {
+    (void)arg;
+    while (1) {
+        pthread_mutex_lock(&pool_lock);
+        while (queue_count == 0) pthread_cond_wait(&not_empty, &pool_lock);
+        AuthJob *job = queue[queue_head];
+        queue_head = (queue_head + 1) % queue_cap;
+        queue_count--;
+        pthread_cond_signal(&not_full);
+        pthread_mutex_unlock(&pool_lock);
+
+        run_job(job);
+
+        pthread_mutex_lock(&pool_lock);
+        job->done = 1;
+        pthread_cond_signal(&job->finished);
+        pthread_mutex_unlock(&pool_lock);
+    }
+    return NULL;
+}
+
+void auth_pool_start() {
+    queue_cap = config.auth_queue;
+    queue = malloc(queue_cap * sizeof(AuthJob *));
+    if (queue == NULL) {
+        perror("auth pool");
+        return; // Hashing falls back to running inline
+    }
+
+    for (int i = 0; i < config.auth_threads; i++) {
+        pthread_t tid;
+        pthread_create(&tid, NULL, auth_worker, NULL);
+        pthread_detach(tid);
+    }
+    started = 1;
+}
+
+// Queues the job and waits for a worker to finish it
+static void submit(AuthJob *job) {
+    uint64_t span = trace_span_begin();
+    if (!started) {
+        run_job(job);
+        trace_span_end("kdf", span);
+        return;
+    }
+
+    pthread_cond_init(&job->finished, NULL);
+    job->done = 0;
+
+    pthread_mutex_lock(&pool_lock);
+    while (queue_count == queue_cap) pthread_cond_wait(&not_full, &pool_lock); // Backpressure
+    queue[(queue_head + queue_count) % queue_cap] = job;
+    queue_count++;
+    pthread_cond_signal(&not_empty);
+    while (!job->done) pthread_cond_wait(&job->finished, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+
+    pthread_cond_destroy(&job->finished);
+    trace_span_end("kdf", span);
+}
+
+int auth_hash(const char *secret, char *out) {
+    AuthJob job = { .kind = JOB_HASH, .secret = secret, .out = out };
+    submit(&job);
+    return job.result;
+}
+
+int auth_verify(const char *secret, const char *stored) {
+    AuthJob job = { .kind = JOB_VERIFY, .secret = secret, .stored = stored };
+    submit(&job);
+    return job.result;
+}
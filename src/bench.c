@@ -0,0 +1,400 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/un.h>
+#include "common.h"
+#include "histogram.h"
+#include "codec.h"
+#include "transport.h"
+
+// Load generator: every worker thread owns one connection and one registered user,
+// then drives a weighted mix of operations against the server until the deadline.
+// With -U the connections use the server's Unix socket instead of TCP, and with -S
+// they also ask to move onto shared-memory rings (local_transport = shm).
+
+enum { B_BID, B_LIST, B_MY_BIDS, B_BALANCE, B_OP_COUNT };
+
+static const char *op_names[B_OP_COUNT] = { "bid", "list", "my_bids", "balance" };
+
+typedef struct {
+    const char *host;
+    int port;
+    const char *unix_path; // Connect here instead of host:port
+    int shm;               // Ask for WIRE_SHM after connecting
+    int threads;
+    int items;
+    int duration;
+    int mix[B_OP_COUNT]; // Relative weights
+} BenchConfig;
+
+typedef struct {
+    int index;
+    Histogram hist[B_OP_COUNT];
+    uint64_t errors[B_OP_COUNT];
+    int ok; // Set once the worker logged in
+} Worker;
+
+static BenchConfig cfg = { "127.0.0.1", PORT, NULL, 0, 8, 100, 10, { 60, 20, 10, 10 } };
+static int *item_ids = NULL; // IDs the seller actually got back
+static int item_count = 0;
+static atomic_int next_amount = 1000;
+static atomic_int workers_ready = 0; // Workers done with setup, whether or not it worked
+static atomic_int start_flag = 0;
+static _Atomic uint64_t stop_ns = UINT64_MAX; // Monotonic deadline, set at start
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int connect_unix() {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, cfg.unix_path, sizeof(addr.sun_path) - 1);
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) return -1;
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static int connect_tcp() {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) return -1;
+
+    struct sockaddr_in serv_addr;
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(cfg.port);
+    if (inet_pton(AF_INET, cfg.host, &serv_addr.sin_addr) <= 0 ||
+        connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    // Requests are single fixed-size writes; don't let Nagle hold them back
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return sock;
+}
+
+// Sends one request and reads the Response header
+static int call(Transport *t, Request *req, Response *res) {
+    if (transport_send(t, req, sizeof(Request)) != sizeof(Request)) return -1;
+    if (transport_recv(t, res, sizeof(Response)) <= 0) return -1;
+    return res->operation == OP_SUCCESS ? 0 : 1;
+}
+
+// Connects over TCP or the Unix socket, then switches to shared memory if -S asked for it
+static int connect_server(Transport *t) {
+    int sock = cfg.unix_path ? connect_unix() : connect_tcp();
+    if (sock < 0) return -1;
+    transport_init(t, sock);
+    if (!cfg.shm) return 0;
+
+    Request req;
+    Response res;
+    memset(&req, 0, sizeof(Request));
+    req.operation = OP_HELLO;
+    sprintf(req.payload, "%d", WIRE_SHM);
+    if (call(t, &req, &res) != 0 || !(atoi(res.message) & WIRE_SHM) || transport_shm_attach(t) == -1) {
+        fprintf(stderr, "Server did not grant shared memory (is local_transport = shm?)\n");
+        transport_close(t);
+        return -1;
+    }
+    return 0;
+}
+
+// Reads and discards the DisplayItems that follow a listing header
+static int drain_items(Transport *t, Response *res) {
+    int count = atoi(res->message);
+    DisplayItem item;
+    for (int i = 0; i < count; i++) {
+        if (transport_recv(t, &item, sizeof(DisplayItem)) <= 0) return -1;
+    }
+    return 0;
+}
+
+static int register_and_login(Transport *t, const char *username, int balance) {
+    Request req;
+    Response res;
+
+    memset(&req, 0, sizeof(Request));
+    req.operation = OP_REGISTER;
+    strcpy(req.username, username);
+    strcpy(req.password, "bench");
+    sprintf(req.payload, "%d|bench", balance);
+    if (call(t, &req, &res) < 0) return -1;
+
+    memset(&req, 0, sizeof(Request));
+    req.operation = OP_LOGIN;
+    strcpy(req.username, username);
+    strcpy(req.password, "bench");
+    if (call(t, &req, &res) != 0) {
+        fprintf(stderr, "Login failed for %s: %s\n", username, res.message);
+        return -1;
+    }
+    return 0;
+}
+
+// Lists the items everyone bids on, using bulk frames so setup stays quick
+static int seed_items(Transport *t) {
+    BulkItemEntry *entries = calloc(MAX_BULK_ENTRIES, sizeof(BulkItemEntry));
+    int *status = malloc(MAX_BULK_ENTRIES * sizeof(int));
+    item_ids = malloc(cfg.items * sizeof(int));
+    if (entries == NULL || status == NULL || item_ids == NULL) { free(entries); free(status); return -1; }
+
+    int created = 0, sent = 0;
+    while (sent < cfg.items) {
+        int batch = cfg.items - sent;
+        if (batch > MAX_BULK_ENTRIES) batch = MAX_BULK_ENTRIES;
+
+        for (int i = 0; i < batch; i++) {
+            sprintf(entries[i].name, "bench item %d", sent + i);
+            strcpy(entries[i].description, "load generator listing");
+            entries[i].base_price = 1;
+            entries[i].duration_minutes = 24 * 60;
+        }
+
+        Request req;
+        Response res;
+        memset(&req, 0, sizeof(Request));
+        req.operation = OP_BULK_CREATE_ITEMS;
+        sprintf(req.payload, "%d", batch);
+        transport_send(t, &req, sizeof(Request));
+        transport_send(t, entries, batch * sizeof(BulkItemEntry));
+        if (transport_recv(t, &res, sizeof(Response)) <= 0 || res.operation != OP_SUCCESS) break;
+        if (transport_recv(t, status, batch * sizeof(int)) <= 0) break;
+
+        // Rejected entries get no ID, and other sellers may interleave with ours
+        for (int i = 0; i < batch; i++) {
+            if (status[i] > 0) item_ids[created++] = status[i];
+        }
+        sent += batch;
+    }
+
+    free(entries);
+    free(status);
+    item_count = created;
+    return created > 0 ? 0 : -1;
+}
+
+static int pick_op(unsigned int *seed) {
+    int total = 0;
+    for (int i = 0; i < B_OP_COUNT; i++) total += cfg.mix[i];
+    int r = rand_r(seed) % total;
+    for (int i = 0; i < B_OP_COUNT; i++) {
+        if (r < cfg.mix[i]) return i;
+        r -= cfg.mix[i];
+    }
+    return B_BALANCE;
+}
+
+static void *worker_thread(void *arg) {
+    Worker *w = arg;
+    unsigned int seed = (unsigned int)(time(NULL) ^ (w->index * 7919));
+
+    Transport conn;
+    if (connect_server(&conn) < 0) {
+        atomic_fetch_add(&workers_ready, 1);
+        return NULL;
+    }
+
+    char username[50];
+    sprintf(username, "bench_%d_%d", (int)getpid(), w->index);
+    if (register_and_login(&conn, username, 1000000000) < 0) {
+        transport_close(&conn);
+        atomic_fetch_add(&workers_ready, 1);
+        return NULL;
+    }
+    w->ok = 1;
+    atomic_fetch_add(&workers_ready, 1);
+
+    while (!atomic_load(&start_flag)) usleep(1000);
+
+    Request req;
+    Response res;
+    while (now_ns() < atomic_load(&stop_ns)) {
+        int op = pick_op(&seed);
+        memset(&req, 0, sizeof(Request));
+
+        uint64_t start = now_ns();
+        int rc;
+        switch (op) {
+            case B_BID:
+                req.operation = OP_BID;
+                sprintf(req.payload, "%d|%d", item_ids[rand_r(&seed) % item_count],
+                        atomic_fetch_add(&next_amount, 1));
+                rc = call(&conn, &req, &res);
+                break;
+            case B_LIST:
+                req.operation = OP_LIST_ITEMS;
+                rc = call(&conn, &req, &res);
+                if (rc >= 0) rc = drain_items(&conn, &res);
+                break;
+            case B_MY_BIDS:
+                req.operation = OP_MY_BIDS;
+                rc = call(&conn, &req, &res);
+                if (rc >= 0) rc = drain_items(&conn, &res);
+                break;
+            default:
+                req.operation = OP_VIEW_BALANCE;
+                rc = call(&conn, &req, &res);
+                break;
+        }
+        uint64_t elapsed = now_ns() - start;
+
+        if (rc < 0) { w->errors[op]++; break; } // Connection lost
+        if (rc > 0) w->errors[op]++;            // Server said no (e.g. outbid); still a round trip
+        hist_record(&w->hist[op], elapsed);
+    }
+
+    memset(&req, 0, sizeof(Request));
+    req.operation = OP_EXIT;
+    transport_send(&conn, &req, sizeof(Request));
+    transport_close(&conn);
+    return NULL;
+}
+
+// Parses "bid=60,list=20,my_bids=10,balance=10"
+static int parse_mix(const char *spec) {
+    int mix[B_OP_COUNT] = { 0 };
+    char copy[256];
+    strncpy(copy, spec, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+
+    for (char *tok = strtok(copy, ","); tok; tok = strtok(NULL, ",")) {
+        char name[32];
+        int weight;
+        if (sscanf(tok, "%31[^=]=%d", name, &weight) != 2 || weight < 0) return -1;
+        int found = 0;
+        for (int i = 0; i < B_OP_COUNT; i++) {
+            if (strcmp(name, op_names[i]) == 0) { mix[i] = weight; found = 1; }
+        }
+        if (!found) return -1;
+    }
+
+    int total = 0;
+    for (int i = 0; i < B_OP_COUNT; i++) total += mix[i];
+    if (total == 0) return -1;
+    memcpy(cfg.mix, mix, sizeof(mix));
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-H host] [-p port] [-U socket [-S]] [-t threads] [-i items] [-d seconds] [-m mix]\n"
+            "  -U  connect to the server's Unix socket instead of TCP\n"
+            "  -S  with -U: move each connection onto shared-memory rings\n"
+            "  -t  worker threads, one registered user each (default 8)\n"
+            "  -i  items listed before the run (default 100)\n"
+            "  -d  run duration in seconds (default 10)\n"
+            "  -m  weighted op mix (default bid=60,list=20,my_bids=10,balance=10)\n",
+            prog);
+}
+
+static void print_row(const char *name, const Histogram *h, uint64_t errors, double seconds) {
+    printf("%-10s %10lu %10.1f %10.1f %10.1f %10.1f %10.1f %8lu\n", name,
+           (unsigned long)h->total, h->total / seconds,
+           hist_percentile(h, 50.0) / 1000.0, hist_percentile(h, 99.0) / 1000.0,
+           hist_percentile(h, 99.9) / 1000.0, h->max_ns / 1000.0, (unsigned long)errors);
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "H:p:U:St:i:d:m:h")) != -1) {
+        switch (opt) {
+            case 'H': cfg.host = optarg; break;
+            case 'p': cfg.port = atoi(optarg); break;
+            case 'U': cfg.unix_path = optarg; break;
+            case 'S': cfg.shm = 1; break;
+            case 't': cfg.threads = atoi(optarg); break;
+            case 'i': cfg.items = atoi(optarg); break;
+            case 'd': cfg.duration = atoi(optarg); break;
+            case 'm':
+                if (parse_mix(optarg) < 0) { usage(argv[0]); return 1; }
+                break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (cfg.threads <= 0 || cfg.items <= 0 || cfg.duration <= 0 || (cfg.shm && !cfg.unix_path)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // 1. A seller account lists the items under test
+    Transport seller;
+    if (connect_server(&seller) < 0) {
+        if (cfg.unix_path) fprintf(stderr, "Cannot connect to %s\n", cfg.unix_path);
+        else fprintf(stderr, "Cannot connect to %s:%d\n", cfg.host, cfg.port);
+        return 1;
+    }
+    char seller_name[50];
+    sprintf(seller_name, "bench_%d_seller", (int)getpid());
+    if (register_and_login(&seller, seller_name, 0) < 0 || seed_items(&seller) < 0) {
+        fprintf(stderr, "Setup failed\n");
+        return 1;
+    }
+    printf("Listed %d items (IDs %d-%d)\n", item_count, item_ids[0], item_ids[item_count - 1]);
+
+    // 2. Workers register, log in and wait for the start signal. The clock starts only once
+    // every worker is through setup: logins run scrypt, and with many workers they take a while
+    Worker *workers = calloc(cfg.threads, sizeof(Worker));
+    pthread_t *tids = malloc(cfg.threads * sizeof(pthread_t));
+    for (int i = 0; i < cfg.threads; i++) {
+        workers[i].index = i;
+        pthread_create(&tids[i], NULL, worker_thread, &workers[i]);
+    }
+    while (atomic_load(&workers_ready) < cfg.threads) usleep(1000);
+
+    uint64_t start = now_ns();
+    atomic_store(&stop_ns, start + (uint64_t)cfg.duration * 1000000000ull);
+    atomic_store(&start_flag, 1);
+    for (int i = 0; i < cfg.threads; i++) pthread_join(tids[i], NULL);
+    double seconds = (now_ns() - start) / 1e9;
+
+    Request bye;
+    memset(&bye, 0, sizeof(Request));
+    bye.operation = OP_EXIT;
+    transport_send(&seller, &bye, sizeof(Request));
+    transport_close(&seller);
+
+    // 3. Merge per-thread histograms and report
+    int active = 0;
+    Histogram *merged = calloc(B_OP_COUNT + 1, sizeof(Histogram));
+    uint64_t errors[B_OP_COUNT + 1] = { 0 };
+    for (int i = 0; i < cfg.threads; i++) {
+        if (workers[i].ok) active++;
+        for (int op = 0; op < B_OP_COUNT; op++) {
+            hist_merge(&merged[op], &workers[i].hist[op]);
+            hist_merge(&merged[B_OP_COUNT], &workers[i].hist[op]);
+            errors[op] += workers[i].errors[op];
+            errors[B_OP_COUNT] += workers[i].errors[op];
+        }
+    }
+
+    printf("%d/%d workers connected, %.1fs run\n\n", active, cfg.threads, seconds);
+    printf("%-10s %10s %10s %10s %10s %10s %10s %8s\n",
+           "op", "count", "ops/s", "p50(us)", "p99(us)", "p999(us)", "max(us)", "errors");
+    for (int op = 0; op < B_OP_COUNT; op++) {
+        if (merged[op].total > 0) print_row(op_names[op], &merged[op], errors[op], seconds);
+    }
+    print_row("total", &merged[B_OP_COUNT], errors[B_OP_COUNT], seconds);
+
+    free(merged);
+    free(item_ids);
+    free(workers);
+    free(tids);
+    return 0;
+}
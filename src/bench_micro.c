@@ -0,0 +1,347 @@
+#define _GNU_SOURCE // nftw, mkdtemp
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include <ftw.h>
+#include "common.h"
+#include "histogram.h"
+#include "user_handler.h"
+#include "user_store.h"
+#include "item_store.h"
+#include "record_io.h"
+#include "item_handler.h"
+#include "lock_profile.h"
+#include "config.h"
+#include "listing.h"
+
+// Microbenchmarks for the storage/handler layer. Links the handler sources directly,
+// seeds synthetic data files in a scratch directory and times each function
+// single-threaded and under N-thread contention. Results are JSON lines on stdout.
+
+typedef struct {
+    int users;
+    int items;
+    int threads;
+    int iterations; // Calls per thread per benchmark
+    int expired;    // Auctions queued for each check_expired_items run
+    int keep;       // Keep the scratch directory afterwards
+} MicroConfig;
+
+typedef void (*BenchFn)(unsigned int *seed);
+
+typedef struct {
+    BenchFn fn;
+    int iterations;
+    Histogram hist;
+    unsigned int seed;
+} ThreadRun;
+
+static MicroConfig cfg = { 10000, 10000, 4, 2000, 6400, 0 };
+static atomic_int next_amount = 10;
+static volatile int list_sink; // Stops -O2 from discarding the listing copy
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// ---- Seeding ----
+
+// User 1 is the seller of every seeded item; everyone else is a bidder
+static int seed_users() {
+    int fd = open(config.users_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1) return -1;
+
+    int batch_size = 4096;
+    User *batch = calloc(batch_size, sizeof(User));
+    char hashed_pw[50], hashed_ans[50];
+    hash_password("bench", hashed_pw);
+    hash_password("bench", hashed_ans);
+
+    for (int done = 0; done < cfg.users; ) {
+        int n = cfg.users - done < batch_size ? cfg.users - done : batch_size;
+        for (int i = 0; i < n; i++) {
+            User *u = &batch[i];
+            u->id = done + i + 1;
+            sprintf(u->username, "user%d", u->id);
+            strcpy(u->password, hashed_pw);
+            u->role = ROLE_USER;
+            u->balance = 1000000000;
+            u->cooldown_until = 0;
+            strcpy(u->security_answer, hashed_ans);
+        }
+        write(fd, batch, n * sizeof(User));
+        done += n;
+    }
+    free(batch);
+    close(fd);
+    return 0;
+}
+
+static int seed_items() {
+    int fd = open(config.items_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1) return -1;
+
+    int batch_size = 1024;
+    Item *batch = calloc(batch_size, sizeof(Item));
+    time_t far_future = time(NULL) + 30 * 24 * 3600;
+
+    for (int done = 0; done < cfg.items; ) {
+        int n = cfg.items - done < batch_size ? cfg.items - done : batch_size;
+        for (int i = 0; i < n; i++) {
+            Item *it = &batch[i];
+            memset(it, 0, sizeof(Item));
+            it->id = done + i + 1;
+            sprintf(it->name, "item %d", it->id);
+            strcpy(it->description, "synthetic benchmark listing");
+            it->seller_id = 1;
+            it->current_winner_id = -1;
+            it->base_price = 1;
+            it->current_bid = 1;
+            it->end_time = far_future;
+            // Every tenth record is already sold so scans see a realistic mix
+            it->status = (it->id % 10 == 0) ? ITEM_SOLD : ITEM_ACTIVE;
+        }
+        write(fd, batch, n * sizeof(Item));
+        done += n;
+    }
+    free(batch);
+    close(fd);
+    return 0;
+}
+
+// Lists `count` auctions that end immediately so the expiry queue has work
+static void queue_expired(int count) {
+    BulkItemEntry *entries = calloc(MAX_BULK_ENTRIES, sizeof(BulkItemEntry));
+    int *status = malloc(MAX_BULK_ENTRIES * sizeof(int));
+    for (int done = 0; done < count; ) {
+        int n = count - done < MAX_BULK_ENTRIES ? count - done : MAX_BULK_ENTRIES;
+        for (int i = 0; i < n; i++) {
+            strcpy(entries[i].name, "expiring");
+            strcpy(entries[i].description, "closes at once");
+            entries[i].base_price = 1;
+            entries[i].duration_minutes = 0;
+        }
+        create_items_bulk(entries, n, 1, status);
+        done += n;
+    }
+    free(entries);
+    free(status);
+}
+
+// ---- Benchmarked calls ----
+
+static int random_bidder(unsigned int *seed) {
+    return cfg.users > 1 ? 2 + rand_r(seed) % (cfg.users - 1) : 1;
+}
+
+static void bench_place_bid(unsigned int *seed) {
+    place_bid(1 + rand_r(seed) % cfg.items, random_bidder(seed), atomic_fetch_add(&next_amount, 1));
+}
+
+static void bench_update_balance(unsigned int *seed) {
+    update_balance(random_bidder(seed), (rand_r(seed) & 1) ? 1 : -1);
+}
+
+static void bench_authenticate_user(unsigned int *seed) {
+    char username[50];
+    sprintf(username, "user%d", 1 + rand_r(seed) % cfg.users);
+    authenticate_user(username, "bench");
+}
+
+static void bench_get_all_items(unsigned int *seed) {
+    Item buffer[50];
+    get_all_items(buffer, 50);
+    list_sink = buffer[0].id;
+}
+
+// What OP_LIST_ITEMS costs per requester once the blob is built
+static void bench_listing_acquire(unsigned int *seed) {
+    ListingBlob *blob = listing_acquire();
+    size_t len;
+    listing_data(blob, &len);
+    list_sink = (int)len;
+    listing_release(blob);
+}
+
+static void bench_check_expired_items(unsigned int *seed) {
+    check_expired_items(); // Closes up to 64 due auctions per call
+}
+
+// ---- Runner ----
+
+static void *run_thread(void *arg) {
+    ThreadRun *run = arg;
+    for (int i = 0; i < run->iterations; i++) {
+        uint64_t start = now_ns();
+        run->fn(&run->seed);
+        hist_record(&run->hist, now_ns() - start);
+    }
+    return NULL;
+}
+
+// Background load for benchmarks that only make sense on one thread
+static atomic_int background_stop = 0;
+static void *background_bidder(void *arg) {
+    unsigned int seed = (unsigned int)(uintptr_t)arg;
+    while (!atomic_load(&background_stop)) bench_place_bid(&seed);
+    return NULL;
+}
+
+static void report(const char *name, int threads, const char *mode, Histogram *h, double seconds) {
+    printf("{\"bench\":\"%s\",\"mode\":\"%s\",\"threads\":%d,\"users\":%d,\"items\":%d,"
+           "\"ops\":%lu,\"seconds\":%.6f,\"ops_per_sec\":%.1f,\"mean_ns\":%lu,"
+           "\"p50_ns\":%lu,\"p99_ns\":%lu,\"p999_ns\":%lu,\"max_ns\":%lu}\n",
+           name, mode, threads, cfg.users, cfg.items,
+           (unsigned long)h->total, seconds, seconds > 0 ? h->total / seconds : 0.0,
+           (unsigned long)(h->total ? h->sum_ns / h->total : 0),
+           (unsigned long)hist_percentile(h, 50.0), (unsigned long)hist_percentile(h, 99.0),
+           (unsigned long)hist_percentile(h, 99.9), (unsigned long)h->max_ns);
+    fflush(stdout);
+}
+
+// Runs fn on `threads` threads, `iterations` calls each, and reports merged latencies
+static void run_bench(const char *name, BenchFn fn, int threads, int iterations) {
+    ThreadRun *runs = calloc(threads, sizeof(ThreadRun));
+    pthread_t *tids = malloc(threads * sizeof(pthread_t));
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < threads; i++) {
+        runs[i].fn = fn;
+        runs[i].iterations = iterations;
+        runs[i].seed = 12345u + i * 7919u;
+        pthread_create(&tids[i], NULL, run_thread, &runs[i]);
+    }
+    for (int i = 0; i < threads; i++) pthread_join(tids[i], NULL);
+    double seconds = (now_ns() - start) / 1e9;
+
+    Histogram *merged = calloc(1, sizeof(Histogram));
+    for (int i = 0; i < threads; i++) hist_merge(merged, &runs[i].hist);
+    report(name, threads, threads == 1 ? "single" : "contended", merged, seconds);
+
+    free(merged);
+    free(runs);
+    free(tids);
+}
+
+// check_expired_items is only ever called by the monitor thread, so "contended"
+// means one caller racing N-1 bidding threads rather than N callers
+static void run_expiry_bench(int threads) {
+    queue_expired(cfg.expired);
+    int calls = (cfg.expired + 63) / 64;
+
+    pthread_t *bg = malloc(threads * sizeof(pthread_t));
+    atomic_store(&background_stop, 0);
+    for (int i = 1; i < threads; i++) {
+        pthread_create(&bg[i], NULL, background_bidder, (void *)(uintptr_t)(999u + i));
+    }
+
+    ThreadRun run;
+    memset(&run, 0, sizeof(run));
+    run.fn = bench_check_expired_items;
+    run.iterations = calls;
+
+    uint64_t start = now_ns();
+    run_thread(&run);
+    double seconds = (now_ns() - start) / 1e9;
+
+    atomic_store(&background_stop, 1);
+    for (int i = 1; i < threads; i++) pthread_join(bg[i], NULL);
+    free(bg);
+
+    report("check_expired_items", threads, threads == 1 ? "single" : "contended", &run.hist, seconds);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-u users] [-n items] [-t threads] [-r iterations] [-e expired] [-c config] [-k]\n"
+            "  -u  synthetic users.dat records (default 10000)\n"
+            "  -n  synthetic items.dat records (default 10000)\n"
+            "  -t  threads for the contended runs (default 4)\n"
+            "  -r  calls per thread per benchmark (default 2000)\n"
+            "  -e  auctions expired per check_expired_items run (default 6400)\n"
+            "  -c  server config file (e.g. to measure sync = always); paths resolve in the scratch dir\n"
+            "  -k  keep the scratch directory\n",
+            prog);
+}
+
+// nftw callback that deletes the scratch tree bottom-up
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st; (void)type; (void)ftw;
+    return remove(path);
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "u:n:t:r:e:c:kh")) != -1) {
+        switch (opt) {
+            case 'c': if (config_load_file(optarg) == -1) return 1; break;
+            case 'u': cfg.users = atoi(optarg); break;
+            case 'n': cfg.items = atoi(optarg); break;
+            case 't': cfg.threads = atoi(optarg); break;
+            case 'r': cfg.iterations = atoi(optarg); break;
+            case 'e': cfg.expired = atoi(optarg); break;
+            case 'k': cfg.keep = 1; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (config_apply_env() == -1) return 1;
+    if (cfg.users < 2 || cfg.items < 1 || cfg.threads < 1 || cfg.iterations < 1 || cfg.expired < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // The handlers use paths relative to the working directory, so run inside a scratch dir
+    char scratch[] = "/tmp/auction-bench-XXXXXX";
+    if (mkdtemp(scratch) == NULL || chdir(scratch) == -1) { perror("scratch dir"); return 1; }
+    mkdir("data", 0755);
+    mkdir("logs", 0755);
+    fprintf(stderr, "Seeding %d users and %d items in %s\n", cfg.users, cfg.items, scratch);
+
+    if (seed_users() == -1 || seed_items() == -1) { perror("seed"); return 1; }
+    lock_profile_init(); // lock_profile = 1 prints the lock report to stderr at the end
+    if (record_io_init() == -1) return 1;
+    fprintf(stderr, "Storage I/O: %s\n", record_io_backend());
+    if (init_users() == -1) { perror("init_users"); return 1; }
+    if (item_store_init() == -1) return 1; // Migrates the seeded items file into segments
+    init_items();
+
+    // scale divides -r for benches dominated by deliberately slow work
+    struct { const char *name; BenchFn fn; int scale; } benches[] = {
+        { "place_bid", bench_place_bid, 1 },
+        { "update_balance", bench_update_balance, 1 },
+        { "authenticate_user", bench_authenticate_user, 50 }, // scrypt; AUCTION_KDF_LOG_N lowers the cost
+        { "get_all_items", bench_get_all_items, 1 },
+        { "listing_acquire", bench_listing_acquire, 1 },
+    };
+    int bench_count = sizeof(benches) / sizeof(benches[0]);
+
+    for (int b = 0; b < bench_count; b++) {
+        int iterations = cfg.iterations / benches[b].scale > 0 ? cfg.iterations / benches[b].scale : 1;
+        run_bench(benches[b].name, benches[b].fn, 1, iterations);
+        if (cfg.threads > 1) run_bench(benches[b].name, benches[b].fn, cfg.threads, iterations);
+    }
+    run_expiry_bench(1);
+    if (cfg.threads > 1) run_expiry_bench(cfg.threads);
+
+    if (lock_profile_enabled()) {
+        size_t len;
+        char *text = lock_profile_render(&len);
+        if (text) fputs(text, stderr);
+        free(text);
+    }
+
+    if (!cfg.keep) {
+        chdir("/");
+        nftw(scratch, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+    return 0;
+}
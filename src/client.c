@@ -5,8 +5,11 @@
 #include <arpa/inet.h>
 #include <time.h>
 #include "common.h"
+#include "codec.h"
 #include <termios.h>
 
+static int wire = 0; // WIRE_* flags granted by the server (0 = fixed-width records)
+
 void clear_input() { while (getchar() != '\n'); }
 
 void get_password(char *password, int max_len) {
@@ -50,21 +53,96 @@ int recv_all(int sock, void *buffer, size_t length) {
     return total_received;
 }
 
-int main() {
+// Asks the server for compact (and compressed) multi-record replies.
+// Older servers do not know OP_HELLO and we keep the fixed-width records.
+void negotiate_wire(int sock) {
+    Request req;
+    Response res;
+    memset(&req, 0, sizeof(Request));
+    req.operation = OP_HELLO;
+    sprintf(req.payload, "%d", WIRE_COMPACT | WIRE_LZ);
+    send(sock, &req, sizeof(Request), 0);
+    if (recv_all(sock, &res, sizeof(Response)) > 0 && res.operation == OP_SUCCESS) {
+        wire = atoi(res.message);
+    }
+}
+
+// Receives the records that follow a multi-record Response into `rows` (room for `max`).
+// Returns the count, or -1 if the reply is malformed.
+int recv_records(int sock, const Response *res, int kind, void *rows, int max) {
+    int count = atoi(res->message);
+    if (count < 0 || count > max) return -1;
+
+    if (!(wire & WIRE_COMPACT)) {
+        size_t row_size = kind == RECORD_DISPLAY ? sizeof(DisplayItem) : sizeof(HistoryRecord);
+        if (count > 0 && recv_all(sock, rows, count * row_size) <= 0) return -1;
+        return count;
+    }
+
+    // "count|bytes", then a codec frame of that many bytes
+    const char *bar = strchr(res->message, '|');
+    size_t len = bar ? strtoul(bar + 1, NULL, 10) : 0;
+    if (len == 0 || len > codec_max_frame(kind, count)) return -1;
+    uint8_t *frame = malloc(len);
+    if (frame == NULL) return -1;
+    int ok = recv_all(sock, frame, len) > 0 && codec_unpack(kind, frame, len, rows, count) == 0;
+    free(frame);
+    return ok ? count : -1;
+}
+
+// Receives a listing reply and prints it as the auction table
+void print_item_table(int sock, const Response *res) {
+    DisplayItem items[50];
+    int count = recv_records(sock, res, RECORD_DISPLAY, items, 50);
+    if (count < 0) {
+        printf("\nError: malformed listing from server.\n");
+        return;
+    }
+
+    printf("\nFound %d Auctions:\n", count);
+    printf("%-5s %-20s %-10s %-15s %-15s\n", "ID", "Name", "Price", "High Bidder", "Time Left");
+    printf("----------------------------------------------------------------------\n");
+    
+    time_t now = time(NULL);
+
+    for(int i=0; i<count; i++) {
+        DisplayItem item = items[i];
+        char time_str[20];
+        int seconds_left = (int)difftime(item.end_time, now);
+
+        if (item.status == ITEM_SOLD || seconds_left <= 0) {
+            strcpy(time_str, "Ended");
+        } else {
+            int min = seconds_left / 60;
+            int sec = seconds_left % 60;
+            sprintf(time_str, "%dm %ds", min, sec);
+        }
+        printf("%-5d %-20s $%-9d %-15s %-15s\n", 
+               item.id, item.name, item.current_bid, item.winner_name, time_str);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    // Usage: ./bin/client [host] [port] (defaults: 127.0.0.1 and PORT)
+    const char *host = argc > 1 ? argv[1] : "127.0.0.1";
+    int port = argc > 2 ? atoi(argv[2]) : PORT;
+
     int sock = 0;
     struct sockaddr_in serv_addr;
     if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) 
         return -1;
 
     serv_addr.sin_family = AF_INET; 
-    serv_addr.sin_port = htons(PORT);
+    serv_addr.sin_port = htons(port);
 
-    if(inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr)<=0) 
+    if(inet_pton(AF_INET, host, &serv_addr.sin_addr)<=0) 
         return -1;
 
     if (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) 
         return -1;
 
+    negotiate_wire(sock);
+
     int choice;
     Request req;
     Response res;
@@ -144,7 +222,7 @@ int main() {
                     int has_bids = atoi(res.message);
 
                     // 2. Define perfectly sequential dynamic menu numbers
-                    int current_opt = 4; // Start numbering after the 3 static options
+                    int current_opt = 6; // Start numbering after the 5 static options
                     int opt_withdraw = has_bids  ? current_opt++ : -1;
                     int opt_close    = is_seller ? current_opt++ : -1;
                     int opt_bal      = current_opt++;
@@ -158,6 +236,8 @@ int main() {
                     printf("1. List New Item (Sell)\n");
                     printf("2. View All Items (Buy)\n");
                     printf("3. Place Bid\n");
+                    printf("4. Set Proxy Bid (Auto-Bid up to a Max)\n");
+                    printf("5. Search Items\n");
                     if (has_bids)  printf("%d. Withdraw Bid\n", opt_withdraw);
                     if (is_seller) printf("%d. Close Auction (Seller)\n", opt_close);
                     printf("%d. Check Balance\n", opt_bal);
@@ -178,11 +258,16 @@ int main() {
                         req.operation = OP_CREATE_ITEM;
                         char name[50], desc[100];
                         int price, duration;
+                        int window = 0, extend = 0;
                         printf("Item Name: "); scanf(" %[^\n]", name); clear_input();
                         printf("Description: "); scanf(" %[^\n]", desc); clear_input();
                         printf("Base Price: "); scanf("%d", &price); clear_input();
                         printf("Duration (in minutes): "); scanf("%d", &duration); clear_input();
-                        sprintf(req.payload, "%s|%s|%d|%d", name, desc, price, duration);
+                        printf("Soft-Close Window (seconds, 0 to disable): "); scanf("%d", &window); clear_input();
+                        if (window > 0) {
+                            printf("Extend By (seconds per late bid): "); scanf("%d", &extend); clear_input();
+                        }
+                        sprintf(req.payload, "%s|%s|%d|%d|%d|%d", name, desc, price, duration, window, extend);
                         send(sock, &req, sizeof(Request), 0);
                         recv_all(sock, &res, sizeof(Response));
                         printf("Server: %s\n", res.message);
@@ -192,30 +277,7 @@ int main() {
                         req.operation = OP_LIST_ITEMS;
                         send(sock, &req, sizeof(Request), 0);
                         recv_all(sock, &res, sizeof(Response));
-                        int count = atoi(res.message);
-                        
-                        printf("\nFound %d Auctions:\n", count);
-                        printf("%-5s %-20s %-10s %-15s %-15s\n", "ID", "Name", "Price", "High Bidder", "Time Left");
-                        printf("----------------------------------------------------------------------\n");
-                        
-                        DisplayItem item;
-                        time_t now = time(NULL);
-
-                        for(int i=0; i<count; i++) {
-                            recv_all(sock, &item, sizeof(DisplayItem));
-                            char time_str[20];
-                            int seconds_left = (int)difftime(item.end_time, now);
-
-                            if (item.status == ITEM_SOLD || seconds_left <= 0) {
-                                strcpy(time_str, "Ended");
-                            } else {
-                                int min = seconds_left / 60;
-                                int sec = seconds_left % 60;
-                                sprintf(time_str, "%dm %ds", min, sec);
-                            }
-                            printf("%-5d %-20s $%-9d %-15s %-15s\n", 
-                                   item.id, item.name, item.current_bid, item.winner_name, time_str);
-                        }
+                        print_item_table(sock, &res);
                     }
                     else if (menu_choice == 3) {
                         // ... (existing logic for OP_BID) ...
@@ -229,6 +291,24 @@ int main() {
                         recv_all(sock, &res, sizeof(Response));
                         printf("Server: %s\n", res.message);
                     }
+                    else if (menu_choice == 5) {
+                        req.operation = OP_SEARCH_ITEMS;
+                        printf("Search for: "); scanf(" %[^\n]", req.payload); clear_input();
+                        send(sock, &req, sizeof(Request), 0);
+                        recv_all(sock, &res, sizeof(Response));
+                        print_item_table(sock, &res);
+                    }
+                    else if (menu_choice == 4) {
+                        req.operation = OP_PROXY_BID;
+                        int item_id, max_amount;
+                        printf("Enter Item ID to bid on: "); scanf("%d", &item_id);
+                        printf("Enter your Maximum Bid: "); scanf("%d", &max_amount);
+                        clear_input();
+                        sprintf(req.payload, "%d|%d", item_id, max_amount);
+                        send(sock, &req, sizeof(Request), 0);
+                        recv_all(sock, &res, sizeof(Response));
+                        printf("Server: %s\n", res.message);
+                    }
                     else if (has_bids && menu_choice == opt_withdraw) {
                         // ... (existing logic for OP_WITHDRAW_BID) ...
                         req.operation = OP_WITHDRAW_BID;
@@ -264,16 +344,15 @@ int main() {
                         send(sock, &req, sizeof(Request), 0);
                         
                         recv_all(sock, &res, sizeof(Response));
-                        int count = atoi(res.message);
+                        // Receive all items
+                        DisplayItem my_bids[50];
+                        int count = recv_records(sock, &res, RECORD_DISPLAY, my_bids, 50);
                         
-                        if (count == 0) {
+                        if (count < 0) {
+                            printf("\nError: malformed reply from server.\n");
+                        } else if (count == 0) {
                             printf("\nYou have no active bids.\n");
                         } else {
-                            // Receive all items
-                            DisplayItem my_bids[50];
-                            for(int i=0; i<count; i++) {
-                                recv_all(sock, &my_bids[i], sizeof(DisplayItem));
-                            }
 
                             // TABLE 1: Winning
                             printf("\n[ ITEMS YOU ARE WINNING ]\n");
@@ -311,16 +390,15 @@ int main() {
                         req.operation = OP_TRANSACTION_HISTORY;
                         send(sock, &req, sizeof(Request), 0);
                         recv_all(sock, &res, sizeof(Response));
-                        int count = atoi(res.message);
+                        HistoryRecord hist[50];
+                        int count = recv_records(sock, &res, RECORD_HISTORY, hist, 50);
                         
                         printf("\n--- TRANSACTION HISTORY ---\n");
-                        if (count == 0) {
+                        if (count < 0) {
+                            printf("Error: malformed reply from server.\n");
+                        } else if (count == 0) {
                             printf("No past transactions found.\n");
                         } else {
-                            HistoryRecord hist[50];
-                            for(int i=0; i<count; i++) {
-                                recv_all(sock, &hist[i], sizeof(HistoryRecord));
-                            }
                             
                             printf("\n[ ITEMS YOU SOLD ]\n");
                             printf("%-5s %-20s %-15s %-15s\n", "ID", "Name", "Final Price", "Winner");
@@ -0,0 +1,310 @@
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "codec.h"
+
+#define MAX_VARINT 10
+#define NAME_FIELD 50 // Every string field in the records is char[50]
+
+// ---- Varints and strings ----
+
+static size_t put_varint(uint8_t *out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+// Zigzag, so small negative values (winner_id = -1) stay one byte
+static size_t put_int(uint8_t *out, int64_t v) {
+    return put_varint(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static size_t put_str(uint8_t *out, const char *s) {
+    size_t len = strnlen(s, NAME_FIELD - 1);
+    size_t n = put_varint(out, len);
+    memcpy(out + n, s, len);
+    return n + len;
+}
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    int bad;
+} Reader;
+
+static uint64_t get_varint(Reader *r) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (r->p == r->end) break;
+        uint8_t b = *r->p++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return v;
+    }
+    r->bad = 1;
+    return 0;
+}
+
+static int64_t get_int(Reader *r) {
+    uint64_t v = get_varint(r);
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static void get_str(Reader *r, char *dst) {
+    uint64_t len = get_varint(r);
+    if (r->bad || len >= NAME_FIELD || len > (uint64_t)(r->end - r->p)) {
+        r->bad = 1;
+        dst[0] = '\0';
+        return;
+    }
+    memcpy(dst, r->p, len);
+    dst[len] = '\0';
+    r->p += len;
+}
+
+// ---- Records ----
+
+// Worst case per record: every integer at full varint width, every string at 49 bytes
+static size_t max_record(int kind) {
+    return kind == RECORD_DISPLAY ? 6 * MAX_VARINT + 2 * (1 + NAME_FIELD)
+                                  : 5 * MAX_VARINT + 3 * (1 + NAME_FIELD);
+}
+
+static size_t encode_records(int kind, const void *records, int count, uint8_t *out) {
+    size_t n = 0;
+    for (int i = 0; i < count; i++) {
+        if (kind == RECORD_DISPLAY) {
+            const DisplayItem *d = (const DisplayItem *)records + i;
+            n += put_int(out + n, d->id);
+            n += put_str(out + n, d->name);
+            n += put_int(out + n, d->current_bid);
+            n += put_str(out + n, d->winner_name);
+            n += put_int(out + n, d->end_time);
+            n += put_int(out + n, d->status);
+            n += put_int(out + n, d->winner_id);
+            n += put_int(out + n, d->my_bid_amount);
+        } else {
+            const HistoryRecord *h = (const HistoryRecord *)records + i;
+            n += put_int(out + n, h->item_id);
+            n += put_str(out + n, h->item_name);
+            n += put_int(out + n, h->amount);
+            n += put_str(out + n, h->seller_name);
+            n += put_str(out + n, h->winner_name);
+            n += put_int(out + n, h->seller_id);
+            n += put_int(out + n, h->winner_id);
+        }
+    }
+    return n;
+}
+
+static int decode_records(int kind, Reader *r, void *records, int count) {
+    for (int i = 0; i < count && !r->bad; i++) {
+        if (kind == RECORD_DISPLAY) {
+            DisplayItem *d = (DisplayItem *)records + i;
+            memset(d, 0, sizeof(DisplayItem));
+            d->id = (int)get_int(r);
+            get_str(r, d->name);
+            d->current_bid = (int)get_int(r);
+            get_str(r, d->winner_name);
+            d->end_time = (time_t)get_int(r);
+            d->status = (int)get_int(r);
+            d->winner_id = (int)get_int(r);
+            d->my_bid_amount = (int)get_int(r);
+        } else {
+            HistoryRecord *h = (HistoryRecord *)records + i;
+            memset(h, 0, sizeof(HistoryRecord));
+            h->item_id = (int)get_int(r);
+            get_str(r, h->item_name);
+            h->amount = (int)get_int(r);
+            get_str(r, h->seller_name);
+            get_str(r, h->winner_name);
+            h->seller_id = (int)get_int(r);
+            h->winner_id = (int)get_int(r);
+        }
+    }
+    return r->bad || r->p != r->end ? -1 : 0;
+}
+
+// ---- Frames ----
+
+size_t codec_max_frame(int kind, int count) {
+    return 1 + MAX_VARINT + (size_t)count * max_record(kind);
+}
+
+size_t codec_pack(int kind, const void *records, int count, int flags, uint8_t *out) {
+    uint8_t *compact = malloc(codec_max_frame(kind, count));
+    if (compact == NULL) {
+        // Still answer: encode uncompressed straight into the output
+        size_t body = encode_records(kind, records, count, out + 1 + MAX_VARINT);
+        out[0] = CODEC_RAW;
+        size_t n = 1 + put_varint(out + 1, body);
+        memmove(out + n, out + 1 + MAX_VARINT, body);
+        return n + body;
+    }
+
+    size_t body = encode_records(kind, records, count, compact);
+    size_t n = 1 + put_varint(out + 1, body);
+    size_t packed = 0;
+    if ((flags & WIRE_LZ) && body >= CODEC_LZ_MIN_BYTES) {
+        packed = lz_compress(compact, body, out + n, body);
+    }
+    if (packed > 0) {
+        out[0] = CODEC_LZ;
+        n += packed;
+    } else {
+        out[0] = CODEC_RAW;
+        memcpy(out + n, compact, body);
+        n += body;
+    }
+    free(compact);
+    return n;
+}
+
+int codec_unpack(int kind, const uint8_t *frame, size_t len, void *records, int count) {
+    if (len < 2) return -1;
+    Reader hdr = { frame + 1, frame + len, 0 };
+    uint64_t body = get_varint(&hdr);
+    if (hdr.bad || body > codec_max_frame(kind, count)) return -1;
+
+    if (frame[0] == CODEC_RAW) {
+        if (body != (uint64_t)(hdr.end - hdr.p)) return -1;
+        Reader r = { hdr.p, hdr.end, 0 };
+        return decode_records(kind, &r, records, count);
+    }
+    if (frame[0] != CODEC_LZ) return -1;
+
+    uint8_t *plain = malloc(body > 0 ? body : 1);
+    if (plain == NULL) return -1;
+    int status = lz_decompress(hdr.p, hdr.end - hdr.p, plain, body);
+    if (status == 0) {
+        Reader r = { plain, plain + body, 0 };
+        status = decode_records(kind, &r, records, count);
+    }
+    free(plain);
+    return status;
+}
+
+// ---- LZ4 block format ----
+//
+// Sequences of [token][literal length+][literals][offset: 2 bytes LE][match length+],
+// token = literal length (high nibble) and match length - 4 (low nibble), 15 meaning
+// "more bytes follow, each added until one is < 255". The last sequence is literals
+// only, and the format requires the last 5 bytes to be literals and no match to start
+// in the last 12.
+
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5
+#define LZ_MATCH_LIMIT 12
+#define LZ_MAX_OFFSET 65535
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static uint32_t lz_hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Writes a 15+ length continuation; returns 0 if it does not fit
+static int put_length(uint8_t *dst, size_t cap, size_t *o, size_t len) {
+    for (; len >= 255; len -= 255) {
+        if (*o >= cap) return 0;
+        dst[(*o)++] = 255;
+    }
+    if (*o >= cap) return 0;
+    dst[(*o)++] = (uint8_t)len;
+    return 1;
+}
+
+static int emit_sequence(uint8_t *dst, size_t cap, size_t *o, const uint8_t *lit, size_t lit_len,
+                         size_t offset, size_t match_len) {
+    if (*o >= cap) return 0;
+    size_t ml = match_len ? match_len - LZ_MIN_MATCH : 0;
+    dst[(*o)++] = (uint8_t)((lit_len < 15 ? lit_len : 15) << 4 | (ml < 15 ? ml : 15));
+    if (lit_len >= 15 && !put_length(dst, cap, o, lit_len - 15)) return 0;
+    if (*o + lit_len > cap) return 0;
+    memcpy(dst + *o, lit, lit_len);
+    *o += lit_len;
+    if (match_len == 0) return 1; // Last sequence
+
+    if (*o + 2 > cap) return 0;
+    dst[(*o)++] = (uint8_t)offset;
+    dst[(*o)++] = (uint8_t)(offset >> 8);
+    if (ml >= 15 && !put_length(dst, cap, o, ml - 15)) return 0;
+    return 1;
+}
+
+size_t lz_compress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap) {
+    uint32_t table[1 << LZ_HASH_BITS] = { 0 }; // Position + 1 of the last 4 bytes with this hash
+    size_t o = 0, anchor = 0, ip = 0;
+
+    if (len > LZ_MATCH_LIMIT) {
+        size_t match_end = len - LZ_LAST_LITERALS;
+        while (ip + LZ_MATCH_LIMIT <= len) {
+            uint32_t seq = read32(src + ip);
+            uint32_t h = lz_hash(seq);
+            size_t ref = table[h];
+            table[h] = (uint32_t)ip + 1;
+
+            if (ref == 0 || ip - (ref - 1) > LZ_MAX_OFFSET || read32(src + ref - 1) != seq) {
+                ip++;
+                continue;
+            }
+            ref--;
+
+            size_t match_len = LZ_MIN_MATCH;
+            while (ip + match_len < match_end && src[ref + match_len] == src[ip + match_len]) match_len++;
+
+            if (!emit_sequence(dst, cap, &o, src + anchor, ip - anchor, ip - ref, match_len)) return 0;
+            ip += match_len;
+            anchor = ip;
+        }
+    }
+
+    if (!emit_sequence(dst, cap, &o, src + anchor, len - anchor, 0, 0)) return 0;
+    return o < len ? o : 0;
+}
+
+// Reads a 15+ length continuation; returns -1 on truncated input
+static int get_length(const uint8_t *src, size_t len, size_t *ip, size_t *value) {
+    uint8_t b;
+    do {
+        if (*ip >= len) return -1;
+        b = src[(*ip)++];
+        *value += b;
+    } while (b == 255);
+    return 0;
+}
+
+int lz_decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t out_len) {
+    size_t ip = 0, op = 0;
+    while (ip < len) {
+        uint8_t token = src[ip++];
+
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && get_length(src, len, &ip, &lit_len) == -1) return -1;
+        if (lit_len > len - ip || lit_len > out_len - op) return -1;
+        memcpy(dst + op, src + ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+        if (ip == len) break; // Last sequence has no match
+
+        if (len - ip < 2) return -1;
+        size_t offset = src[ip] | (size_t)src[ip + 1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > op) return -1;
+
+        size_t match_len = token & 15;
+        if (match_len == 15 && get_length(src, len, &ip, &match_len) == -1) return -1;
+        match_len += LZ_MIN_MATCH;
+        if (match_len > out_len - op) return -1;
+        for (size_t k = 0; k < match_len; k++, op++) dst[op] = dst[op - offset]; // May overlap
+    }
+    return op == out_len ? 0 : -1;
+}
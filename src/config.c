@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stddef.h>
+#include "common.h"
+#include "config.h"
+
+ServerConfig config = {
+    .port = PORT,
+    .backlog = 64,
+    .listen_threads = 0,
+    .max_clients = MAX_CLIENTS,
+    .max_connections = 0,
+    .monitor_batch = 64,
+    .bid_combining = 1,
+    .sched_slots = 16,
+    .sched_bid_slots = 16,
+    .sched_account_slots = 8,
+    .sched_scan_slots = 4,
+    .sched_bid_weight = 8,
+    .sched_account_weight = 4,
+    .sched_scan_weight = 1,
+    .sync = SYNC_NONE,
+    .sync_interval_ms = 1000,
+    .io_backend = IO_BACKEND_AUTO,
+    .metrics_port = METRICS_PORT,
+    .local_transport = LOCAL_TRANSPORT_OFF,
+    .unix_socket = "data/auction.sock",
+    .shm_ring_bytes = 256 * 1024,
+    .users_file = "data/users.dat",
+    .items_file = "data/items.dat",
+    .items_dir = "data/items",
+    .log_file = "logs/server.log",
+    .trace_file = "logs/trace.json",
+    .lock_profile_file = "logs/lock_profile.log",
+    .lock_profile = 0,
+    .lock_profile_interval = 0,
+    .trace = 0,
+    .trace_slow_us = 5000,
+    .trace_sample = 1,
+    .kdf_log_n = 14,
+    .kdf_r = 8,
+    .kdf_p = 1,
+    .auth_threads = 2,
+    .auth_queue = 64,
+    .connect_ip_rate = 600,
+    .connect_ip_burst = 100,
+    .login_ip_rate = 300,
+    .login_ip_burst = 60,
+    .login_user_rate = 30,
+    .login_user_burst = 10,
+    .rate_limit_idle_s = 300,
+    .zerocopy_min_bytes = 16384,
+    .wire_compression = 1,
+    .user_writeback_ms = 50,
+    .item_segment_items = 65536,
+    .load_threads = 4,
+    .archive_after_s = 7 * 24 * 3600,
+    .archive_interval_s = 300,
+};
+
+#define OPT_INT 0
+#define OPT_PATH 1
+#define OPT_ENUM 2  // One of a list of names, stored as its index
+
+static const char *const sync_names[] = { "none", "always", "interval", NULL };
+static const char *const io_backend_names[] = { "auto", "posix", "uring", NULL };
+static const char *const local_transport_names[] = { "off", "unix", "shm", NULL };
+
+typedef struct {
+    const char *key;
+    int type;
+    size_t offset;
+    int min;        // Bounds for OPT_INT
+    int max;
+    const char *help;
+    const char *const *names; // Values for OPT_ENUM
+} ConfigOption;
+
+static const ConfigOption options[] = {
+    { "port", OPT_INT, offsetof(ServerConfig, port), 1, 65535, "TCP port clients connect to" },
+    { "backlog", OPT_INT, offsetof(ServerConfig, backlog), 1, 65535, "listen() backlog (per listener)" },
+    { "listen_threads", OPT_INT, offsetof(ServerConfig, listen_threads), 0, 256, "Listener threads, each with its own SO_REUSEPORT socket (0 = one per CPU)" },
+    { "max_clients", OPT_INT, offsetof(ServerConfig, max_clients), 1, 1000000, "Concurrent logged-in sessions" },
+    { "max_connections", OPT_INT, offsetof(ServerConfig, max_connections), 0, 1000000, "Concurrent connection threads (0 = unlimited)" },
+    { "sched_slots", OPT_INT, offsetof(ServerConfig, sched_slots), 0, 65536, "Requests handled at once across all classes (0 = no scheduling)" },
+    { "sched_bid_slots", OPT_INT, offsetof(ServerConfig, sched_bid_slots), 1, 65536, "Bids, withdrawals and closes handled at once" },
+    { "sched_account_slots", OPT_INT, offsetof(ServerConfig, sched_account_slots), 1, 65536, "Balance and other small lookups handled at once" },
+    { "sched_scan_slots", OPT_INT, offsetof(ServerConfig, sched_scan_slots), 1, 65536, "Listings, searches, histories and bulk creates handled at once" },
+    { "sched_bid_weight", OPT_INT, offsetof(ServerConfig, sched_bid_weight), 1, 1000, "Share of contended slots for bids" },
+    { "sched_account_weight", OPT_INT, offsetof(ServerConfig, sched_account_weight), 1, 1000, "Share of contended slots for lookups" },
+    { "sched_scan_weight", OPT_INT, offsetof(ServerConfig, sched_scan_weight), 1, 1000, "Share of contended slots for scans" },
+    { "bid_combining", OPT_INT, offsetof(ServerConfig, bid_combining), 0, 1, "Decide concurrent plain bids on one item in a single locked pass (0/1)" },
+    { "monitor_batch", OPT_INT, offsetof(ServerConfig, monitor_batch), 1, 65536, "Auctions expired per monitor wake-up" },
+    { "sync", OPT_ENUM, offsetof(ServerConfig, sync), 0, 0, "none | always | interval", sync_names },
+    { "sync_interval_ms", OPT_INT, offsetof(ServerConfig, sync_interval_ms), 1, 3600000, "Flush period for sync = interval" },
+    { "io_backend", OPT_ENUM, offsetof(ServerConfig, io_backend), 0, 0, "Record I/O: auto | posix | uring", io_backend_names },
+    { "metrics_port", OPT_INT, offsetof(ServerConfig, metrics_port), 0, 65535, "Prometheus listener on 127.0.0.1 (0 = off)" },
+    { "local_transport", OPT_ENUM, offsetof(ServerConfig, local_transport), 0, 0, "Same-host clients: off | unix | shm", local_transport_names },
+    { "unix_socket", OPT_PATH, offsetof(ServerConfig, unix_socket), 0, 0, "Unix socket for local clients" },
+    { "shm_ring_bytes", OPT_INT, offsetof(ServerConfig, shm_ring_bytes), 4096, 1 << 30, "Shared-memory ring size per direction (rounded up to a power of two)" },
+    { "users_file", OPT_PATH, offsetof(ServerConfig, users_file), 0, 0, "User records" },
+    { "items_file", OPT_PATH, offsetof(ServerConfig, items_file), 0, 0, "Single-file item records from older versions (migrated into items_dir)" },
+    { "items_dir", OPT_PATH, offsetof(ServerConfig, items_dir), 0, 0, "Item segment files" },
+    { "item_segment_items", OPT_INT, offsetof(ServerConfig, item_segment_items), 1024, 1 << 24, "Item records per segment file (only used when the store is created)" },
+    { "load_threads", OPT_INT, offsetof(ServerConfig, load_threads), 1, 64, "Item segments loaded in parallel at startup" },
+    { "archive_after_s", OPT_INT, offsetof(ServerConfig, archive_after_s), 0, 1 << 30, "Archive closed auctions that ended this long ago (0 = never)" },
+    { "archive_interval_s", OPT_INT, offsetof(ServerConfig, archive_interval_s), 1, 86400, "Seconds between archive compactor passes" },
+    { "log_file", OPT_PATH, offsetof(ServerConfig, log_file), 0, 0, "Audit log" },
+    { "trace_file", OPT_PATH, offsetof(ServerConfig, trace_file), 0, 0, "Slow request traces" },
+    { "lock_profile_file", OPT_PATH, offsetof(ServerConfig, lock_profile_file), 0, 0, "Periodic lock profile dumps" },
+    { "lock_profile", OPT_INT, offsetof(ServerConfig, lock_profile), 0, 1, "Record lock profiler (0/1)" },
+    { "lock_profile_interval", OPT_INT, offsetof(ServerConfig, lock_profile_interval), 0, 86400, "Seconds between lock profile dumps (0 = on demand)" },
+    { "trace", OPT_INT, offsetof(ServerConfig, trace), 0, 1, "Request tracing (0/1)" },
+    { "trace_slow_us", OPT_INT, offsetof(ServerConfig, trace_slow_us), 0, 1000000000, "Trace requests slower than this" },
+    { "trace_sample", OPT_INT, offsetof(ServerConfig, trace_sample), 1, 1000000, "Write every Nth slow request" },
+    { "kdf_log_n", OPT_INT, offsetof(ServerConfig, kdf_log_n), 1, 20, "scrypt cost: N = 2^kdf_log_n (memory = 128 * r * N bytes)" },
+    { "kdf_r", OPT_INT, offsetof(ServerConfig, kdf_r), 1, 255, "scrypt block size" },
+    { "kdf_p", OPT_INT, offsetof(ServerConfig, kdf_p), 1, 15, "scrypt parallelism" },
+    { "auth_threads", OPT_INT, offsetof(ServerConfig, auth_threads), 1, 256, "Password hashing threads" },
+    { "auth_queue", OPT_INT, offsetof(ServerConfig, auth_queue), 1, 65536, "Queued hashing jobs before callers block" },
+    { "connect_ip_rate", OPT_INT, offsetof(ServerConfig, connect_ip_rate), 0, 1000000, "New connections per minute per IP (0 = unlimited)" },
+    { "connect_ip_burst", OPT_INT, offsetof(ServerConfig, connect_ip_burst), 1, 1000000, "Connection burst per IP" },
+    { "login_ip_rate", OPT_INT, offsetof(ServerConfig, login_ip_rate), 0, 1000000, "Login / forgot-password attempts per minute per IP (0 = unlimited)" },
+    { "login_ip_burst", OPT_INT, offsetof(ServerConfig, login_ip_burst), 1, 1000000, "Login attempt burst per IP" },
+    { "login_user_rate", OPT_INT, offsetof(ServerConfig, login_user_rate), 0, 1000000, "Login / forgot-password attempts per minute per username (0 = unlimited)" },
+    { "login_user_burst", OPT_INT, offsetof(ServerConfig, login_user_burst), 1, 1000000, "Login attempt burst per username" },
+    { "rate_limit_idle_s", OPT_INT, offsetof(ServerConfig, rate_limit_idle_s), 1, 86400, "Drop rate limit buckets idle this long" },
+    { "zerocopy_min_bytes", OPT_INT, offsetof(ServerConfig, zerocopy_min_bytes), 0, 1 << 30, "Send listings this large with MSG_ZEROCOPY (0 = never)" },
+    { "wire_compression", OPT_INT, offsetof(ServerConfig, wire_compression), 0, 1, "Offer LZ compression of multi-record replies (0/1)" },
+    { "user_writeback_ms", OPT_INT, offsetof(ServerConfig, user_writeback_ms), 1, 60000, "Write changed user records back this often (sync = always writes through)" },
+};
+
+#define OPTION_COUNT (int)(sizeof(options) / sizeof(options[0]))
+
+static const ConfigOption *find_option(const char *key) {
+    for (int i = 0; i < OPTION_COUNT; i++) {
+        if (strcmp(options[i].key, key) == 0) return &options[i];
+    }
+    return NULL;
+}
+
+// Parses and stores one value. `origin` names where it came from, for the error message.
+static int set_option(const char *key, const char *value, const char *origin) {
+    const ConfigOption *opt = find_option(key);
+    if (opt == NULL) {
+        fprintf(stderr, "%s: unknown setting '%s'\n", origin, key);
+        return -1;
+    }
+
+    void *field = (char *)&config + opt->offset;
+    if (opt->type == OPT_INT) {
+        char *end;
+        errno = 0;
+        long v = strtol(value, &end, 10);
+        if (errno != 0 || end == value || *end != '\0' || v < opt->min || v > opt->max) {
+            fprintf(stderr, "%s: %s must be an integer in [%d, %d], got '%s'\n", origin, key, opt->min, opt->max, value);
+            return -1;
+        }
+        *(int *)field = (int)v;
+    } else if (opt->type == OPT_PATH) {
+        if (value[0] == '\0' || strlen(value) >= CONFIG_PATH_LEN) {
+            fprintf(stderr, "%s: %s must be a path shorter than %d characters\n", origin, key, CONFIG_PATH_LEN);
+            return -1;
+        }
+        strcpy((char *)field, value);
+    } else {
+        for (int n = 0; opt->names[n]; n++) {
+            if (strcmp(value, opt->names[n]) == 0) { *(int *)field = n; return 0; }
+        }
+        fprintf(stderr, "%s: %s must be one of", origin, key);
+        for (int n = 0; opt->names[n]; n++) fprintf(stderr, " %s", opt->names[n]);
+        fprintf(stderr, ", got '%s'\n", value);
+        return -1;
+    }
+    return 0;
+}
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) *--end = '\0';
+    return s;
+}
+
+// "key = value" lines; '#' starts a comment
+int config_load_file(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    char line[512];
+    int line_no = 0, status = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        line_no++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char *text = trim(line);
+        if (*text == '\0') continue;
+
+        char origin[CONFIG_PATH_LEN + 16];
+        snprintf(origin, sizeof(origin), "%s:%d", path, line_no);
+
+        char *eq = strchr(text, '=');
+        if (eq == NULL) {
+            fprintf(stderr, "%s: expected 'key = value'\n", origin);
+            status = -1;
+            continue;
+        }
+        *eq = '\0';
+        if (set_option(trim(text), trim(eq + 1), origin) == -1) status = -1;
+    }
+    fclose(fp);
+    return status;
+}
+
+// AUCTION_<KEY> overrides the file, e.g. AUCTION_TRACE=1 or AUCTION_PORT=9000
+int config_apply_env() {
+    int status = 0;
+    for (int i = 0; i < OPTION_COUNT; i++) {
+        char name[64] = "AUCTION_";
+        for (int c = 0; options[i].key[c] && c < 50; c++) {
+            name[8 + c] = toupper((unsigned char)options[i].key[c]);
+            name[9 + c] = '\0';
+        }
+        const char *value = getenv(name);
+        if (value && set_option(options[i].key, value, name) == -1) status = -1;
+    }
+    return status;
+}
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s [-c config_file] [--key=value ...] [--print-config]\n\n", prog);
+    printf("  --print-config           print the settings in effect (file format) and exit\n\n");
+    printf("Settings (file: key = value, environment: AUCTION_KEY=value):\n");
+    for (int i = 0; i < OPTION_COUNT; i++) {
+        printf("  --%-22s %s\n", options[i].key, options[i].help);
+    }
+}
+
+int config_load(int argc, char *argv[]) {
+    // The config file is applied first, wherever -c appears on the command line
+    const char *file = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) file = argv[++i];
+    }
+
+    if (file != NULL) {
+        if (config_load_file(file) == -1) return -1;
+    } else {
+        FILE *probe = fopen(DEFAULT_CONFIG_FILE, "r"); // Optional when not named explicitly
+        if (probe) {
+            fclose(probe);
+            if (config_load_file(DEFAULT_CONFIG_FILE) == -1) return -1;
+        }
+    }
+
+    if (config_apply_env() == -1) return -1;
+
+    int print = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0) { i++; continue; }
+        if (strcmp(argv[i], "--print-config") == 0) { print = 1; continue; }
+        if (strncmp(argv[i], "--", 2) != 0) {
+            fprintf(stderr, "Unexpected argument '%s' (try --help)\n", argv[i]);
+            return -1;
+        }
+
+        // --key=value or --key value
+        char key[64];
+        const char *arg = argv[i] + 2;
+        const char *eq = strchr(arg, '=');
+        const char *value;
+        size_t key_len = eq ? (size_t)(eq - arg) : strlen(arg);
+        if (key_len >= sizeof(key)) key_len = sizeof(key) - 1;
+        memcpy(key, arg, key_len);
+        key[key_len] = '\0';
+
+        if (eq) {
+            value = eq + 1;
+        } else if (i + 1 < argc) {
+            value = argv[++i];
+        } else {
+            fprintf(stderr, "--%s needs a value\n", key);
+            return -1;
+        }
+        if (set_option(key, value, "command line") == -1) return -1;
+    }
+
+    // After every source, so it shows what the server would actually run with
+    if (print) {
+        config_print(stdout);
+        return 1;
+    }
+    return 0;
+}
+
+void config_print(FILE *out) {
+    for (int i = 0; i < OPTION_COUNT; i++) {
+        const void *field = (const char *)&config + options[i].offset;
+        if (options[i].type == OPT_INT) {
+            fprintf(out, "%s = %d\n", options[i].key, *(const int *)field);
+        } else if (options[i].type == OPT_PATH) {
+            fprintf(out, "%s = %s\n", options[i].key, (const char *)field);
+        } else {
+            fprintf(out, "%s = %s\n", options[i].key, options[i].names[*(const int *)field]);
+        }
+    }
+}
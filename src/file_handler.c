@@ -1,29 +1,55 @@
+#define _GNU_SOURCE // F_OFD_SETLKW
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <sys/types.h>
+#include <time.h>
+#include <pthread.h>
 #include "common.h"
+#include "config.h"
+#include "metrics.h"
+#include "lock_profile.h"
+#include "trace.h"
+#include "item_store.h"
+
+// Open File Description locks are owned by the open() that took them rather than
+// by the whole process, so two server threads holding their own descriptors really
+// exclude each other. Classic POSIX locks would let every thread in the server through.
+#ifdef F_OFD_SETLKW
+#define RECORD_LOCK_CMD F_OFD_SETLKW
+#define RECORD_LOCK_PID 0
+#else
+#define RECORD_LOCK_CMD F_SETLKW
+#define RECORD_LOCK_PID getpid()
+#endif
 
 // Generic Record Lock Function
 // fd: File Descriptor
 // type: F_WRLCK (Write/Exclusive) or F_RDLCK (Read/Shared)
 // offset: Where the record starts (id * sizeof(struct))
 // size: Size of the record (sizeof(struct))
-int lock_record(int fd, int type, off_t offset, size_t size) {
+// site: Calling function, used only when lock profiling is on
+int lock_record_at(int fd, int type, off_t offset, size_t size, const char *site) {
     struct flock lock;
     lock.l_type = type;
     lock.l_whence = SEEK_SET;
     lock.l_start = offset;
     lock.l_len = size;
-    lock.l_pid = getpid();
+    lock.l_pid = RECORD_LOCK_PID;
 
-    // F_SETLKW = Set Lock Wait (Blocking lock)
+    // F_OFD_SETLKW / F_SETLKW = Set Lock Wait (Blocking lock)
     // It waits until the lock is available
-    if (fcntl(fd, F_SETLKW, &lock) == -1) {
+    uint64_t wait_start = metrics_now_ns();
+    if (fcntl(fd, RECORD_LOCK_CMD, &lock) == -1) {
         perror("fcntl error");
         return -1;
     }
+    uint64_t wait_ns = metrics_now_ns() - wait_start;
+    metrics_record_lock_wait(wait_ns);
+    trace_span_end_detail("lock_wait", site, wait_start); // Kept only while a request is traced
+    if (lock_profile_enabled()) lock_profile_acquired(fd, type, offset, size, site, wait_ns);
     return 0;
 }
 
@@ -33,11 +59,65 @@ int unlock_record(int fd, off_t offset, size_t size) {
     lock.l_whence = SEEK_SET;
     lock.l_start = offset;
     lock.l_len = size;
-    lock.l_pid = getpid();
+    lock.l_pid = RECORD_LOCK_PID;
 
-    if (fcntl(fd, F_SETLKW, &lock) == -1) {
+    if (fcntl(fd, RECORD_LOCK_CMD, &lock) == -1) {
         perror("fcntl unlock error");
         return -1;
     }
+    if (lock_profile_enabled()) lock_profile_released(fd, offset, size);
+    return 0;
+}
+
+// Reserves disk space for [offset, offset + len) without changing the file size, so
+// records appended there later need no block allocation. Best effort: filesystems
+// without fallocate just allocate on write as before.
+void preallocate_records(int fd, off_t offset, off_t len) {
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, offset, len) == -1 && errno != EOPNOTSUPP) {
+        perror("fallocate");
+    }
+}
+
+// Zeroes [offset, offset + len) and hands whole blocks in it back to the filesystem.
+// Offsets of the records around it do not move. Falls back to writing zeros.
+int release_records(int fd, off_t offset, off_t len) {
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, len) == 0) return 0;
+
+    char zeros[4096] = {0};
+    for (off_t done = 0; done < len; ) {
+        size_t n = len - done < (off_t)sizeof(zeros) ? (size_t)(len - done) : sizeof(zeros);
+        if (pwrite(fd, zeros, n, offset + done) != (ssize_t)n) return -1;
+        done += n;
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+// Applies the configured sync policy after a record write
+void sync_record_write(int fd) {
+    if (config.sync == SYNC_ALWAYS) fdatasync(fd);
+}
+
+static void sync_file(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return;
+    fdatasync(fd);
+    close(fd);
+}
+
+// sync = interval: bounds how much acknowledged work a crash can lose
+static void *sync_thread(void *arg) {
+    struct timespec period = { config.sync_interval_ms / 1000, (config.sync_interval_ms % 1000) * 1000000L };
+    while (1) {
+        nanosleep(&period, NULL);
+        sync_file(config.users_file);
+        item_store_sync();
+    }
+    return NULL;
+}
+
+void start_sync_thread() {
+    if (config.sync != SYNC_INTERVAL) return;
+    pthread_t tid;
+    pthread_create(&tid, NULL, sync_thread, NULL);
+    pthread_detach(tid);
+}
@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <string.h>
+#include "histogram.h"
+
+int hist_bucket_index(uint64_t value_ns) {
+    if (value_ns < HIST_SUB_BUCKETS) return (int)value_ns;
+
+    int exp = 63 - __builtin_clzll(value_ns); // Position of the highest set bit
+    if (exp > HIST_MAX_EXP) return HIST_BUCKETS - 1;
+
+    int sub = (value_ns >> (exp - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1);
+    return (exp - HIST_SUB_BITS + 1) * HIST_SUB_BUCKETS + sub;
+}
+
+uint64_t hist_bucket_upper(int index) {
+    if (index < HIST_SUB_BUCKETS) return (uint64_t)index;
+
+    int exp = index / HIST_SUB_BUCKETS + HIST_SUB_BITS - 1;
+    int sub = index % HIST_SUB_BUCKETS;
+    // Lower edge is (16 + sub) << (exp - 4); the next bucket starts one step above it
+    return ((uint64_t)(HIST_SUB_BUCKETS + sub + 1) << (exp - HIST_SUB_BITS)) - 1;
+}
+
+void hist_record(Histogram *h, uint64_t value_ns) {
+    h->counts[hist_bucket_index(value_ns)]++;
+    h->total++;
+    h->sum_ns += value_ns;
+    if (value_ns > h->max_ns) h->max_ns = value_ns;
+}
+
+void hist_merge(Histogram *into, const Histogram *from) {
+    for (int i = 0; i < HIST_BUCKETS; i++) into->counts[i] += from->counts[i];
+    into->total += from->total;
+    into->sum_ns += from->sum_ns;
+    if (from->max_ns > into->max_ns) into->max_ns = from->max_ns;
+}
+
+uint64_t hist_percentile(const Histogram *h, double percentile) {
+    if (h->total == 0) return 0;
+
+    uint64_t rank = (uint64_t)(percentile / 100.0 * h->total);
+    if (rank >= h->total) rank = h->total - 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen > rank) {
+            uint64_t upper = hist_bucket_upper(i);
+            return upper < h->max_ns ? upper : h->max_ns;
+        }
+    }
+    return h->max_ns;
+}
@@ -4,55 +4,109 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <time.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include "common.h"
+#include "config.h"
 #include "file_handler.h"
 #include "user_handler.h"
 #include "logger.h"
-
-#define ITEM_FILE "data/items.dat"
-
-int get_next_item_id(int fd) {
-    long size = lseek(fd, 0, SEEK_END);
-    if (size == 0) return 1;
-    return (size / sizeof(Item)) + 1;
+#include "metrics.h"
+#include "trace.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "search_index.h"
+#include "item_store.h"
+#include "archive.h"
+#include "record_io.h"
+#include "item_handler.h"
+
+#define SETTLE_BATCH 64      // Due auctions settled per record_io batch
+#define SETTLE_RETRY_S 1     // Delay before retrying an auction whose record could not be locked
+#define COMBINE_BUCKETS 1024 // Hash buckets of items with plain bids queued
+#define COMBINE_MAX 64       // Bids decided per combining pass
+
+static atomic_int next_item_id = 1; // Seeded from the segments by init_items
+
+// Hands out `count` consecutive IDs without any file lock. Each creator then writes
+// its own slots, so listings append in parallel; item_store_reserve adds segments
+// and reserves disk space as the range grows.
+static int claim_item_ids(int count) {
+    int first = atomic_fetch_add(&next_item_id, count);
+    item_store_reserve(first, first + count - 1);
+    return first;
 }
 
-// UPDATED: Accepts int duration_minutes
-int create_item(char *name, char *desc, int base_price, int duration_minutes, int seller_id) {
-    int fd = open(ITEM_FILE, O_RDWR | O_CREAT, 0666);
-    if (fd == -1) return -1;
+// IDs that have been handed out (the record may still be a zeroed slot)
+static int valid_item_id(int item_id) {
+    return item_id > 0 && item_id < atomic_load(&next_item_id);
+}
 
-    struct flock lock;
-    lock.l_type = F_WRLCK;
-    lock.l_whence = SEEK_SET;
-    lock.l_start = 0;
-    lock.l_len = 0; 
-    fcntl(fd, F_SETLKW, &lock);
+// Publishes a freshly written record to readers and keeps the search index in step.
+// Called while the record's write lock is still held so versions never go backwards.
+static void item_changed(const Item *item) {
+    snapshot_publish_item(item);
+    search_index_item(item);
+}
 
-    Item new_item;
-    new_item.id = get_next_item_id(fd);
-    strcpy(new_item.name, name);
-    strcpy(new_item.description, desc);
-    new_item.base_price = base_price;
-    new_item.current_bid = base_price;
+// Fills in a brand-new active listing
+static void init_item(Item *new_item, int id, const char *name, const char *desc, int base_price,
+                      int duration_minutes, int seller_id, int soft_close_window, int soft_close_extend) {
+    new_item->id = id;
+    strcpy(new_item->name, name);
+    strcpy(new_item->description, desc);
+    new_item->base_price = base_price;
+    new_item->current_bid = base_price;
     
     // CALCULATE EXPIRATION TIME
-    new_item.end_time = time(NULL) + (duration_minutes * 60);
+    new_item->end_time = time(NULL) + (duration_minutes * 60);
+    
+    // Soft-close only makes sense when both the window and the extension are set
+    if (soft_close_window > 0 && soft_close_extend > 0) {
+        new_item->soft_close_window = soft_close_window;
+        new_item->soft_close_extend = soft_close_extend;
+    } else {
+        new_item->soft_close_window = 0;
+        new_item->soft_close_extend = 0;
+    }
     
-    new_item.seller_id = seller_id;
-    new_item.current_winner_id = -1;
-    new_item.status = ITEM_ACTIVE;
-    new_item.past_bidders_count = 0;
-    memset(new_item.past_bidders, 0, sizeof(new_item.past_bidders));
-    memset(new_item.past_bid_amounts, 0, sizeof(new_item.past_bid_amounts));
-
-    lseek(fd, 0, SEEK_END);
-    write(fd, &new_item, sizeof(Item));
-
-    lock.l_type = F_UNLCK;
-    fcntl(fd, F_SETLKW, &lock);
+    new_item->seller_id = seller_id;
+    new_item->current_winner_id = -1;
+    new_item->winner_max = 0;
+    new_item->status = ITEM_ACTIVE;
+    new_item->past_bidders_count = 0;
+    new_item->version = 1;
+    memset(new_item->past_bidders, 0, sizeof(new_item->past_bidders));
+    memset(new_item->past_bid_amounts, 0, sizeof(new_item->past_bid_amounts));
+}
+
+// UPDATED: Accepts int duration_minutes and an optional soft-close window (0 = off)
+int create_item(char *name, char *desc, int base_price, int duration_minutes, int seller_id,
+                int soft_close_window, int soft_close_extend) {
+    Item new_item;
+    init_item(&new_item, claim_item_ids(1), name, desc, base_price, duration_minutes,
+              seller_id, soft_close_window, soft_close_extend);
+
+    int fd = item_store_open(new_item.id, O_RDWR);
+    if (fd == -1) return -1;
+    off_t offset = item_store_offset(new_item.id);
+
+    // Lock just the new slot: a bid on the fresh ID must not publish ahead of us
+    if (lock_record(fd, F_WRLCK, offset, sizeof(Item)) == -1) { close(fd); return -1; }
+
+    if (record_write(item_store_file(new_item.id), &new_item, sizeof(Item), offset) != sizeof(Item)) {
+        unlock_record(fd, offset, sizeof(Item));
+        close(fd);
+        return -1; // The ID stays unused
+    }
+    sync_record_write(fd);
+    item_changed(&new_item);
+
+    unlock_record(fd, offset, sizeof(Item));
     close(fd);
 
+    schedule_item(new_item.id, new_item.end_time);
+
     char seller_name[50];
     get_username(seller_id, seller_name); // Use the helper
     
@@ -64,150 +118,567 @@ int create_item(char *name, char *desc, int base_price, int duration_minutes, in
     return new_item.id;
 }
 
-int get_all_items(Item *buffer, int max_items) {
-    int fd = open(ITEM_FILE, O_RDONLY);
-    if (fd == -1) return 0;
+// Lists many items in one pass: one contiguous ID range, one write.
+// status[i] receives the new item ID, or -2 if entry i was rejected.
+// Returns the number of items created, or -1 on a storage error.
+int create_items_bulk(BulkItemEntry *entries, int count, int seller_id, int *status) {
+    if (count <= 0) return 0;
+
+    Item *batch = malloc(count * sizeof(Item));
+    if (batch == NULL) return -1;
+
+    int created = 0;
+
+    for (int i = 0; i < count; i++) {
+        BulkItemEntry *e = &entries[i];
+        // Entries come straight off the wire, so terminate the strings ourselves
+        e->name[sizeof(e->name) - 1] = '\0';
+        e->description[sizeof(e->description) - 1] = '\0';
+
+        if (e->name[0] == '\0' || e->base_price < 0 || e->duration_minutes < 0) {
+            status[i] = -2; // Invalid entry
+            continue;
+        }
+
+        init_item(&batch[created], 0, e->name, e->description, e->base_price,
+                  e->duration_minutes, seller_id, e->soft_close_window, e->soft_close_extend);
+        status[i] = created++; // Batch index for now; the ID once the range is claimed
+    }
+    if (created == 0) { free(batch); return 0; }
+
+    // Claim only as many IDs as there are valid entries
+    int first_id = claim_item_ids(created);
+    for (int i = 0; i < created; i++) batch[i].id = first_id + i;
+    for (int i = 0; i < count; i++) {
+        if (status[i] >= 0) status[i] += first_id;
+    }
+
+    // The records are contiguous in memory and on disk, so each segment the range
+    // touches takes one lock and one write, and the writes go out as one batch
+    int first_segment = item_store_segment_of(first_id);
+    int pieces = item_store_segment_of(first_id + created - 1) - first_segment + 1;
+    int fds[pieces];
+    RecordOp ops[2 * pieces];
+    int locked = 0, done = 0;
+    while (locked < pieces) {
+        int run = item_store_segment_last_id(first_segment + locked) - (first_id + done) + 1;
+        if (run > created - done) run = created - done;
+        off_t offset = item_store_offset(first_id + done);
+        fds[locked] = item_store_open(first_id + done, O_RDWR);
+        if (fds[locked] == -1) break;
+        if (lock_record(fds[locked], F_WRLCK, offset, run * sizeof(Item)) == -1) { close(fds[locked]); break; }
+        ops[locked] = (RecordOp){ RECORD_WRITE, item_store_file(first_id + done), batch + done, run * sizeof(Item), offset, 0 };
+        locked++;
+        done += run;
+    }
+    int failed = locked < pieces;
+    if (!failed) {
+        int op_count = pieces;
+        if (config.sync == SYNC_ALWAYS) {
+            for (int p = 0; p < pieces; p++) ops[op_count++] = (RecordOp){ RECORD_SYNC, ops[p].file, NULL, 0, 0, 0 };
+        }
+        failed = record_io_submit(ops, op_count) == -1;
+    }
+    if (failed) {
+        // Zero what we wrote so a torn batch loads as unused slots rather than partial records
+        memset(batch, 0, created * sizeof(Item));
+        for (int p = 0; p < locked; p++) {
+            record_write(ops[p].file, batch, ops[p].len, ops[p].offset);
+            unlock_record(fds[p], ops[p].offset, ops[p].len);
+            close(fds[p]);
+        }
+        free(batch);
+        return -1;
+    }
+    snapshot_publish_items(batch, created); // One new version for the whole batch
+    for (int i = 0; i < created; i++) search_index_item(&batch[i]);
+
+    for (int p = 0; p < pieces; p++) {
+        unlock_record(fds[p], ops[p].offset, ops[p].len);
+        close(fds[p]);
+    }
+
+    for (int i = 0; i < created; i++) {
+        schedule_item(batch[i].id, batch[i].end_time);
+    }
+    free(batch);
 
-    struct flock lock;
-    lock.l_type = F_RDLCK;
-    lock.l_whence = SEEK_SET;
-    lock.l_start = 0;
-    lock.l_len = 0; 
-    fcntl(fd, F_SETLKW, &lock);
+    char seller_name[50];
+    get_username(seller_id, seller_name);
+
+    char log_msg[150];
+    sprintf(log_msg, "Seller %d (%s) bulk-listed %d items (IDs %d-%d)", 
+            seller_id, seller_name, created, first_id, first_id + created - 1);
+    write_log(log_msg);
+    return created;
+}
+
+// Served from the published snapshot: no file lock, so it never waits on writers
+int get_all_items(Item *buffer, int max_items) {
+    CatalogSnapshot *snap = snapshot_acquire();
 
     int count = 0;
-    while(read(fd, &buffer[count], sizeof(Item)) > 0 && count < max_items) {
-        count++;
+    int total = snapshot_count(snap);
+    for (int i = snapshot_next(snap, 0); i < total && count < max_items; i = snapshot_next(snap, i + 1)) {
+        const Item *item = snapshot_get(snap, i);
+        buffer[count++] = *item;
     }
 
-    lock.l_type = F_UNLCK;
-    fcntl(fd, F_SETLKW, &lock);
-    close(fd);
+    snapshot_release(snap);
     return count;
 }
 
-int place_bid(int item_id, int user_id, int bid_amount) {
-    int fd = open(ITEM_FILE, O_RDWR);
-    if (fd == -1) return -1;
+static int bid_condition_holds(const Item *item, const BidCondition *cond) {
+    return item->current_bid == cond->expected_price &&
+           (cond->expected_version == 0 || item->version == cond->expected_version);
+}
 
-    off_t offset = (item_id - 1) * sizeof(Item);
+// Records (or raises) a user's entry in the item's bid history
+static void record_bid_history(Item *item, int user_id, int amount) {
+    for(int i = 0; i < item->past_bidders_count; i++) {
+        if(item->past_bidders[i] == user_id) { 
+            item->past_bid_amounts[i] = amount; // <--- Update their personal max bid
+            return;
+        }
+    }
+    if(item->past_bidders_count < MAX_BIDDERS) {
+        item->past_bidders[item->past_bidders_count] = user_id;
+        item->past_bid_amounts[item->past_bidders_count] = amount; // <--- Record their bid
+        item->past_bidders_count++;
+    }
+}
+
+// ---- Bid engine ----
+
+// Escrow movements decided while an item's write lock is held. They are applied together
+// once the outcome is known, so even a combined pass of many bids (below) costs one hold
+// from the final winner and one refund to the winner it displaced.
+typedef struct {
+    int user_id;
+    int delta;
+} EscrowEntry;
+
+typedef struct {
+    EscrowEntry entries[COMBINE_MAX + 1]; // Every bidder in a pass, plus the standing winner
+    int count;
+} EscrowLedger;
+
+static int *ledger_delta(EscrowLedger *ledger, int user_id) {
+    for (int i = 0; i < ledger->count; i++) {
+        if (ledger->entries[i].user_id == user_id) return &ledger->entries[i].delta;
+    }
+    ledger->entries[ledger->count] = (EscrowEntry){ user_id, 0 };
+    return &ledger->entries[ledger->count++].delta;
+}
+
+// What the user could hand over right now, counting what the ledger already moves
+static int ledger_available(EscrowLedger *ledger, int user_id) {
+    return get_user_balance(user_id) + *ledger_delta(ledger, user_id);
+}
+
+// Holds first, then refunds. Returns 0, or the user whose hold failed because their
+// balance moved since the bid was decided (the holds already taken are given back).
+static int ledger_commit(EscrowLedger *ledger) {
+    for (int i = 0; i < ledger->count; i++) {
+        EscrowEntry *e = &ledger->entries[i];
+        if (e->delta >= 0 || update_balance(e->user_id, e->delta) != -2) continue;
+        for (int j = 0; j < i; j++) {
+            if (ledger->entries[j].delta < 0) update_balance(ledger->entries[j].user_id, -ledger->entries[j].delta);
+        }
+        return e->user_id;
+    }
+    for (int i = 0; i < ledger->count; i++) {
+        if (ledger->entries[i].delta > 0) update_balance(ledger->entries[i].user_id, ledger->entries[i].delta);
+    }
+    return 0;
+}
+
+// Decides one bid against the record, which the caller holds the write lock on, and
+// returns the OP_BID result code. Results 1 and -8 change the record and may queue
+// escrow movements; any other result leaves both alone.
+// amount is the exact bid for a plain bid, or the ceiling for a proxy bid.
+// The current winner always has item.winner_max escrowed, which lets a standing
+// proxy defend itself against lower bids without another round trip.
+static int apply_bid(Item *item, int user_id, int amount, int is_proxy, EscrowLedger *ledger) {
+    if (item->seller_id == user_id) return -5; // Cannot bid on your own item
+    if (item->status != ITEM_ACTIVE) return -4;
+    if (time(NULL) >= item->end_time) return -4; // Expired while the bid was on its way
+
+    // A standing winner re-submitting a proxy just raises their own ceiling
+    int raising_ceiling = is_proxy && item->current_winner_id == user_id;
+    int held = item->winner_max;
+
+    if ((raising_ceiling && amount <= held) || amount <= item->current_bid) return -3;
+
+    // --- COOLDOWN CHECK ---
+    uint64_t span = trace_span_begin();
+    int cooldown = get_user_cooldown(user_id);
+    trace_span_end("cooldown", span);
+    if (cooldown > 0) return -7; // Code -7: Cooldown Active
+
+    int result = 1;
+
+    if (raising_ceiling) {
+        // Only the difference needs to be escrowed; the visible price does not move
+        if (ledger_available(ledger, user_id) < amount - held) return -6;
+        *ledger_delta(ledger, user_id) -= amount - held;
+        item->winner_max = amount;
+        record_bid_history(item, user_id, amount);
+    } else if (item->current_winner_id != -1 && item->current_winner_id != user_id && held >= amount) {
+        // --- PROXY DEFENSE: the standing ceiling covers this bid (ties go to the earlier bidder) ---
+        // The price rises to just above the challenger, nobody's escrow changes
+        item->current_bid = (amount + BID_INCREMENT < held) ? amount + BID_INCREMENT : held;
+        record_bid_history(item, user_id, amount);
+        result = -8; // Code -8: Outbid by an existing proxy
+    } else {
+        // Proxies pay one increment over the strongest competitor, plain bids pay what they offered
+        int price = amount;
+        if (is_proxy) {
+            int floor = (item->current_winner_id == -1 || item->current_winner_id == user_id)
+                        ? item->current_bid : held;
+            price = (floor + BID_INCREMENT < amount) ? floor + BID_INCREMENT : amount;
+        }
+
+        // --- ESCROW: Block funds from the new bidder (proxies at their ceiling) ---
+        if (ledger_available(ledger, user_id) < amount) return -6; // Code -6 means Insufficient Funds
+        *ledger_delta(ledger, user_id) -= amount;
+
+        // --- ESCROW: Refund the previous bidder's blocked money ---
+        if (item->current_winner_id != -1) *ledger_delta(ledger, item->current_winner_id) += held;
+
+        record_bid_history(item, user_id, amount);
+        item->current_bid = price;
+        item->current_winner_id = user_id;
+        item->winner_max = amount;
+    }
+
+    // --- SOFT CLOSE: a late bid pushes the deadline out ---
+    if (item->soft_close_window > 0 && item->end_time - time(NULL) <= item->soft_close_window) {
+        item->end_time += item->soft_close_extend;
+    }
+    return result;
+}
 
-    struct flock lock;
-    lock.l_type = F_WRLCK;
-    lock.l_whence = SEEK_SET;
-    lock.l_start = offset;
-    lock.l_len = sizeof(Item);
+// Audit line for a bid that changed the item (result 1 or -8)
+static void log_bid(const Item *item, int user_id, int amount, int is_proxy, int result) {
+    char bidder_name[50];
+    get_username(user_id, bidder_name); // Use the helper
     
-    if (fcntl(fd, F_SETLKW, &lock) == -1) {
+    char log_msg[200];
+    if (result == -8) {
+        sprintf(log_msg, "User %d (%s) was outbid by a proxy on Item %d (%s), price now $%d", 
+                user_id, bidder_name, item->id, item->name, item->current_bid);
+    } else if (is_proxy) {
+        sprintf(log_msg, "User %d (%s) set proxy ceiling $%d on Item %d (%s), price now $%d", 
+                user_id, bidder_name, amount, item->id, item->name, item->current_bid);
+    } else {
+        sprintf(log_msg, "User %d (%s) placed bid $%d on Item %d (%s)", 
+                user_id, bidder_name, amount, item->id, item->name);
+    }
+    write_log(log_msg);
+}
+
+// Re-keys the expiry queue after late bids moved the deadline
+static void log_extension(const Item *item, time_t old_end) {
+    schedule_item(item->id, item->end_time);
+    char log_msg[200];
+    sprintf(log_msg, "Soft-Close: Item %d extended by %lds after a late bid", item->id, (long)(item->end_time - old_end));
+    write_log(log_msg);
+}
+
+// Writes a changed record back and publishes it. Caller holds the write lock.
+static int write_bid_item(int fd, Item *item, off_t offset) {
+    item->version++;
+    uint64_t span = trace_span_begin();
+    if (record_write(item_store_file(item->id), item, sizeof(Item), offset) != sizeof(Item)) return -1;
+    sync_record_write(fd);
+    trace_span_end("write", span);
+
+    span = trace_span_begin();
+    item_changed(item);
+    trace_span_end("publish", span);
+    return 0;
+}
+
+// A single bid of any kind under the item's write lock.
+// cond (OP_COND_BID only, else NULL) makes the bid conditional on the item's state.
+static int submit_bid(int item_id, int user_id, int amount, int is_proxy, BidCondition *cond) {
+    if (!valid_item_id(item_id)) return -2;
+
+    if (cond) {
+        cond->price = 0;
+        cond->version = 0;
+        // Optimistic check against the published snapshot, without opening or locking the
+        // record. Writers publish before they unlock, so the snapshot is never behind
+        // anything the client could have seen: a mismatch here is a real conflict.
+        CatalogSnapshot *snap = snapshot_acquire();
+        const Item *seen = item_id <= snapshot_count(snap) ? snapshot_get(snap, item_id - 1) : NULL;
+        int stale = seen && seen->id == item_id && !bid_condition_holds(seen, cond);
+        if (stale) {
+            cond->price = seen->current_bid;
+            cond->version = seen->version;
+        }
+        snapshot_release(snap);
+        if (stale) return -9;
+    }
+
+    int fd = item_store_open(item_id, O_RDWR);
+    if (fd == -1) return -1;
+    off_t offset = item_store_offset(item_id);
+
+    if (lock_record(fd, F_WRLCK, offset, sizeof(Item)) == -1) {
         close(fd);
         return -1;
     }
 
     Item item;
-    lseek(fd, offset, SEEK_SET);
-    if (read(fd, &item, sizeof(Item)) <= 0) {
-        lock.l_type = F_UNLCK; fcntl(fd, F_SETLKW, &lock); close(fd);
+    uint64_t span = trace_span_begin();
+    if (record_read(item_store_file(item_id), &item, sizeof(Item), offset) <= 0) {
+        unlock_record(fd, offset, sizeof(Item)); close(fd);
         return -2; 
     }
-
-    if (item.seller_id == user_id) {
-        lock.l_type = F_UNLCK; fcntl(fd, F_SETLKW, &lock); close(fd);
-        return -5; // Cannot bid on your own item
+    trace_span_end("read", span);
+    if (cond) {
+        cond->price = item.current_bid;
+        cond->version = item.version;
     }
 
-    if (item.status != ITEM_ACTIVE) {
-        lock.l_type = F_UNLCK; fcntl(fd, F_SETLKW, &lock); close(fd);
-        return -4; 
+    // The compare-and-set proper: someone may have got in since the snapshot check
+    if (cond && !bid_condition_holds(&item, cond)) {
+        unlock_record(fd, offset, sizeof(Item)); close(fd);
+        return -9; // Code -9: Item changed since the client saw it
     }
-    
-    // ADDED: Check if time expired while placing bid
-    if (time(NULL) >= item.end_time) {
-         lock.l_type = F_UNLCK; fcntl(fd, F_SETLKW, &lock); close(fd);
-         return -4; 
+
+    EscrowLedger ledger = { .count = 0 };
+    time_t old_end = item.end_time;
+    int result = apply_bid(&item, user_id, amount, is_proxy, &ledger);
+    if (result != 1 && result != -8) {
+        unlock_record(fd, offset, sizeof(Item)); close(fd);
+        return result;
     }
 
-    if (bid_amount <= item.current_bid) {
-        lock.l_type = F_UNLCK; fcntl(fd, F_SETLKW, &lock); close(fd);
-        return -3; 
+    span = trace_span_begin();
+    if (ledger_commit(&ledger) != 0) {
+        unlock_record(fd, offset, sizeof(Item)); close(fd);
+        return -6;
     }
+    trace_span_end("escrow", span);
 
-    // --- COOLDOWN CHECK ---
-    if (get_user_cooldown(user_id) > 0) {
-        lock.l_type = F_UNLCK; fcntl(fd, F_SETLKW, &lock); close(fd);
-        return -7; // Code -7: Cooldown Active
+    if (write_bid_item(fd, &item, offset) == -1) {
+        // The escrow already moved; the record on disk no longer matches it
+        unlock_record(fd, offset, sizeof(Item)); close(fd);
+        return -1;
     }
+    if (cond) {
+        cond->price = item.current_bid;
+        cond->version = item.version;
+    }
+
+    unlock_record(fd, offset, sizeof(Item));
+    close(fd);
+
+    span = trace_span_begin();
+    log_bid(&item, user_id, amount, is_proxy, result);
+    trace_span_end("log", span);
+    if (item.end_time != old_end) log_extension(&item, old_end);
+    return result;
+}
 
-    // --- ESCROW: Block (deduct) funds from the new bidder ---
-    // Passing negative bid_amount to deduct it
-    if (update_balance(user_id, -bid_amount) == -2) {
-        lock.l_type = F_UNLCK; 
-        fcntl(fd, F_SETLKW, &lock); 
+// ---- Bid combining ----
+//
+// Plain bids on the same item queue up instead of each taking the record lock in turn.
+// Whichever thread finds nobody combining for the item takes the queue (up to
+// COMBINE_MAX bids) and decides all of it in one pass: one lock, one read, every bid
+// applied in arrival order exactly as apply_bid would one at a time, one ledger commit,
+// one write. It then hands each waiter its result. Bids arriving meanwhile queue for
+// the next pass, which the head of the queue runs.
+
+typedef struct PendingBid {
+    int user_id;
+    int amount;
+    int result;
+    int done;              // result is in
+    pthread_cond_t wake;   // Signalled when done, or when this bid heads the queue
+    struct PendingBid *next;
+} PendingBid;
+
+// Plain bids queued on one item
+typedef struct ItemQueue {
+    int item_id;
+    int busy;                  // A pass is running for this item
+    PendingBid *head, *tail;   // Not yet taken by a pass
+    struct ItemQueue *next;
+} ItemQueue;
+
+typedef struct {
+    pthread_mutex_t lock;
+    ItemQueue *items;          // Items with bids in flight
+} CombineBucket;
+
+static CombineBucket combine_buckets[COMBINE_BUCKETS];
+static pthread_once_t combine_once = PTHREAD_ONCE_INIT;
+
+static void combine_init() {
+    for (int i = 0; i < COMBINE_BUCKETS; i++) pthread_mutex_init(&combine_buckets[i].lock, NULL);
+}
+
+// Decides bids[0..count) on item_id in one locked read-modify-write
+static void combine_pass(int item_id, PendingBid **bids, int count) {
+    for (int i = 0; i < count; i++) bids[i]->result = -1;
+
+    int fd = item_store_open(item_id, O_RDWR);
+    if (fd == -1) return;
+    off_t offset = item_store_offset(item_id);
+    if (lock_record(fd, F_WRLCK, offset, sizeof(Item)) == -1) {
         close(fd);
-        return -6; // Code -6 means Insufficient Funds
+        return;
     }
 
-    // --- ESCROW: Refund the previous bidder ---
-    // If someone else had the high bid, give them their blocked money back
-    if (item.current_winner_id != -1) {
-        update_balance(item.current_winner_id, item.current_bid); 
+    Item original, item;
+    uint64_t span = trace_span_begin();
+    if (record_read(item_store_file(item_id), &original, sizeof(Item), offset) <= 0) {
+        unlock_record(fd, offset, sizeof(Item)); close(fd);
+        for (int i = 0; i < count; i++) bids[i]->result = -2;
+        return;
     }
-
-    int found_in_history = 0;
-    for(int i = 0; i < item.past_bidders_count; i++) {
-        if(item.past_bidders[i] == user_id) { 
-            item.past_bid_amounts[i] = bid_amount; // <--- Update their personal max bid
-            found_in_history = 1; 
-            break; 
+    trace_span_end("read", span);
+
+    // A winner's hold can still fail at commit if their balance moved after their bid
+    // was decided. Their bids are then ruled out (-6) and the pass is decided again.
+    int excluded[COMBINE_MAX];
+    int excluded_count = 0;
+    int changed;
+    EscrowLedger ledger;
+    while (1) {
+        item = original;
+        ledger.count = 0;
+        changed = 0;
+        for (int i = 0; i < count; i++) {
+            int ruled_out = 0;
+            for (int x = 0; x < excluded_count; x++) ruled_out |= excluded[x] == bids[i]->user_id;
+            bids[i]->result = ruled_out ? -6 : apply_bid(&item, bids[i]->user_id, bids[i]->amount, 0, &ledger);
+            if (bids[i]->result == 1 || bids[i]->result == -8) changed = 1;
         }
+        if (!changed) break;
+        span = trace_span_begin();
+        int failed = ledger_commit(&ledger);
+        trace_span_end("escrow", span);
+        if (failed == 0) break;
+        excluded[excluded_count++] = failed;
     }
-    if(!found_in_history && item.past_bidders_count < MAX_BIDDERS) {
-        item.past_bidders[item.past_bidders_count] = user_id;
-        item.past_bid_amounts[item.past_bidders_count] = bid_amount; // <--- Record their bid
-        item.past_bidders_count++;
+
+    if (changed && write_bid_item(fd, &item, offset) == -1) {
+        for (int i = 0; i < count; i++) {
+            if (bids[i]->result == 1 || bids[i]->result == -8) bids[i]->result = -1;
+        }
+        changed = 0;
     }
+    unlock_record(fd, offset, sizeof(Item));
+    close(fd);
+    if (!changed) return;
 
-    item.current_bid = bid_amount;
-    item.current_winner_id = user_id;
-    
-    lseek(fd, offset, SEEK_SET);
-    if (write(fd, &item, sizeof(Item)) != sizeof(Item)) {
-        lock.l_type = F_UNLCK; fcntl(fd, F_SETLKW, &lock); close(fd);
-        return -1;
+    span = trace_span_begin();
+    for (int i = 0; i < count; i++) {
+        if (bids[i]->result == 1 || bids[i]->result == -8) log_bid(&item, bids[i]->user_id, bids[i]->amount, 0, bids[i]->result);
     }
+    trace_span_end("log", span);
+    if (item.end_time != original.end_time) log_extension(&item, original.end_time);
+}
 
-    lock.l_type = F_UNLCK;
-    fcntl(fd, F_SETLKW, &lock);
-    close(fd);
+int place_bid(int item_id, int user_id, int bid_amount) {
+    if (!config.bid_combining || !valid_item_id(item_id)) return submit_bid(item_id, user_id, bid_amount, 0, NULL);
+    pthread_once(&combine_once, combine_init);
+    CombineBucket *bucket = &combine_buckets[item_id % COMBINE_BUCKETS];
+
+    PendingBid me = { .user_id = user_id, .amount = bid_amount, .result = -1, .done = 0, .next = NULL };
+    pthread_mutex_lock(&bucket->lock);
+    ItemQueue *queue = bucket->items;
+    while (queue && queue->item_id != item_id) queue = queue->next;
+    if (queue == NULL) {
+        queue = calloc(1, sizeof(ItemQueue));
+        if (queue == NULL) {
+            pthread_mutex_unlock(&bucket->lock);
+            return submit_bid(item_id, user_id, bid_amount, 0, NULL);
+        }
+        queue->item_id = item_id;
+        queue->next = bucket->items;
+        bucket->items = queue;
+    }
+    pthread_cond_init(&me.wake, NULL);
+    if (queue->tail) queue->tail->next = &me;
+    else queue->head = &me;
+    queue->tail = &me;
+
+    while (!me.done) {
+        if (queue->busy) {
+            pthread_cond_wait(&me.wake, &bucket->lock);
+            continue;
+        }
+        // Nobody is combining for this item: take the queue and run a pass
+        PendingBid *batch[COMBINE_MAX];
+        int count = 0;
+        while (queue->head && count < COMBINE_MAX) {
+            batch[count++] = queue->head;
+            queue->head = queue->head->next;
+        }
+        if (queue->head == NULL) queue->tail = NULL;
+        queue->busy = 1;
+        pthread_mutex_unlock(&bucket->lock);
+
+        uint64_t span = trace_span_begin();
+        combine_pass(item_id, batch, count);
+        trace_span_end("combine", span);
+
+        pthread_mutex_lock(&bucket->lock);
+        queue->busy = 0;
+        for (int i = 0; i < count; i++) {
+            batch[i]->done = 1;
+            if (batch[i] != &me) pthread_cond_signal(&batch[i]->wake);
+        }
+        if (queue->head) {
+            pthread_cond_signal(&queue->head->wake); // Next in line runs the next pass
+        } else {
+            // Only we can still see this queue: every bid in it has its result
+            ItemQueue **link = &bucket->items;
+            while (*link != queue) link = &(*link)->next;
+            *link = queue->next;
+            free(queue);
+        }
+    }
+    pthread_mutex_unlock(&bucket->lock);
+    pthread_cond_destroy(&me.wake);
+    return me.result;
+}
 
-    char bidder_name[50];
-    get_username(user_id, bidder_name); // Use the helper
-    
-    char log_msg[200];
-    sprintf(log_msg, "User %d (%s) placed bid $%d on Item %d (%s)", 
-            user_id, bidder_name, bid_amount, item_id, item.name);
-    write_log(log_msg);
-    return 1;
+int place_proxy_bid(int item_id, int user_id, int max_amount) {
+    return submit_bid(item_id, user_id, max_amount, 1, NULL);
 }
 
-int close_auction(int item_id, int seller_id) {
-    int fd = open(ITEM_FILE, O_RDWR);
-    if (fd == -1) return -1;
+int place_conditional_bid(int item_id, int user_id, int bid_amount, BidCondition *cond) {
+    return submit_bid(item_id, user_id, bid_amount, 0, cond);
+}
 
-    if (item_id <= 0) {
-        close(fd); 
-        return -4;
+// Bids on many items in one request; each entry goes through the normal bid engine
+void place_bids_bulk(BulkBidEntry *entries, int count, int user_id, int *status) {
+    for (int i = 0; i < count; i++) {
+        status[i] = place_bid(entries[i].item_id, user_id, entries[i].amount);
     }
+}
 
-    off_t offset = (item_id - 1) * sizeof(Item);
+int close_auction(int item_id, int seller_id) {
+    if (!valid_item_id(item_id)) return -4;
+
+    int fd = item_store_open(item_id, O_RDWR);
+    if (fd == -1) return -1;
+    off_t offset = item_store_offset(item_id);
 
     if (lock_record(fd, F_WRLCK, offset, sizeof(Item)) == -1) {
         close(fd); return -1;
     }
 
     Item item;
-    lseek(fd, offset, SEEK_SET);
-    
-    if (read(fd, &item, sizeof(Item)) <= 0) {
+    int file = item_store_file(item_id);
+    if (record_read(file, &item, sizeof(Item), offset) <= 0) {
         unlock_record(fd, offset, sizeof(Item)); 
         close(fd); 
         return -4; // Code -4: Item does not exist / Invalid ID
@@ -224,25 +695,37 @@ int close_auction(int item_id, int seller_id) {
     if (item.current_winner_id == -1) {
         item.status = ITEM_SOLD;
         item.end_time = time(NULL); // <--- FORCE TIMER TO END NOW
+        item.version++;
         
-        lseek(fd, offset, SEEK_SET); write(fd, &item, sizeof(Item));
+        record_write(file, &item, sizeof(Item), offset);
+        sync_record_write(fd);
+        item_changed(&item);
         unlock_record(fd, offset, sizeof(Item)); close(fd);
+        unschedule_item(item_id);
         return 0; 
     }
 
     int trans_status = update_balance(item.seller_id, item.current_bid);
 
     if (trans_status == 1) {
+        // Return whatever part of a proxy ceiling was not needed
+        if (item.winner_max > item.current_bid) {
+            update_balance(item.current_winner_id, item.winner_max - item.current_bid);
+        }
         item.status = ITEM_SOLD;
         item.end_time = time(NULL); // <--- FORCE TIMER TO END NOW
+        item.version++;
         
-        lseek(fd, offset, SEEK_SET);
-        write(fd, &item, sizeof(Item));
+        record_write(file, &item, sizeof(Item), offset);
+        sync_record_write(fd);
+        item_changed(&item);
     }
 
     unlock_record(fd, offset, sizeof(Item));
     close(fd);
 
+    if (trans_status == 1) unschedule_item(item_id);
+
     char log_msg[200];
     if (item.current_winner_id == -1) {
         sprintf(log_msg, "Auction concluded manually for Item %d (%s) - No Bids.", 
@@ -259,136 +742,231 @@ int close_auction(int item_id, int seller_id) {
     return trans_status; 
 }
 
+// Full-text search over active listings, ranked by end time (soonest first)
+int search_items(const char *query, Item *buffer, int max_items) {
+    int ids[max_items > 0 ? max_items : 1];
+    int found = search_index_query(query, ids, max_items);
+
+    CatalogSnapshot *snap = snapshot_acquire();
+    int count = 0;
+    for (int i = 0; i < found; i++) {
+        const Item *item = snapshot_get(snap, ids[i] - 1);
+        if (item != NULL && item->status == ITEM_ACTIVE) buffer[count++] = *item;
+    }
+    snapshot_release(snap);
+    return count;
+}
+
 int get_my_bids(int user_id, Item *buffer, int max_items) {
-    int fd = open(ITEM_FILE, O_RDONLY);
-    if (fd == -1) return 0;
-    if (lock_record(fd, F_RDLCK, 0, 0) == -1) { close(fd); return 0; }
+    CatalogSnapshot *snap = snapshot_acquire();
 
-    Item item;
     int count = 0;
-    while(read(fd, &item, sizeof(Item)) > 0 && count < max_items) {
-        if (item.status == ITEM_ACTIVE) {
+    int total = snapshot_count(snap);
+    for (int i = snapshot_next(snap, 0); i < total && count < max_items; i = snapshot_next(snap, i + 1)) {
+        const Item *item = snapshot_get(snap, i);
+        if (item->status == ITEM_ACTIVE) {
             // Check if they are winning
-            if (item.current_winner_id == user_id) {
-                buffer[count++] = item;
+            if (item->current_winner_id == user_id) {
+                buffer[count++] = *item;
             } else {
                 // Check if they bid previously but are losing
-                for(int i = 0; i < item.past_bidders_count; i++) {
-                    if(item.past_bidders[i] == user_id) {
-                        buffer[count++] = item;
+                for(int j = 0; j < item->past_bidders_count; j++) {
+                    if(item->past_bidders[j] == user_id) {
+                        buffer[count++] = *item;
                         break;
                     }
                 }
             }
         }
     }
-    unlock_record(fd, 0, 0); close(fd);
+    snapshot_release(snap);
     return count;
 }
 
+// Called by the segment loaders, several at once; every step below is thread-safe
+static void load_items(Item *items, int count) {
+    snapshot_publish_items(items, count);
+    for (int i = 0; i < count; i++) {
+        search_index_item(&items[i]);
+        if (items[i].status == ITEM_ACTIVE) {
+            schedule_item(items[i].id, items[i].end_time);
+        }
+    }
+}
+
 // Background Monitor Logic
-void check_expired_items() {
-    int fd = open(ITEM_FILE, O_RDWR);
-    if (fd == -1) return;
+// Loads every segment into the read snapshot, queues active auctions for expiry and
+// seeds the item ID counter. Call item_store_init() first.
+// (run once at startup, before any client thread exists)
+void init_items() {
+    int slots = item_store_load(load_items);
+    atomic_store(&next_item_id, slots + 1);
+}
 
-    Item item;
-    off_t offset = 0;
-    time_t now = time(NULL);
-
-    while (pread(fd, &item, sizeof(Item), offset) > 0) {
-        if (item.status == ITEM_ACTIVE && item.end_time <= now) {
-            
-            if (lock_record(fd, F_WRLCK, offset, sizeof(Item)) == -1) {
-                offset += sizeof(Item); continue;
-            }
+// Settles due auctions ids[0..count): one segment, ascending IDs, at most SETTLE_BATCH.
+// Every record is locked, then all are read in one batch, settled in memory and written
+// back in a second batch (with a single fdatasync when sync = always).
+static void settle_items(const int *ids, int count) {
+    // The IDs have already left the expiry queue, so any we cannot get at go back on it
+    int fd = item_store_open(ids[0], O_RDWR);
+    if (fd == -1) {
+        for (int i = 0; i < count; i++) schedule_item(ids[i], time(NULL) + SETTLE_RETRY_S);
+        return;
+    }
+    int file = item_store_file(ids[0]);
+
+    Item items[SETTLE_BATCH];
+    RecordOp reads[SETTLE_BATCH], writes[SETTLE_BATCH + 1];
+    int locked = 0, written = 0;
+    for (int i = 0; i < count; i++) {
+        off_t offset = item_store_offset(ids[i]);
+        if (lock_record(fd, F_WRLCK, offset, sizeof(Item)) == -1) {
+            schedule_item(ids[i], time(NULL) + SETTLE_RETRY_S);
+            continue;
+        }
+        reads[locked] = (RecordOp){ RECORD_READ, file, &items[locked], sizeof(Item), offset, 0 };
+        locked++;
+    }
+    record_io_submit(reads, locked);
 
-            pread(fd, &item, sizeof(Item), offset);
-            
-            if (item.status == ITEM_ACTIVE) {
-                if (item.current_winner_id != -1) {
-                    update_balance(item.seller_id, item.current_bid);
-                    char log[100];
-                    sprintf(log, "Auto-Close: Item %d sold to %d for %d", item.id, item.current_winner_id, item.current_bid);
-                    write_log(log);
-                } else {
-                    // FIX: Use sprintf for write_log
-                    char log[100];
-                    sprintf(log, "Auto-Close: Item %d expired (No Bids)", item.id);
-                    write_log(log);
-                }
+    for (int i = 0; i < locked; i++) {
+        Item *item = &items[i];
+        if (reads[i].result != sizeof(Item) || item->status != ITEM_ACTIVE) continue;
+
+        // A late bid may have extended the deadline after we were woken up
+        if (item->end_time > time(NULL)) {
+            schedule_item(item->id, item->end_time);
+            continue;
+        }
 
-                item.status = ITEM_SOLD;
-                pwrite(fd, &item, sizeof(Item), offset);
+        if (item->current_winner_id != -1) {
+            update_balance(item->seller_id, item->current_bid);
+            if (item->winner_max > item->current_bid) {
+                update_balance(item->current_winner_id, item->winner_max - item->current_bid);
             }
-            
-            unlock_record(fd, offset, sizeof(Item));
+            char log[100];
+            sprintf(log, "Auto-Close: Item %d sold to %d for %d", item->id, item->current_winner_id, item->current_bid);
+            write_log(log);
+        } else {
+            // FIX: Use sprintf for write_log
+            char log[100];
+            sprintf(log, "Auto-Close: Item %d expired (No Bids)", item->id);
+            write_log(log);
         }
-        offset += sizeof(Item);
+
+        item->status = ITEM_SOLD;
+        item->version++;
+        writes[written++] = (RecordOp){ RECORD_WRITE, file, item, sizeof(Item), reads[i].offset, 0 };
+    }
+
+    if (written > 0) {
+        int op_count = written;
+        if (config.sync == SYNC_ALWAYS) writes[op_count++] = (RecordOp){ RECORD_SYNC, file, NULL, 0, 0, 0 };
+        record_io_submit(writes, op_count);
+        for (int w = 0; w < written; w++) item_changed(writes[w].buf);
     }
+
+    for (int i = 0; i < locked; i++) unlock_record(fd, reads[i].offset, sizeof(Item));
     close(fd);
 }
 
-// Returns completed transactions (Items Sold or Items Won)
-int get_transaction_history(int user_id, Item *buffer, int max_items) {
-    int fd = open(ITEM_FILE, O_RDONLY);
-    if (fd == -1) return 0;
+static int compare_ids(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
 
-    // Shared lock for reading
-    if (lock_record(fd, F_RDLCK, 0, 0) == -1) { 
-        close(fd); return 0;
+// Blocks until the scheduler reports due auctions, then closes them
+void check_expired_items() {
+    int due[config.monitor_batch];
+    int count = wait_for_expired(due, config.monitor_batch);
+    uint64_t tick_start = metrics_now_ns();
+
+    // Ascending IDs give one lock order, put each segment's items side by side and
+    // bring duplicates together so an auction is never settled twice in one batch
+    qsort(due, count, sizeof(int), compare_ids);
+    int unique = 0;
+    for (int i = 0; i < count; i++) {
+        if (unique == 0 || due[i] != due[unique - 1]) due[unique++] = due[i];
     }
 
-    Item item;
-    int count = 0;
-    while(read(fd, &item, sizeof(Item)) > 0 && count < max_items) {
+    for (int start = 0; start < unique; ) {
+        int end = start + 1;
+        while (end < unique && end - start < SETTLE_BATCH &&
+               item_store_segment_of(due[end]) == item_store_segment_of(due[start])) end++;
+        settle_items(due + start, end - start);
+        start = end;
+    }
+    if (count > 0) metrics_record_monitor_tick(metrics_now_ns() - tick_start, count);
+}
+
+static void reverse_items(Item *items, int from, int to) {
+    for (to--; from < to; from++, to--) {
+        Item tmp = items[from];
+        items[from] = items[to];
+        items[to] = tmp;
+    }
+}
+
+// Returns completed transactions (Items Sold or Items Won), newest first:
+// the ones still in the live store, then archived ones
+int get_transaction_history(int user_id, Item *buffer, int max_items) {
+    if (max_items <= 0) return 0;
+
+    // Live rows go round buffer as a ring, so the last max_items by ID survive
+    int seen = 0;
+    CatalogSnapshot *snap = snapshot_acquire();
+    int total = snapshot_count(snap);
+    for (int i = snapshot_next(snap, 0); i < total; i = snapshot_next(snap, i + 1)) {
+        const Item *item = snapshot_get(snap, i);
         // Condition: Item is SOLD and the user is either the Seller or the Winner
-        if (item.status == ITEM_SOLD && 
-           (item.seller_id == user_id || item.current_winner_id == user_id)) {
-            buffer[count++] = item;
+        if (item->status == ITEM_SOLD && 
+           (item->seller_id == user_id || item->current_winner_id == user_id) &&
+           !archive_contains(item->id)) { // Archived but not yet removed (a crash in between)
+            buffer[seen++ % max_items] = *item;
         }
     }
+    snapshot_release(snap);
 
-    unlock_record(fd, 0, 0);
-    close(fd);
-    return count;
+    // The oldest surviving row sits at `oldest`; reversing both runs of the ring
+    // leaves it in descending ID order
+    int count = seen < max_items ? seen : max_items;
+    int oldest = seen > max_items ? seen % max_items : 0;
+    reverse_items(buffer, 0, oldest);
+    reverse_items(buffer, oldest, count);
+
+    return count + archive_history(user_id, buffer + count, max_items - count);
 }
 
 int is_user_seller(int user_id) {
-    int fd = open(ITEM_FILE, O_RDONLY);
-    if (fd == -1) return 0;
+    CatalogSnapshot *snap = snapshot_acquire();
 
-    // Shared lock for reading
-    if (lock_record(fd, F_RDLCK, 0, 0) == -1) {
-        close(fd); return 0;
-    }
-
-    Item item;
     int found = 0;
-    while(read(fd, &item, sizeof(Item)) > 0) {
-        if (item.seller_id == user_id && item.status == ITEM_ACTIVE) {
+    int total = snapshot_count(snap);
+    for (int i = snapshot_next(snap, 0); i < total; i = snapshot_next(snap, i + 1)) {
+        const Item *item = snapshot_get(snap, i);
+        if (item->seller_id == user_id && item->status == ITEM_ACTIVE) {
             found = 1;
             break; 
         }
     }
 
-    unlock_record(fd, 0, 0);
-    close(fd);
+    snapshot_release(snap);
     return found;
 }
 
 int withdraw_bid(int item_id, int user_id) {
-    int fd = open(ITEM_FILE, O_RDWR);
-    if (fd == -1) return -1;
-    if (item_id <= 0) { close(fd); return -4; } 
+    if (!valid_item_id(item_id)) return -4;
 
-    off_t offset = (item_id - 1) * sizeof(Item);
+    int fd = item_store_open(item_id, O_RDWR);
+    if (fd == -1) return -1;
+    off_t offset = item_store_offset(item_id);
     if (lock_record(fd, F_WRLCK, offset, sizeof(Item)) == -1) {
         close(fd); return -1;
     }
 
     Item item;
-    lseek(fd, offset, SEEK_SET);
-    if (read(fd, &item, sizeof(Item)) <= 0) {
+    int file = item_store_file(item_id);
+    if (record_read(file, &item, sizeof(Item), offset) <= 0) {
         unlock_record(fd, offset, sizeof(Item)); close(fd); return -4;
     }
 
@@ -399,8 +977,8 @@ int withdraw_bid(int item_id, int user_id) {
         unlock_record(fd, offset, sizeof(Item)); close(fd); return -3; 
     }
 
-    // 1. Refund the withdrawing user's escrowed funds
-    update_balance(user_id, item.current_bid);
+    // 1. Refund the withdrawing user's escrowed funds (their full proxy ceiling, if any)
+    update_balance(user_id, item.winner_max);
 
     // 2. Erase withdrawing user's bid from history so they aren't chosen again
     for(int i = 0; i < item.past_bidders_count; i++) {
@@ -412,16 +990,16 @@ int withdraw_bid(int item_id, int user_id) {
 
     // 3. Find the highest remaining valid bidder who can afford the escrow
     int new_winner_id = -1;
-    int new_high_bid = 0;
+    int new_price = 0;
+    int new_max = 0;
 
     while(1) {
-        int max_bid = 0;
         int max_idx = -1;
 
-        // Scan the history for the highest remaining bid amount
+        // Scan the history for the highest remaining bid amount (ties go to the earlier bidder)
         for(int i = 0; i < item.past_bidders_count; i++) {
-            if(item.past_bid_amounts[i] > max_bid) {
-                max_bid = item.past_bid_amounts[i];
+            if(item.past_bid_amounts[i] > 0 &&
+               (max_idx == -1 || item.past_bid_amounts[i] > item.past_bid_amounts[max_idx])) {
                 max_idx = i;
             }
         }
@@ -431,26 +1009,44 @@ int withdraw_bid(int item_id, int user_id) {
             break;
         }
 
-        // Try to deduct (escrow) the funds from this next highest bidder
-        if (update_balance(item.past_bidders[max_idx], -max_bid) == 1) {
-            // Success! They have enough funds. They are the new winner.
-            new_winner_id = item.past_bidders[max_idx];
-            new_high_bid = max_bid;
-            break;
+        // The recorded amount is a proxy's ceiling, not a price. Price it the way apply_bid
+        // prices a proxy: one increment over the strongest bid still standing against it.
+        int ceiling = item.past_bid_amounts[max_idx];
+        int floor = item.base_price;
+        for(int i = 0; i < item.past_bidders_count; i++) {
+            if(i != max_idx && item.past_bid_amounts[i] > floor) floor = item.past_bid_amounts[i];
+        }
+        int price = (floor + BID_INCREMENT < ceiling) ? floor + BID_INCREMENT : ceiling;
+
+        // Escrow the ceiling, as apply_bid does, so the proxy can still defend itself.
+        // A bidder who can no longer cover it but can cover the price wins at the price.
+        int user = item.past_bidders[max_idx];
+        if (update_balance(user, -ceiling) == 1) {
+            new_max = ceiling;
+        } else if (update_balance(user, -price) == 1) {
+            new_max = price;
+            item.past_bid_amounts[max_idx] = price;
         } else {
             // They spent their refunded money elsewhere and can't afford this anymore!
             // Disqualify their bid and loop again to find the NEXT highest.
             item.past_bid_amounts[max_idx] = 0;
+            continue;
         }
+        new_winner_id = user;
+        new_price = price;
+        break;
     }
 
     // 4. Update the item's state with the new winner (or -1 and $0 if no one was left)
     item.current_winner_id = new_winner_id;
-    item.current_bid = new_high_bid;
+    item.current_bid = new_price;
+    item.winner_max = new_max;
+    item.version++;
 
     // Write back to the database
-    lseek(fd, offset, SEEK_SET);
-    write(fd, &item, sizeof(Item));
+    record_write(file, &item, sizeof(Item), offset);
+    sync_record_write(fd);
+    item_changed(&item);
 
     unlock_record(fd, offset, sizeof(Item));
     close(fd);
@@ -458,24 +1054,18 @@ int withdraw_bid(int item_id, int user_id) {
 }
 
 int has_active_bids(int user_id) {
-    int fd = open(ITEM_FILE, O_RDONLY);
-    if (fd == -1) return 0;
-
-    // Shared lock for reading
-    if (lock_record(fd, F_RDLCK, 0, 0) == -1) {
-        close(fd); return 0;
-    }
+    CatalogSnapshot *snap = snapshot_acquire();
 
-    Item item;
     int found = 0;
-    while(read(fd, &item, sizeof(Item)) > 0) {
-        if (item.current_winner_id == user_id && item.status == ITEM_ACTIVE) {
+    int total = snapshot_count(snap);
+    for (int i = snapshot_next(snap, 0); i < total; i = snapshot_next(snap, i + 1)) {
+        const Item *item = snapshot_get(snap, i);
+        if (item->current_winner_id == user_id && item->status == ITEM_ACTIVE) {
             found = 1;
             break; 
         }
     }
 
-    unlock_record(fd, 0, 0);
-    close(fd);
+    snapshot_release(snap);
     return found;
-}
\ No newline at end of file
+}
@@ -0,0 +1,412 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "config.h"
+#include "file_handler.h"
+#include "item_store.h"
+#include "record_io.h"
+
+#define SEGMENT_MAX 16384        // Segment files the directory can describe
+#define SEGMENT_PREALLOC 256     // Record slots reserved on disk at a time
+#define SEGMENT_MAGIC "AUCSEG02"  // 02: Item records carry a version
+
+// On-disk directory. Rewritten (to a temp file, then renamed) whenever a segment is added.
+typedef struct {
+    char magic[8];
+    int segment_items;   // Records per segment, fixed at creation
+    int segment_count;   // seg-00000.dat .. seg-<count-1>.dat exist
+} SegmentDirectory;
+
+static int segment_items = 0;
+static atomic_int segment_count = 0;
+static int segment_fds[SEGMENT_MAX];   // Kept open for preallocation, loading and sync
+static int segment_files[SEGMENT_MAX]; // The same descriptors' record_io slots
+static pthread_mutex_t segment_lock = PTHREAD_MUTEX_INITIALIZER; // Adding segments
+
+static void segment_path(int segment, char *path, size_t len) {
+    snprintf(path, len, "%s/seg-%05d.dat", config.items_dir, segment);
+}
+
+int item_store_segment_of(int item_id) {
+    return (item_id - 1) / segment_items;
+}
+
+int item_store_segment_last_id(int segment) {
+    return (segment + 1) * segment_items;
+}
+
+off_t item_store_offset(int item_id) {
+    return (off_t)((item_id - 1) % segment_items) * sizeof(Item);
+}
+
+int item_store_open(int item_id, int flags) {
+    int segment = item_store_segment_of(item_id);
+    if (item_id <= 0 || segment >= atomic_load(&segment_count)) return -1;
+
+    char path[CONFIG_PATH_LEN + 32];
+    segment_path(segment, path, sizeof(path));
+    return open(path, flags);
+}
+
+int item_store_file(int item_id) {
+    int segment = item_store_segment_of(item_id);
+    if (item_id <= 0 || segment >= atomic_load(&segment_count)) return -1;
+    return segment_files[segment];
+}
+
+// Writes the directory with `count` segments; the rename makes the update atomic
+static int write_directory(int count) {
+    SegmentDirectory dir;
+    memset(&dir, 0, sizeof(dir));
+    memcpy(dir.magic, SEGMENT_MAGIC, sizeof(dir.magic));
+    dir.segment_items = segment_items;
+    dir.segment_count = count;
+
+    char path[CONFIG_PATH_LEN + 32], tmp[CONFIG_PATH_LEN + 32];
+    snprintf(path, sizeof(path), "%s/segments.dir", config.items_dir);
+    snprintf(tmp, sizeof(tmp), "%s/segments.dir.tmp", config.items_dir);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1) return -1;
+    int ok = write(fd, &dir, sizeof(dir)) == sizeof(dir) && fdatasync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp, path) == -1) return -1;
+
+    int dfd = open(config.items_dir, O_RDONLY | O_DIRECTORY);
+    if (dfd != -1) { fsync(dfd); close(dfd); }
+    return 0;
+}
+
+// Opens segment files up to `count` (creating missing ones). Caller holds segment_lock
+// or runs before any client thread exists.
+static int open_segments(int count) {
+    if (count > SEGMENT_MAX) {
+        fprintf(stderr, "items: more than %d segments; raise item_segment_items\n", SEGMENT_MAX);
+        return -1;
+    }
+    for (int s = atomic_load(&segment_count); s < count; s++) {
+        char path[CONFIG_PATH_LEN + 32];
+        segment_path(s, path, sizeof(path));
+        segment_fds[s] = open(path, O_RDWR | O_CREAT, 0666);
+        if (segment_fds[s] == -1) {
+            perror(path);
+            return -1;
+        }
+        segment_files[s] = record_io_register(segment_fds[s]);
+        if (segment_files[s] == -1) {
+            fprintf(stderr, "items: record file table is full\n");
+            close(segment_fds[s]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void item_store_reserve(int first_id, int last_id) {
+    int needed = item_store_segment_of(last_id) + 1;
+    if (needed > atomic_load(&segment_count)) {
+        pthread_mutex_lock(&segment_lock);
+        int have = atomic_load(&segment_count);
+        if (needed > have) {
+            // Segment files first, then the directory, then make them visible
+            if (open_segments(needed) == 0 && write_directory(needed) == 0) {
+                atomic_store(&segment_count, needed);
+            } else {
+                perror("items: adding segment");
+            }
+        }
+        pthread_mutex_unlock(&segment_lock);
+    }
+
+    // Reserve each block of SEGMENT_PREALLOC slots the range runs into.
+    // segment_items is a multiple of the block size, so blocks never straddle segments.
+    int count = atomic_load(&segment_count);
+    for (int block = (first_id - 1 + SEGMENT_PREALLOC - 1) / SEGMENT_PREALLOC; block <= (last_id - 1) / SEGMENT_PREALLOC; block++) {
+        int first_slot = block * SEGMENT_PREALLOC;
+        int segment = first_slot / segment_items;
+        if (segment >= count) break;
+        preallocate_records(segment_fds[segment], (off_t)(first_slot % segment_items) * sizeof(Item),
+                            SEGMENT_PREALLOC * sizeof(Item));
+    }
+}
+
+// Record layouts items_file has had before the current Item. Fields are in Item order.
+typedef struct {           // The original layout
+    int id;
+    char name[50];
+    char description[100];
+    int seller_id;
+    int current_winner_id;
+    int base_price;
+    int current_bid;
+    time_t end_time;
+    int status;
+    int past_bidders[MAX_BIDDERS];
+    int past_bid_amounts[MAX_BIDDERS];
+    int past_bidders_count;
+} ItemRecordV1;
+
+typedef struct {           // Proxy ceilings and soft close, before record versions
+    int id;
+    char name[50];
+    char description[100];
+    int seller_id;
+    int current_winner_id;
+    int base_price;
+    int current_bid;
+    int winner_max;
+    time_t end_time;
+    int status;
+    int past_bidders[MAX_BIDDERS];
+    int past_bid_amounts[MAX_BIDDERS];
+    int past_bidders_count;
+    int soft_close_window;
+    int soft_close_extend;
+} ItemRecordV2;
+
+#define LEGACY_BATCH 256
+#define LEGACY_CHECK 1024  // Leading records checked when telling layouts apart
+
+// Whether the record at `slot` of a `size`-byte layout starts with its own ID (or 0, for
+// a slot never written). Sets *written for a nonzero ID.
+static int slot_fits(int fd, size_t size, off_t slot, int *written) {
+    int id;
+    if (pread(fd, &id, sizeof(id), slot * size) != sizeof(id)) return 0;
+    if (id != 0) *written = 1;
+    return id == 0 || id == slot + 1;
+}
+
+// The file holds no header, so the layout is recognised from its records: the file must
+// be whole records, and each record's leading ID must match its slot. The first
+// LEGACY_CHECK records and the last are checked. Returns the one record size that fits,
+// or 0 if none or several do.
+static size_t legacy_record_size(int fd) {
+    static const size_t sizes[] = { sizeof(Item), sizeof(ItemRecordV2), sizeof(ItemRecordV1) };
+    struct stat st;
+    if (fstat(fd, &st) == -1) return 0;
+
+    size_t found = 0;
+    for (int c = 0; c < 3; c++) {
+        size_t size = sizes[c];
+        if (st.st_size % size != 0) continue;
+        off_t records = st.st_size / size;
+        off_t checked = records < LEGACY_CHECK ? records : LEGACY_CHECK;
+        int fits = 1, written = 0;
+        for (off_t k = 0; fits && k < checked; k++) fits = slot_fits(fd, size, k, &written);
+        if (fits && records > checked) fits = slot_fits(fd, size, records - 1, &written);
+        if (!fits || !written) continue;
+        if (found) return 0;
+        found = size;
+    }
+    return found;
+}
+
+// Converts one record of the given layout; fields it did not have start zeroed, apart
+// from the winner's escrow, which older layouts always held at the current bid
+static void legacy_convert(const void *raw, size_t size, Item *item) {
+    if (size == sizeof(Item)) {
+        memcpy(item, raw, sizeof(Item));
+        return;
+    }
+    memset(item, 0, sizeof(Item));
+    if (size == sizeof(ItemRecordV2)) {
+        ItemRecordV2 old;
+        memcpy(&old, raw, sizeof(old));
+        item->id = old.id;
+        memcpy(item->name, old.name, sizeof(item->name));
+        memcpy(item->description, old.description, sizeof(item->description));
+        item->seller_id = old.seller_id;
+        item->current_winner_id = old.current_winner_id;
+        item->base_price = old.base_price;
+        item->current_bid = old.current_bid;
+        item->winner_max = old.winner_max;
+        item->end_time = old.end_time;
+        item->status = old.status;
+        memcpy(item->past_bidders, old.past_bidders, sizeof(item->past_bidders));
+        memcpy(item->past_bid_amounts, old.past_bid_amounts, sizeof(item->past_bid_amounts));
+        item->past_bidders_count = old.past_bidders_count;
+        item->soft_close_window = old.soft_close_window;
+        item->soft_close_extend = old.soft_close_extend;
+    } else {
+        ItemRecordV1 old;
+        memcpy(&old, raw, sizeof(old));
+        item->id = old.id;
+        memcpy(item->name, old.name, sizeof(item->name));
+        memcpy(item->description, old.description, sizeof(item->description));
+        item->seller_id = old.seller_id;
+        item->current_winner_id = old.current_winner_id;
+        item->base_price = old.base_price;
+        item->current_bid = old.current_bid;
+        item->winner_max = old.current_winner_id != -1 ? old.current_bid : 0;
+        item->end_time = old.end_time;
+        item->status = old.status;
+        memcpy(item->past_bidders, old.past_bidders, sizeof(item->past_bidders));
+        memcpy(item->past_bid_amounts, old.past_bid_amounts, sizeof(item->past_bid_amounts));
+        item->past_bidders_count = old.past_bidders_count;
+    }
+    if (item->id != 0) item->version = 1;
+}
+
+// Copies the old single-file store into segments, converting records from older layouts.
+// The directory is written last, so a crash part-way through simply migrates again on
+// the next start.
+static int migrate_legacy() {
+    int legacy = open(config.items_file, O_RDONLY);
+    if (legacy == -1) return errno == ENOENT ? 0 : -1;
+
+    struct stat st;
+    if (fstat(legacy, &st) == 0 && st.st_size == 0) {
+        close(legacy);
+        return 0; // Nothing to carry over; leave the empty file alone
+    }
+    size_t record = legacy_record_size(legacy);
+    if (record == 0) {
+        fprintf(stderr, "%s: records match no known item layout; move it aside to start without it\n",
+                config.items_file);
+        close(legacy);
+        errno = EINVAL;
+        return -1;
+    }
+
+    static char raw[LEGACY_BATCH * sizeof(Item)]; // Only used before any client thread exists
+    static Item batch[LEGACY_BATCH];
+    ssize_t bytes;
+    off_t offset = 0;
+    int slots = 0;
+    while ((bytes = pread(legacy, raw, LEGACY_BATCH * record, offset)) >= (ssize_t)record) {
+        int n = bytes / record;
+        for (int i = 0; i < n; i++) legacy_convert(raw + i * record, record, &batch[i]);
+        // Write the batch in runs that stay within one segment
+        for (int i = 0; i < n; ) {
+            int segment = slots / segment_items;
+            int run = segment_items - slots % segment_items;
+            if (run > n - i) run = n - i;
+            if (open_segments(segment + 1) == -1) { close(legacy); return -1; }
+            atomic_store(&segment_count, segment + 1);
+            ssize_t len = run * sizeof(Item);
+            if (pwrite(segment_fds[segment], &batch[i], len, (off_t)(slots % segment_items) * sizeof(Item)) != len) {
+                close(legacy);
+                return -1;
+            }
+            i += run;
+            slots += run;
+        }
+        offset += n * record;
+    }
+    close(legacy);
+    if (slots == 0) return 0;
+
+    for (int s = 0; s < atomic_load(&segment_count); s++) fdatasync(segment_fds[s]);
+    if (write_directory(atomic_load(&segment_count)) == -1) return -1;
+
+    char moved[CONFIG_PATH_LEN + 16];
+    snprintf(moved, sizeof(moved), "%s.migrated", config.items_file);
+    rename(config.items_file, moved);
+    fprintf(stderr, "items: migrated %d records (%zu-byte layout) from %s into %d segment(s) in %s\n",
+            slots, record, config.items_file, atomic_load(&segment_count), config.items_dir);
+    return 0;
+}
+
+int item_store_init() {
+    if (mkdir(config.items_dir, 0755) == -1 && errno != EEXIST) {
+        perror(config.items_dir);
+        return -1;
+    }
+
+    char path[CONFIG_PATH_LEN + 32];
+    snprintf(path, sizeof(path), "%s/segments.dir", config.items_dir);
+    int fd = open(path, O_RDONLY);
+    if (fd != -1) {
+        SegmentDirectory dir;
+        int ok = read(fd, &dir, sizeof(dir)) == sizeof(dir) &&
+                 memcmp(dir.magic, SEGMENT_MAGIC, sizeof(dir.magic)) == 0 &&
+                 dir.segment_items > 0 && dir.segment_items % SEGMENT_PREALLOC == 0 &&
+                 dir.segment_count >= 0;
+        close(fd);
+        if (!ok) {
+            fprintf(stderr, "%s: not a segment directory (or one from an older record format)\n", path);
+            return -1;
+        }
+        if (dir.segment_items != config.item_segment_items) {
+            fprintf(stderr, "items: store was created with item_segment_items = %d; keeping it\n",
+                    dir.segment_items);
+        }
+        segment_items = dir.segment_items;
+        if (open_segments(dir.segment_count) == -1) return -1;
+        atomic_store(&segment_count, dir.segment_count);
+        return 0;
+    }
+
+    // New store: round the segment size up to whole preallocation blocks
+    segment_items = (config.item_segment_items + SEGMENT_PREALLOC - 1) / SEGMENT_PREALLOC * SEGMENT_PREALLOC;
+    if (migrate_legacy() == -1) {
+        perror("items: migrating legacy file");
+        return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    ItemLoadFn fn;
+    int first, stride;   // This loader reads segments first, first + stride, ...
+    int highest;         // Highest slot found
+} LoadTask;
+
+static void *load_segments(void *arg) {
+    LoadTask *task = arg;
+    Item batch[256];
+    int count = atomic_load(&segment_count);
+
+    for (int s = task->first; s < count; s += task->stride) {
+        ssize_t bytes;
+        off_t offset = 0;
+        while ((bytes = record_read(segment_files[s], batch, sizeof(batch), offset)) >= (ssize_t)sizeof(Item)) {
+            int n = bytes / sizeof(Item);
+            offset += n * sizeof(Item);
+            int slot = s * segment_items + offset / sizeof(Item);
+            if (slot > task->highest) task->highest = slot;
+
+            // Zeroed slots are IDs whose creator never finished writing; leave them out
+            int kept = 0;
+            for (int i = 0; i < n; i++) {
+                if (batch[i].id != 0) batch[kept++] = batch[i];
+            }
+            if (kept > 0) task->fn(batch, kept);
+        }
+    }
+    return NULL;
+}
+
+int item_store_load(ItemLoadFn fn) {
+    int count = atomic_load(&segment_count);
+    int threads = count < config.load_threads ? count : config.load_threads;
+    if (threads == 0) return 0;
+
+    LoadTask tasks[threads];
+    pthread_t tids[threads];
+    int started[threads];
+    for (int t = 0; t < threads; t++) {
+        tasks[t] = (LoadTask){ fn, t, threads, 0 };
+        started[t] = t > 0 && pthread_create(&tids[t], NULL, load_segments, &tasks[t]) == 0;
+    }
+
+    // The calling thread takes the first share, plus any a thread could not be started for
+    int highest = 0;
+    for (int t = 0; t < threads; t++) {
+        if (started[t]) pthread_join(tids[t], NULL);
+        else load_segments(&tasks[t]);
+        if (tasks[t].highest > highest) highest = tasks[t].highest;
+    }
+    return highest;
+}
+
+void item_store_sync() {
+    int count = atomic_load(&segment_count);
+    for (int s = 0; s < count; s++) fdatasync(segment_fds[s]);
+}
@@ -0,0 +1,392 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/random.h>
+#include "kdf.h"
+
+#define SALT_BYTES 12   // 16 base64 characters
+#define DERIVED_BYTES 16 // 22 base64 characters
+
+// ---- SHA-256 (FIPS 180-4) ----
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;   // Bytes hashed so far
+    uint8_t block[64];
+    size_t used;
+} Sha256;
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_compress(uint32_t state[8], const uint8_t block[64]) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 |
+               (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static void sha256_init(Sha256 *ctx) {
+    static const uint32_t iv[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->state, iv, sizeof(iv));
+    ctx->length = 0;
+    ctx->used = 0;
+}
+
+static void sha256_update(Sha256 *ctx, const uint8_t *data, size_t len) {
+    ctx->length += len;
+    while (len > 0) {
+        size_t take = 64 - ctx->used < len ? 64 - ctx->used : len;
+        memcpy(ctx->block + ctx->used, data, take);
+        ctx->used += take;
+        data += take;
+        len -= take;
+        if (ctx->used == 64) {
+            sha256_compress(ctx->state, ctx->block);
+            ctx->used = 0;
+        }
+    }
+}
+
+static void sha256_final(Sha256 *ctx, uint8_t digest[32]) {
+    uint64_t bits = ctx->length * 8;
+    uint8_t pad = 0x80;
+    sha256_update(ctx, &pad, 1);
+    pad = 0;
+    while (ctx->used != 56) sha256_update(ctx, &pad, 1);
+
+    uint8_t len_be[8];
+    for (int i = 0; i < 8; i++) len_be[i] = (uint8_t)(bits >> (56 - 8 * i));
+    sha256_update(ctx, len_be, 8);
+
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = (uint8_t)(ctx->state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t)ctx->state[i];
+    }
+}
+
+// ---- HMAC-SHA-256 and PBKDF2 ----
+
+typedef struct {
+    Sha256 inner;
+    Sha256 outer;
+} HmacSha256;
+
+static void hmac_init(HmacSha256 *ctx, const uint8_t *key, size_t key_len) {
+    uint8_t block[64] = { 0 };
+    if (key_len > 64) {
+        Sha256 kh;
+        sha256_init(&kh);
+        sha256_update(&kh, key, key_len);
+        sha256_final(&kh, block);
+    } else {
+        memcpy(block, key, key_len);
+    }
+
+    uint8_t pad[64];
+    for (int i = 0; i < 64; i++) pad[i] = block[i] ^ 0x36;
+    sha256_init(&ctx->inner);
+    sha256_update(&ctx->inner, pad, 64);
+    for (int i = 0; i < 64; i++) pad[i] = block[i] ^ 0x5c;
+    sha256_init(&ctx->outer);
+    sha256_update(&ctx->outer, pad, 64);
+}
+
+static void hmac_final(HmacSha256 *ctx, uint8_t mac[32]) {
+    uint8_t inner_digest[32];
+    sha256_final(&ctx->inner, inner_digest);
+    sha256_update(&ctx->outer, inner_digest, 32);
+    sha256_final(&ctx->outer, mac);
+}
+
+static void pbkdf2_sha256(const uint8_t *pass, size_t pass_len, const uint8_t *salt, size_t salt_len,
+                          uint64_t iterations, uint8_t *out, size_t out_len) {
+    HmacSha256 keyed;
+    hmac_init(&keyed, pass, pass_len); // Reused for every block and iteration
+
+    for (uint32_t block = 1; out_len > 0; block++) {
+        uint8_t index[4] = { block >> 24, block >> 16, block >> 8, block };
+        uint8_t u[32], t[32];
+
+        HmacSha256 ctx = keyed;
+        sha256_update(&ctx.inner, salt, salt_len);
+        sha256_update(&ctx.inner, index, 4);
+        hmac_final(&ctx, u);
+        memcpy(t, u, 32);
+
+        for (uint64_t i = 1; i < iterations; i++) {
+            ctx = keyed;
+            sha256_update(&ctx.inner, u, 32);
+            hmac_final(&ctx, u);
+            for (int k = 0; k < 32; k++) t[k] ^= u[k];
+        }
+
+        size_t take = out_len < 32 ? out_len : 32;
+        memcpy(out, t, take);
+        out += take;
+        out_len -= take;
+    }
+}
+
+// ---- scrypt (RFC 7914) ----
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void salsa20_8(uint32_t b[16]) {
+    uint32_t x[16];
+    memcpy(x, b, sizeof(x));
+    for (int i = 0; i < 8; i += 2) {
+        // Columns
+        x[4] ^= ROTL(x[0] + x[12], 7);   x[8] ^= ROTL(x[4] + x[0], 9);
+        x[12] ^= ROTL(x[8] + x[4], 13);  x[0] ^= ROTL(x[12] + x[8], 18);
+        x[9] ^= ROTL(x[5] + x[1], 7);    x[13] ^= ROTL(x[9] + x[5], 9);
+        x[1] ^= ROTL(x[13] + x[9], 13);  x[5] ^= ROTL(x[1] + x[13], 18);
+        x[14] ^= ROTL(x[10] + x[6], 7);  x[2] ^= ROTL(x[14] + x[10], 9);
+        x[6] ^= ROTL(x[2] + x[14], 13);  x[10] ^= ROTL(x[6] + x[2], 18);
+        x[3] ^= ROTL(x[15] + x[11], 7);  x[7] ^= ROTL(x[3] + x[15], 9);
+        x[11] ^= ROTL(x[7] + x[3], 13);  x[15] ^= ROTL(x[11] + x[7], 18);
+        // Rows
+        x[1] ^= ROTL(x[0] + x[3], 7);    x[2] ^= ROTL(x[1] + x[0], 9);
+        x[3] ^= ROTL(x[2] + x[1], 13);   x[0] ^= ROTL(x[3] + x[2], 18);
+        x[6] ^= ROTL(x[5] + x[4], 7);    x[7] ^= ROTL(x[6] + x[5], 9);
+        x[4] ^= ROTL(x[7] + x[6], 13);   x[5] ^= ROTL(x[4] + x[7], 18);
+        x[11] ^= ROTL(x[10] + x[9], 7);  x[8] ^= ROTL(x[11] + x[10], 9);
+        x[9] ^= ROTL(x[8] + x[11], 13);  x[10] ^= ROTL(x[9] + x[8], 18);
+        x[12] ^= ROTL(x[15] + x[14], 7); x[13] ^= ROTL(x[12] + x[15], 9);
+        x[14] ^= ROTL(x[13] + x[12], 13); x[15] ^= ROTL(x[14] + x[13], 18);
+    }
+    for (int i = 0; i < 16; i++) b[i] += x[i];
+}
+
+// in and out are 2r 64-byte blocks (32r words); out gets the even blocks first, then the odd
+static void block_mix(const uint32_t *in, uint32_t *out, uint32_t r) {
+    uint32_t x[16];
+    memcpy(x, &in[(2 * r - 1) * 16], 64);
+    for (uint32_t i = 0; i < 2 * r; i++) {
+        for (int k = 0; k < 16; k++) x[k] ^= in[i * 16 + k];
+        salsa20_8(x);
+        memcpy(&out[((i / 2) + (i & 1) * r) * 16], x, 64);
+    }
+}
+
+static void ro_mix(uint8_t *b, uint32_t r, uint64_t n, uint32_t *v, uint32_t *xy) {
+    size_t words = 32 * r;
+    uint32_t *x = xy, *y = xy + words;
+
+    for (size_t k = 0; k < words; k++) {
+        x[k] = (uint32_t)b[4 * k] | (uint32_t)b[4 * k + 1] << 8 | (uint32_t)b[4 * k + 2] << 16 | (uint32_t)b[4 * k + 3] << 24;
+    }
+    for (uint64_t i = 0; i < n; i++) {
+        memcpy(&v[i * words], x, words * 4);
+        block_mix(x, y, r);
+        memcpy(x, y, words * 4);
+    }
+    for (uint64_t i = 0; i < n; i++) {
+        uint64_t j = x[(2 * r - 1) * 16] & (n - 1); // Integerify; N is a power of two
+        for (size_t k = 0; k < words; k++) x[k] ^= v[j * words + k];
+        block_mix(x, y, r);
+        memcpy(x, y, words * 4);
+    }
+    for (size_t k = 0; k < words; k++) {
+        b[4 * k] = (uint8_t)x[k];
+        b[4 * k + 1] = (uint8_t)(x[k] >> 8);
+        b[4 * k + 2] = (uint8_t)(x[k] >> 16);
+        b[4 * k + 3] = (uint8_t)(x[k] >> 24);
+    }
+}
+
+// The N * r * 128 byte table is the memory-hard part (16 MiB at the defaults).
+// Each thread keeps its own and reuses it, so auth workers do not hit the allocator per login.
+static __thread uint8_t *scratch = NULL;
+static __thread size_t scratch_size = 0;
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+
+static void make_scratch_key() {
+    pthread_key_create(&scratch_key, free);
+}
+
+static uint8_t *get_scratch(size_t size) {
+    if (scratch_size >= size) return scratch;
+    pthread_once(&scratch_once, make_scratch_key);
+    free(scratch);
+    scratch = malloc(size);
+    scratch_size = scratch ? size : 0;
+    pthread_setspecific(scratch_key, scratch);
+    return scratch;
+}
+
+int kdf_scrypt(const uint8_t *pass, size_t pass_len, const uint8_t *salt, size_t salt_len,
+               uint64_t n, uint32_t r, uint32_t p, uint8_t *out, size_t out_len) {
+    if (n < 2 || (n & (n - 1)) != 0 || r == 0 || p == 0) return -1;
+
+    size_t block_bytes = 128 * (size_t)r;
+    size_t b_size = block_bytes * p;
+    size_t v_size = block_bytes * n;
+    size_t xy_size = 2 * block_bytes;
+
+    uint8_t *mem = get_scratch(b_size + v_size + xy_size);
+    if (mem == NULL) return -1;
+    uint8_t *b = mem;
+    uint32_t *v = (uint32_t *)(mem + b_size);
+    uint32_t *xy = (uint32_t *)(mem + b_size + v_size);
+
+    pbkdf2_sha256(pass, pass_len, salt, salt_len, 1, b, b_size);
+    for (uint32_t i = 0; i < p; i++) {
+        ro_mix(b + i * block_bytes, r, n, v, xy);
+    }
+    pbkdf2_sha256(pass, pass_len, b, b_size, 1, out, out_len);
+    return 0;
+}
+
+// ---- Stored format ----
+
+static const char b64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Unpadded base64; returns characters written
+static int b64_encode(const uint8_t *in, size_t len, char *out) {
+    int o = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < len) v |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < len) v |= in[i + 2];
+        out[o++] = b64_chars[(v >> 18) & 63];
+        out[o++] = b64_chars[(v >> 12) & 63];
+        if (i + 1 < len) out[o++] = b64_chars[(v >> 6) & 63];
+        if (i + 2 < len) out[o++] = b64_chars[v & 63];
+    }
+    out[o] = '\0';
+    return o;
+}
+
+static int b64_value(char c) {
+    const char *p = c ? strchr(b64_chars, c) : NULL;
+    return p ? (int)(p - b64_chars) : -1;
+}
+
+// Decodes exactly `len` bytes from unpadded base64; returns -1 on a bad character
+static int b64_decode(const char *in, uint8_t *out, size_t len) {
+    uint32_t acc = 0;
+    int bits = 0;
+    size_t o = 0;
+    for (const char *c = in; o < len; c++) {
+        int v = b64_value(*c);
+        if (v < 0) return -1;
+        acc = (acc << 6) | v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            out[o++] = (uint8_t)(acc >> bits);
+        }
+    }
+    return 0;
+}
+
+static int hex_field(const char *s, int digits) {
+    int value = 0;
+    for (int i = 0; i < digits; i++) {
+        char c = s[i];
+        int d = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+        if (d < 0) return -1;
+        value = value * 16 + d;
+    }
+    return value;
+}
+
+// Splits a stored hash into its parts; returns -1 if it is not in the $s$ format
+static int parse_stored(const char *stored, int *log_n, int *r, int *p, uint8_t *salt, uint8_t *derived) {
+    if (strlen(stored) != KDF_HASH_LEN || strncmp(stored, "$s$", 3) != 0) return -1;
+    if (stored[8] != '$' || stored[25] != '$') return -1;
+
+    *log_n = hex_field(stored + 3, 2);
+    *r = hex_field(stored + 5, 2);
+    *p = hex_field(stored + 7, 1);
+    if (*log_n < 1 || *log_n > 30 || *r < 1 || *p < 1) return -1;
+
+    if (b64_decode(stored + 9, salt, SALT_BYTES) == -1) return -1;
+    if (b64_decode(stored + 26, derived, DERIVED_BYTES) == -1) return -1;
+    return 0;
+}
+
+// The original scheme: DJB2 printed as a decimal string
+static void legacy_hash(const char *str, char *output) {
+    unsigned long hash = 5381;
+    int c;
+    while ((c = *str++)) {
+        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+    }
+    sprintf(output, "%lu", hash);
+}
+
+int kdf_hash(const char *secret, int log_n, int r, int p, char *out) {
+    if (log_n < 1 || log_n > 30 || r < 1 || r > 255 || p < 1 || p > 15) return -1;
+
+    uint8_t salt[SALT_BYTES], derived[DERIVED_BYTES];
+    if (getrandom(salt, sizeof(salt), 0) != sizeof(salt)) return -1;
+    if (kdf_scrypt((const uint8_t *)secret, strlen(secret), salt, sizeof(salt),
+                   1ull << log_n, r, p, derived, sizeof(derived)) == -1) return -1;
+
+    int len = sprintf(out, "$s$%02x%02x%x$", log_n, r, p);
+    len += b64_encode(salt, sizeof(salt), out + len);
+    out[len++] = '$';
+    b64_encode(derived, sizeof(derived), out + len);
+    return 0;
+}
+
+int kdf_verify(const char *secret, const char *stored) {
+    if (stored[0] != '$') {
+        char legacy[32];
+        legacy_hash(secret, legacy);
+        return strcmp(stored, legacy) == 0;
+    }
+
+    int log_n, r, p;
+    uint8_t salt[SALT_BYTES], expected[DERIVED_BYTES], derived[DERIVED_BYTES];
+    if (parse_stored(stored, &log_n, &r, &p, salt, expected) == -1) return 0;
+    if (kdf_scrypt((const uint8_t *)secret, strlen(secret), salt, sizeof(salt),
+                   1ull << log_n, r, p, derived, sizeof(derived)) == -1) return 0;
+
+    // Constant-time compare
+    uint8_t diff = 0;
+    for (int i = 0; i < DERIVED_BYTES; i++) diff |= derived[i] ^ expected[i];
+    return diff == 0;
+}
+
+int kdf_needs_rehash(const char *stored, int log_n, int r, int p) {
+    int s_log_n, s_r, s_p;
+    uint8_t salt[SALT_BYTES], derived[DERIVED_BYTES];
+    if (parse_stored(stored, &s_log_n, &s_r, &s_p, salt, derived) == -1) return 1;
+    return s_log_n != log_n || s_r != r || s_p != p;
+}
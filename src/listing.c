@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+#include "common.h"
+#include "config.h"
+#include "listing.h"
+#include "snapshot.h"
+#include "codec.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+// Response header ("count|bytes") + codec frame
+typedef struct {
+    size_t len;
+    char data[];
+} EncodedReply;
+
+struct ListingBlob {
+    atomic_int refs;
+    _Atomic(EncodedReply *) encoded[2]; // Compact, without / with WIRE_LZ; built on first use
+    unsigned long version;  // Snapshot version the rows were built from
+    int count;
+    size_t len;             // Response header + count rows
+    int winner_ids[LISTING_MAX_ITEMS]; // Per row, so the next build can reuse resolved names
+    char data[];
+};
+
+static pthread_mutex_t blob_lock = PTHREAD_MUTEX_INITIALIZER; // Guards current and rebuilds
+static ListingBlob *current = NULL; // Holds one reference
+
+void listing_release(ListingBlob *blob) {
+    if (blob && atomic_fetch_sub(&blob->refs, 1) == 1) {
+        free(atomic_load(&blob->encoded[0]));
+        free(atomic_load(&blob->encoded[1]));
+        free(blob);
+    }
+}
+
+const void *listing_data(const ListingBlob *blob, size_t *len) {
+    *len = blob->len;
+    return blob->data;
+}
+
+const void *listing_encoded(ListingBlob *blob, int wire, size_t *len) {
+    if (!(wire & WIRE_COMPACT)) return listing_data(blob, len);
+
+    int slot = (wire & WIRE_LZ) ? 1 : 0;
+    EncodedReply *reply = atomic_load(&blob->encoded[slot]);
+    if (reply == NULL) {
+        const DisplayItem *rows = (const DisplayItem *)(blob->data + sizeof(Response));
+        reply = malloc(sizeof(EncodedReply) + sizeof(Response) + codec_max_frame(RECORD_DISPLAY, blob->count));
+        if (reply == NULL) return NULL;
+
+        size_t frame = codec_pack(RECORD_DISPLAY, rows, blob->count, wire, (uint8_t *)reply->data + sizeof(Response));
+        Response *header = (Response *)reply->data;
+        memset(header, 0, sizeof(Response));
+        header->operation = OP_SUCCESS;
+        sprintf(header->message, "%d|%zu", blob->count, frame);
+        reply->len = sizeof(Response) + frame;
+
+        // Concurrent first users may both build it; one wins, the other frees its copy
+        EncodedReply *expected = NULL;
+        if (!atomic_compare_exchange_strong(&blob->encoded[slot], &expected, reply)) {
+            free(reply);
+            reply = expected;
+        }
+    }
+    *len = reply->len;
+    return reply->data;
+}
+
+// Builds the blob for `snap`. Rows are in item ID order in both the old and the new blob,
+// so one merge pass finds the previous row for each item: a row whose winner has not
+// changed keeps its name instead of reading users.dat again.
+static ListingBlob *build_blob(CatalogSnapshot *snap, const ListingBlob *prev) {
+    ListingBlob *blob = malloc(sizeof(ListingBlob) + sizeof(Response) + LISTING_MAX_ITEMS * sizeof(DisplayItem));
+    if (blob == NULL) return NULL;
+
+    Response *header = (Response *)blob->data;
+    DisplayItem *rows = (DisplayItem *)(blob->data + sizeof(Response));
+    const DisplayItem *prev_rows = prev ? (const DisplayItem *)(prev->data + sizeof(Response)) : NULL;
+    int p = 0;
+
+    int count = 0;
+    int total = snapshot_count(snap);
+    for (int i = snapshot_next(snap, 0); i < total && count < LISTING_MAX_ITEMS; i = snapshot_next(snap, i + 1)) {
+        const Item *item = snapshot_get(snap, i);
+
+        DisplayItem *d_item = &rows[count];
+        memset(d_item, 0, sizeof(DisplayItem));
+        d_item->id = item->id;
+        strcpy(d_item->name, item->name);
+        d_item->current_bid = item->current_bid;
+        d_item->end_time = item->end_time;
+        d_item->status = item->status;
+
+        while (prev && p < prev->count && prev_rows[p].id < item->id) p++;
+        if (item->current_winner_id == -1) {
+            strcpy(d_item->winner_name, "None");
+        } else if (prev && p < prev->count && prev_rows[p].id == item->id &&
+                   prev->winner_ids[p] == item->current_winner_id) {
+            strcpy(d_item->winner_name, prev_rows[p].winner_name);
+        } else {
+            get_username(item->current_winner_id, d_item->winner_name);
+        }
+        blob->winner_ids[count] = item->current_winner_id;
+        count++;
+    }
+
+    memset(header, 0, sizeof(Response));
+    header->operation = OP_SUCCESS;
+    sprintf(header->message, "%d", count);
+
+    atomic_init(&blob->refs, 1);
+    atomic_init(&blob->encoded[0], NULL);
+    atomic_init(&blob->encoded[1], NULL);
+    blob->version = snapshot_version(snap);
+    blob->count = count;
+    blob->len = sizeof(Response) + count * sizeof(DisplayItem);
+    return blob;
+}
+
+ListingBlob *listing_acquire() {
+    CatalogSnapshot *snap = snapshot_acquire();
+
+    pthread_mutex_lock(&blob_lock);
+    if (current == NULL || current->version != snapshot_version(snap)) {
+        ListingBlob *fresh = build_blob(snap, current);
+        if (fresh) {
+            listing_release(current);
+            current = fresh;
+        }
+    }
+    ListingBlob *blob = current;
+    if (blob) atomic_fetch_add(&blob->refs, 1);
+    pthread_mutex_unlock(&blob_lock);
+
+    snapshot_release(snap);
+    return blob;
+}
+
+void listing_conn_init(ListingConn *lc, Transport *t) {
+    memset(lc, 0, sizeof(ListingConn));
+    lc->transport = t;
+    lc->sock = t->sock;
+    if (config.zerocopy_min_bytes > 0 && !t->local) {
+        int one = 1;
+        lc->zerocopy = setsockopt(lc->sock, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+    }
+}
+
+// Releases blobs of zero-copy sends the kernel has finished with. Completions arrive on
+// the socket error queue as [lo, hi] ranges of send numbers. Waits up to timeout_ms for one.
+static void reap_completions(ListingConn *lc, int timeout_ms) {
+    while (lc->completed != lc->issued) {
+        char control[128];
+        struct msghdr msg = { .msg_control = control, .msg_controllen = sizeof(control) };
+        if (recvmsg(lc->sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+            if (errno != EAGAIN || timeout_ms == 0) return;
+            struct pollfd pfd = { .fd = lc->sock, .events = 0 }; // POLLERR is always reported
+            if (poll(&pfd, 1, timeout_ms) <= 0) return;
+            continue;
+        }
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            struct sock_extended_err *err = (struct sock_extended_err *)CMSG_DATA(cm);
+            if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+            // ee_info..ee_data is the completed range; completions arrive in order
+            for (uint32_t seq = lc->completed; seq != err->ee_data + 1; seq++) {
+                listing_release(lc->pending[seq % LISTING_ZC_PENDING]);
+                lc->pending[seq % LISTING_ZC_PENDING] = NULL;
+            }
+            lc->completed = err->ee_data + 1;
+        }
+    }
+}
+
+int listing_send(ListingConn *lc) {
+    ListingBlob *blob = listing_acquire();
+    if (blob == NULL) return -1;
+
+    size_t len;
+    const void *data = listing_encoded(blob, lc->wire, &len);
+    if (data == NULL) { listing_release(blob); return -1; }
+
+    struct iovec iov = { .iov_base = (void *)data, .iov_len = len };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+
+    if (lc->zerocopy && len >= (size_t)config.zerocopy_min_bytes) {
+        reap_completions(lc, 0);
+        if (lc->issued - lc->completed == LISTING_ZC_PENDING) reap_completions(lc, 1000);
+        if (lc->issued - lc->completed < LISTING_ZC_PENDING) {
+            ssize_t sent = sendmsg(lc->sock, &msg, MSG_ZEROCOPY | MSG_NOSIGNAL);
+            if (sent == (ssize_t)len) {
+                lc->pending[lc->issued % LISTING_ZC_PENDING] = blob; // Released on completion
+                lc->issued++;
+                return 0;
+            }
+            if (sent >= 0) {
+                // A short send still pinned the pages and still gets a completion, so the
+                // blob stays pending; the rest goes out as a plain copy
+                lc->pending[lc->issued % LISTING_ZC_PENDING] = blob;
+                lc->issued++;
+                size_t rest = len - sent;
+                return transport_send(lc->transport, (const char *)data + sent, rest) == (int)rest ? 0 : -1;
+            }
+            if (errno != ENOBUFS) { listing_release(blob); return -1; }
+            // ENOBUFS: out of optmem for zero-copy, fall back to a copying send
+        }
+    }
+
+    int sent = transport_send(lc->transport, data, len);
+    listing_release(blob);
+    return sent == (int)len ? 0 : -1;
+}
+
+void listing_conn_close(ListingConn *lc) {
+    reap_completions(lc, 1000);
+    // Anything still pending is left pinned; the kernel may still be reading it
+}
@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include "lock_profile.h"
+#include "histogram.h"
+#include "metrics.h"
+#include "config.h"
+
+#define PROFILE_LOG config.lock_profile_file
+
+#define LP_MAX_SITES 128
+#define LP_MAX_RANGES 16384
+#define LP_HELD_INLINE 16 // Locks a thread holds before its table moves to the heap
+#define LP_TOP_RANGES 20
+
+typedef struct {
+    _Atomic(const char *) site; // Function that took the lock; NULL = free slot
+    int type;                   // F_RDLCK or F_WRLCK
+    pthread_mutex_t lock;       // Guards the histograms, which many threads record into
+    Histogram wait;
+    Histogram hold;
+} SiteStats;
+
+// Ranges only keep totals and maxima: there can be thousands of them
+typedef struct {
+    atomic_ulong count;
+    atomic_ulong total_ns;
+    atomic_ulong max_ns;
+} RangeTiming;
+
+typedef struct {
+    atomic_ulong key; // Hash of the fields below; 0 = free slot
+    dev_t dev;
+    ino_t ino;
+    off_t offset;
+    size_t size;
+    char file[NAME_MAX + 1]; // Base name of the locked file
+    RangeTiming wait;
+    RangeTiming hold;
+} RangeStats;
+
+typedef struct {
+    int fd;
+    off_t offset;
+    size_t size;
+    uint64_t since;
+    SiteStats *site;
+    RangeStats *range;
+} HeldLock;
+
+static int enabled = 0;
+static int dump_interval = 0;
+
+// Lookups are lock-free; the mutex only serializes inserting a new site or range
+static SiteStats sites[LP_MAX_SITES];
+static RangeStats *ranges = NULL;
+static atomic_ulong ranges_dropped = 0;
+static pthread_mutex_t insert_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Settlement and archiving hold a whole batch of record locks at once, so a thread's
+// table spills to the heap past LP_HELD_INLINE and goes back once it holds none
+static __thread HeldLock held_inline[LP_HELD_INLINE];
+static __thread HeldLock *held_spill = NULL;
+static __thread int held_capacity = 0; // Of held_spill
+static __thread int held_count = 0;
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33; x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33; x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+static void store_max(atomic_ulong *max, uint64_t value) {
+    uint64_t seen = atomic_load_explicit(max, memory_order_relaxed);
+    while (value > seen && !atomic_compare_exchange_weak(max, &seen, value));
+}
+
+static void site_record(SiteStats *s, Histogram *h, uint64_t ns) {
+    pthread_mutex_lock(&s->lock);
+    hist_record(h, ns);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void range_record(RangeTiming *t, uint64_t ns) {
+    atomic_fetch_add_explicit(&t->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&t->total_ns, ns, memory_order_relaxed);
+    store_max(&t->max_ns, ns);
+}
+
+static HeldLock *held_table() {
+    return held_spill ? held_spill : held_inline;
+}
+
+// Makes room for one more held lock; 0 if the table is full and cannot grow
+static int held_reserve() {
+    int capacity = held_spill ? held_capacity : LP_HELD_INLINE;
+    if (held_count < capacity) return 1;
+    HeldLock *grown = malloc(2 * capacity * sizeof(HeldLock));
+    if (grown == NULL) return 0;
+    memcpy(grown, held_table(), held_count * sizeof(HeldLock));
+    free(held_spill);
+    held_spill = grown;
+    held_capacity = 2 * capacity;
+    return 1;
+}
+
+// ---- Tables ----
+
+static SiteStats *find_site(const char *site, int type) {
+    unsigned int start = mix64((uintptr_t)site ^ type) % LP_MAX_SITES;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < LP_MAX_SITES; i++) {
+            SiteStats *s = &sites[(start + i) % LP_MAX_SITES];
+            const char *key = atomic_load_explicit(&s->site, memory_order_acquire);
+            if (key == NULL) {
+                if (pass == 1) {
+                    // Still free while holding insert_lock: claim it
+                    s->type = type;
+                    atomic_store_explicit(&s->site, site, memory_order_release);
+                    pthread_mutex_unlock(&insert_lock);
+                    return s;
+                }
+                break;
+            }
+            if (key == site && s->type == type) {
+                if (pass == 1) pthread_mutex_unlock(&insert_lock);
+                return s;
+            }
+        }
+        if (pass == 0) pthread_mutex_lock(&insert_lock);
+    }
+    pthread_mutex_unlock(&insert_lock);
+    return NULL; // Table full
+}
+
+static RangeStats *find_range(int fd, dev_t dev, ino_t ino, off_t offset, size_t size) {
+    uint64_t key = mix64(mix64(dev ^ ((uint64_t)ino << 1)) ^ mix64(offset) ^ size);
+    if (key == 0) key = 1;
+    unsigned int start = key % LP_MAX_RANGES;
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < LP_MAX_RANGES; i++) {
+            RangeStats *r = &ranges[(start + i) % LP_MAX_RANGES];
+            uint64_t seen = atomic_load_explicit(&r->key, memory_order_acquire);
+            if (seen == 0) {
+                if (pass == 1) {
+                    r->dev = dev; r->ino = ino; r->offset = offset; r->size = size;
+
+                    // Resolve the file name once, while the descriptor is still open
+                    char link[64], path[PATH_MAX];
+                    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+                    ssize_t n = readlink(link, path, sizeof(path) - 1);
+                    path[n > 0 ? n : 0] = '\0';
+                    const char *base = strrchr(path, '/');
+                    // A path component never exceeds NAME_MAX, so the precision cuts nothing
+                    snprintf(r->file, sizeof(r->file), "%.*s", NAME_MAX, base ? base + 1 : (n > 0 ? path : "?"));
+
+                    atomic_store_explicit(&r->key, key, memory_order_release);
+                    pthread_mutex_unlock(&insert_lock);
+                    return r;
+                }
+                break;
+            }
+            if (seen == key && r->dev == dev && r->ino == ino && r->offset == offset && r->size == size) {
+                if (pass == 1) pthread_mutex_unlock(&insert_lock);
+                return r;
+            }
+        }
+        if (pass == 0) pthread_mutex_lock(&insert_lock);
+    }
+    pthread_mutex_unlock(&insert_lock);
+    atomic_fetch_add(&ranges_dropped, 1);
+    return NULL;
+}
+
+// ---- Hooks ----
+
+void lock_profile_acquired(int fd, int type, off_t offset, size_t size, const char *site, uint64_t wait_ns) {
+    SiteStats *s = find_site(site, type);
+    if (s) site_record(s, &s->wait, wait_ns);
+
+    RangeStats *r = NULL;
+    struct stat st;
+    if (fstat(fd, &st) == 0) r = find_range(fd, st.st_dev, st.st_ino, offset, size);
+    if (r) range_record(&r->wait, wait_ns);
+
+    // A descriptor closed without unlocking drops its locks; forget any stale entry for it
+    HeldLock *held = held_table();
+    for (int i = 0; i < held_count; i++) {
+        if (held[i].fd == fd && held[i].offset == offset && held[i].size == size) {
+            held[i] = held[--held_count];
+            break;
+        }
+    }
+    if (!held_reserve()) return; // Out of memory: this hold goes untimed
+    held_table()[held_count++] = (HeldLock){ fd, offset, size, metrics_now_ns(), s, r };
+}
+
+void lock_profile_released(int fd, off_t offset, size_t size) {
+    HeldLock *held = held_table();
+    for (int i = held_count - 1; i >= 0; i--) {
+        if (held[i].fd != fd || held[i].offset != offset || held[i].size != size) continue;
+
+        uint64_t hold_ns = metrics_now_ns() - held[i].since;
+        if (held[i].site) site_record(held[i].site, &held[i].site->hold, hold_ns);
+        if (held[i].range) range_record(&held[i].range->hold, hold_ns);
+        held[i] = held[--held_count];
+        if (held_count == 0 && held_spill != NULL) {
+            free(held_spill);
+            held_spill = NULL;
+        }
+        return;
+    }
+}
+
+// ---- Reporting ----
+
+// A site's histograms, copied out under its lock so the report is consistent
+typedef struct {
+    const char *site;
+    int type;
+    Histogram wait;
+    Histogram hold;
+} SiteReport;
+
+static int compare_sites(const void *a, const void *b) {
+    uint64_t wa = ((const SiteReport *)a)->wait.sum_ns;
+    uint64_t wb = ((const SiteReport *)b)->wait.sum_ns;
+    return wa < wb ? 1 : (wa > wb ? -1 : 0);
+}
+
+static int compare_ranges(const void *a, const void *b) {
+    uint64_t wa = atomic_load(&(*(RangeStats **)a)->wait.total_ns);
+    uint64_t wb = atomic_load(&(*(RangeStats **)b)->wait.total_ns);
+    return wa < wb ? 1 : (wa > wb ? -1 : 0);
+}
+
+char *lock_profile_render(size_t *len) {
+    char *text = NULL;
+    FILE *out = open_memstream(&text, len);
+    if (out == NULL) { *len = 0; return NULL; }
+
+    if (!enabled) {
+        fprintf(out, "Lock profiling is off (set lock_profile = 1 in the config).\n");
+        fclose(out);
+        return text;
+    }
+
+    // Waits and holds in microseconds; percentiles are histogram bucket upper edges
+    SiteReport *site_list = malloc(LP_MAX_SITES * sizeof(SiteReport));
+    int site_count = 0;
+    for (int i = 0; site_list && i < LP_MAX_SITES; i++) {
+        const char *name = atomic_load(&sites[i].site);
+        if (name == NULL) continue;
+        SiteReport *report = &site_list[site_count++];
+        report->site = name;
+        report->type = sites[i].type;
+        pthread_mutex_lock(&sites[i].lock);
+        report->wait = sites[i].wait;
+        report->hold = sites[i].hold;
+        pthread_mutex_unlock(&sites[i].lock);
+    }
+    if (site_list) qsort(site_list, site_count, sizeof(SiteReport), compare_sites);
+
+    fprintf(out, "Record lock profile (times in microseconds, *_tot_ms in milliseconds)\n\n");
+    fprintf(out, "%-24s %-4s %10s %12s %10s %10s %12s %10s %10s\n", "site", "type", "count",
+            "wait_tot_ms", "wait_p99", "wait_max", "hold_tot_ms", "hold_p99", "hold_max");
+    for (int i = 0; i < site_count; i++) {
+        const SiteReport *s = &site_list[i];
+        fprintf(out, "%-24s %-4s %10lu %12.3f %10lu %10lu %12.3f %10lu %10lu\n",
+                s->site, s->type == F_RDLCK ? "R" : "W",
+                (unsigned long)s->wait.total,
+                s->wait.sum_ns / 1e6,
+                (unsigned long)(hist_percentile(&s->wait, 99.0) / 1000),
+                (unsigned long)(s->wait.max_ns / 1000),
+                s->hold.sum_ns / 1e6,
+                (unsigned long)(hist_percentile(&s->hold, 99.0) / 1000),
+                (unsigned long)(s->hold.max_ns / 1000));
+    }
+    free(site_list);
+
+    RangeStats **range_list = malloc(LP_MAX_RANGES * sizeof(RangeStats *));
+    int range_count = 0;
+    for (int i = 0; range_list && i < LP_MAX_RANGES; i++) {
+        if (atomic_load(&ranges[i].key) != 0) range_list[range_count++] = &ranges[i];
+    }
+    if (range_list) qsort(range_list, range_count, sizeof(RangeStats *), compare_ranges);
+
+    fprintf(out, "\nTop %d ranges by total wait (%d tracked, %lu not tracked: table full)\n",
+            LP_TOP_RANGES, range_count, (unsigned long)atomic_load(&ranges_dropped));
+    fprintf(out, "%-16s %10s %12s %8s %10s %12s %10s %12s %10s\n", "file", "record", "offset", "length",
+            "count", "wait_tot_ms", "wait_max", "hold_tot_ms", "hold_max");
+    for (int i = 0; i < range_count && i < LP_TOP_RANGES; i++) {
+        RangeStats *r = range_list[i];
+        // Records are fixed-size, so offset / length recovers the record ID
+        char record[24], length[24];
+        if (r->size == 0) {
+            strcpy(record, "whole");
+            strcpy(length, "to-EOF");
+        } else {
+            snprintf(record, sizeof(record), "%ld", (long)(r->offset / r->size) + 1);
+            snprintf(length, sizeof(length), "%zu", r->size);
+        }
+        fprintf(out, "%-16s %10s %12ld %8s %10lu %12.3f %10lu %12.3f %10lu\n",
+                r->file, record, (long)r->offset, length,
+                (unsigned long)atomic_load(&r->wait.count),
+                atomic_load(&r->wait.total_ns) / 1e6,
+                (unsigned long)(atomic_load(&r->wait.max_ns) / 1000),
+                atomic_load(&r->hold.total_ns) / 1e6,
+                (unsigned long)(atomic_load(&r->hold.max_ns) / 1000));
+    }
+    free(range_list);
+
+    fclose(out);
+    return text;
+}
+
+static void *dump_thread(void *arg) {
+    while (1) {
+        sleep(dump_interval);
+
+        size_t len;
+        char *text = lock_profile_render(&len);
+        FILE *log = fopen(PROFILE_LOG, "a");
+        if (log && text) {
+            time_t now = time(NULL);
+            char stamp[32];
+            strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&now));
+            fprintf(log, "==== %s ====\n%s\n", stamp, text);
+        }
+        if (log) fclose(log);
+        free(text);
+    }
+    return NULL;
+}
+
+void lock_profile_init() {
+    if (!config.lock_profile) return;
+
+    ranges = calloc(LP_MAX_RANGES, sizeof(RangeStats));
+    if (ranges == NULL) return;
+    for (int i = 0; i < LP_MAX_SITES; i++) pthread_mutex_init(&sites[i].lock, NULL);
+
+    dump_interval = config.lock_profile_interval;
+    enabled = 1;
+
+    if (dump_interval > 0) {
+        pthread_t tid;
+        pthread_create(&tid, NULL, dump_thread, NULL);
+        pthread_detach(tid);
+    }
+}
+
+int lock_profile_enabled() {
+    return enabled;
+}
@@ -3,8 +3,9 @@
 #include <time.h>
 #include <string.h>
 #include <pthread.h>
+#include "config.h"
 
-#define LOG_FILE "logs/server.log"
+#define LOG_FILE config.log_file
 
 // Mutex to ensure lines don't get mixed up if two threads log at once
 pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <arpa/inet.h>
+#include "common.h"
+#include "histogram.h"
+#include "metrics.h"
+#include "rate_limit.h"
+#include "request_sched.h"
+
+// One block per live thread. Only the owning thread writes it; readers sum the
+// blocks without stopping anyone, so a scrape may miss a record that is in flight.
+typedef struct MetricsBlock {
+    Histogram op_latency[METRICS_MAX_OP];
+    Histogram lock_wait;
+    Histogram queue_wait[RC_CLASSES];
+    Histogram monitor_tick;
+    uint64_t items_expired;
+    atomic_int in_use;
+    struct MetricsBlock *next; // Never unlinked, so readers can walk the list freely
+} MetricsBlock;
+
+static _Atomic(MetricsBlock *) blocks = NULL;
+static __thread MetricsBlock *my_block = NULL;
+static pthread_key_t block_key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+
+static atomic_long connections_active = 0;
+static atomic_long connections_total = 0;
+
+static const char *op_names[METRICS_MAX_OP] = {
+    [0] = "unknown",
+    [OP_LOGIN] = "login",
+    [OP_REGISTER] = "register",
+    [OP_EXIT] = "exit",
+    [OP_CREATE_ITEM] = "create_item",
+    [OP_LIST_ITEMS] = "list_items",
+    [OP_BID] = "bid",
+    [OP_CLOSE_AUCTION] = "close_auction",
+    [OP_VIEW_BALANCE] = "view_balance",
+    [OP_MY_BIDS] = "my_bids",
+    [OP_TRANSACTION_HISTORY] = "transaction_history",
+    [OP_CHECK_SELLER] = "check_seller",
+    [OP_WITHDRAW_BID] = "withdraw_bid",
+    [OP_CHECK_ACTIVE_BIDS] = "check_active_bids",
+    [OP_RESET_PASSWORD] = "reset_password",
+    [OP_FORGOT_PASSWORD] = "forgot_password",
+    [OP_PROXY_BID] = "proxy_bid",
+    [OP_BULK_CREATE_ITEMS] = "bulk_create_items",
+    [OP_BULK_BID] = "bulk_bid",
+    [OP_SEARCH_ITEMS] = "search_items",
+    [OP_METRICS] = "metrics",
+    [OP_LOCK_PROFILE] = "lock_profile",
+    [OP_HELLO] = "hello",
+    [OP_COND_BID] = "cond_bid",
+};
+
+uint64_t metrics_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+const char *metrics_op_name(int op) {
+    if (op <= 0 || op >= METRICS_MAX_OP || op_names[op] == NULL) return op_names[0];
+    return op_names[op];
+}
+
+// ---- Per-thread blocks ----
+
+// Thread exit hands the block back for the next thread to claim
+static void release_block(void *block) {
+    atomic_store(&((MetricsBlock *)block)->in_use, 0);
+}
+
+static void make_key() {
+    pthread_key_create(&block_key, release_block);
+}
+
+static MetricsBlock *get_block() {
+    if (my_block) return my_block;
+    pthread_once(&key_once, make_key);
+
+    MetricsBlock *b;
+    for (b = atomic_load(&blocks); b != NULL; b = b->next) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&b->in_use, &expected, 1)) break;
+    }
+
+    if (b == NULL) {
+        b = calloc(1, sizeof(MetricsBlock));
+        if (b == NULL) return NULL;
+        atomic_store(&b->in_use, 1);
+        b->next = atomic_load(&blocks);
+        while (!atomic_compare_exchange_weak(&blocks, &b->next, b));
+    }
+
+    my_block = b;
+    pthread_setspecific(block_key, b);
+    return b;
+}
+
+void metrics_record_request(int op, uint64_t start_ns) {
+    MetricsBlock *b = get_block();
+    if (b == NULL) return;
+    if (op <= 0 || op >= METRICS_MAX_OP || op_names[op] == NULL) op = 0;
+    hist_record(&b->op_latency[op], metrics_now_ns() - start_ns);
+}
+
+void metrics_record_lock_wait(uint64_t wait_ns) {
+    MetricsBlock *b = get_block();
+    if (b) hist_record(&b->lock_wait, wait_ns);
+}
+
+void metrics_record_queue_wait(int cls, uint64_t wait_ns) {
+    if (cls < 0 || cls >= RC_CLASSES) return;
+    MetricsBlock *b = get_block();
+    if (b) hist_record(&b->queue_wait[cls], wait_ns);
+}
+
+void metrics_record_monitor_tick(uint64_t tick_ns, int expired) {
+    MetricsBlock *b = get_block();
+    if (b == NULL) return;
+    hist_record(&b->monitor_tick, tick_ns);
+    b->items_expired += expired;
+}
+
+void metrics_connection_opened() {
+    atomic_fetch_add(&connections_active, 1);
+    atomic_fetch_add(&connections_total, 1);
+}
+
+void metrics_connection_closed() {
+    atomic_fetch_sub(&connections_active, 1);
+}
+
+// ---- Rendering ----
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} TextBuffer;
+
+static void append(TextBuffer *tb, const char *fmt, ...) {
+    va_list ap;
+    for (;;) {
+        va_start(ap, fmt);
+        int n = vsnprintf(tb->data + tb->len, tb->cap - tb->len, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if (tb->len + n < tb->cap) { tb->len += n; return; }
+
+        size_t new_cap = tb->cap * 2 + n;
+        char *grown = realloc(tb->data, new_cap);
+        if (grown == NULL) { tb->data[tb->len] = '\0'; return; }
+        tb->data = grown;
+        tb->cap = new_cap;
+    }
+}
+
+static void append_summary(TextBuffer *tb, const char *name, const char *labels, const Histogram *h) {
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    const char *sep = labels[0] ? "," : "";
+    for (int q = 0; q < 4; q++) {
+        append(tb, "%s{%s%squantile=\"%g\"} %.9f\n", name, labels, sep, quantiles[q],
+               hist_percentile(h, quantiles[q] * 100.0) / 1e9);
+    }
+    append(tb, "%s_sum%s%s%s %.9f\n", name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "", h->sum_ns / 1e9);
+    append(tb, "%s_count%s%s%s %lu\n", name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "", (unsigned long)h->total);
+}
+
+char *metrics_render(size_t *len) {
+    TextBuffer tb = { malloc(16384), 0, 16384 };
+    if (tb.data == NULL) { *len = 0; return NULL; }
+    tb.data[0] = '\0';
+
+    Histogram *sum = malloc(sizeof(Histogram));
+    if (sum == NULL) { *len = 0; return tb.data; }
+
+    append(&tb, "# HELP auction_request_duration_seconds Time to handle one request, by opcode.\n");
+    append(&tb, "# TYPE auction_request_duration_seconds summary\n");
+    for (int op = 0; op < METRICS_MAX_OP; op++) {
+        if (op_names[op] == NULL) continue;
+        memset(sum, 0, sizeof(Histogram));
+        for (MetricsBlock *b = atomic_load(&blocks); b != NULL; b = b->next) hist_merge(sum, &b->op_latency[op]);
+        if (sum->total == 0) continue;
+
+        char labels[64];
+        snprintf(labels, sizeof(labels), "op=\"%s\"", op_names[op]);
+        append_summary(&tb, "auction_request_duration_seconds", labels, sum);
+    }
+
+    memset(sum, 0, sizeof(Histogram));
+    for (MetricsBlock *b = atomic_load(&blocks); b != NULL; b = b->next) hist_merge(sum, &b->lock_wait);
+    append(&tb, "# HELP auction_lock_wait_seconds Time spent blocked in lock_record.\n");
+    append(&tb, "# TYPE auction_lock_wait_seconds summary\n");
+    append_summary(&tb, "auction_lock_wait_seconds", "", sum);
+
+    append(&tb, "# HELP auction_request_queue_seconds Time a request waited for a slot in its class.\n");
+    append(&tb, "# TYPE auction_request_queue_seconds summary\n");
+    for (int c = 0; c < RC_CLASSES; c++) {
+        memset(sum, 0, sizeof(Histogram));
+        for (MetricsBlock *b = atomic_load(&blocks); b != NULL; b = b->next) hist_merge(sum, &b->queue_wait[c]);
+        char labels[64];
+        snprintf(labels, sizeof(labels), "class=\"%s\"", request_class_name(c));
+        append_summary(&tb, "auction_request_queue_seconds", labels, sum);
+    }
+    append(&tb, "# HELP auction_requests_running Requests holding a slot, by class.\n");
+    append(&tb, "# TYPE auction_requests_running gauge\n");
+    for (int c = 0; c < RC_CLASSES; c++) {
+        append(&tb, "auction_requests_running{class=\"%s\"} %d\n", request_class_name(c), request_sched_running(c));
+    }
+    append(&tb, "# HELP auction_requests_queued Requests waiting for a slot, by class.\n");
+    append(&tb, "# TYPE auction_requests_queued gauge\n");
+    for (int c = 0; c < RC_CLASSES; c++) {
+        append(&tb, "auction_requests_queued{class=\"%s\"} %d\n", request_class_name(c), request_sched_queued(c));
+    }
+
+    uint64_t expired = 0;
+    memset(sum, 0, sizeof(Histogram));
+    for (MetricsBlock *b = atomic_load(&blocks); b != NULL; b = b->next) {
+        hist_merge(sum, &b->monitor_tick);
+        expired += b->items_expired;
+    }
+    append(&tb, "# HELP auction_monitor_tick_seconds Time the monitor spends expiring one batch of auctions.\n");
+    append(&tb, "# TYPE auction_monitor_tick_seconds summary\n");
+    append_summary(&tb, "auction_monitor_tick_seconds", "", sum);
+    append(&tb, "# HELP auction_items_expired_total Auctions closed by the monitor.\n");
+    append(&tb, "# TYPE auction_items_expired_total counter\n");
+    append(&tb, "auction_items_expired_total %lu\n", (unsigned long)expired);
+
+    append(&tb, "# HELP auction_connections_active Client connections currently open.\n");
+    append(&tb, "# TYPE auction_connections_active gauge\n");
+    append(&tb, "auction_connections_active %ld\n", atomic_load(&connections_active));
+    append(&tb, "# HELP auction_connections_total Client connections accepted.\n");
+    append(&tb, "# TYPE auction_connections_total counter\n");
+    append(&tb, "auction_connections_total %ld\n", atomic_load(&connections_total));
+
+    append(&tb, "# HELP auction_rate_limited_total Requests and connections rejected by a rate limit.\n");
+    append(&tb, "# TYPE auction_rate_limited_total counter\n");
+    for (int l = 0; l < RL_LIMITS; l++) {
+        append(&tb, "auction_rate_limited_total{limit=\"%s\"} %lu\n", rate_limit_name(l), (unsigned long)rate_limit_rejected(l));
+    }
+
+    free(sum);
+    *len = tb.len;
+    return tb.data;
+}
+
+// ---- Local HTTP listener ----
+
+static void *listener_thread(void *arg) {
+    int server_fd = (int)(intptr_t)arg;
+    while (1) {
+        int sock = accept(server_fd, NULL, NULL);
+        if (sock < 0) continue;
+
+        // Any request gets the metrics page; the request line itself is not inspected
+        char request[1024];
+        recv(sock, request, sizeof(request), 0);
+
+        size_t body_len;
+        char *body = metrics_render(&body_len);
+        char header[128];
+        int header_len = sprintf(header, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n", body_len);
+        send(sock, header, header_len, 0);
+
+        size_t sent = 0;
+        while (body && sent < body_len) {
+            ssize_t n = send(sock, body + sent, body_len - sent, 0);
+            if (n <= 0) break;
+            sent += n;
+        }
+        free(body);
+        close(sock);
+    }
+    return NULL;
+}
+
+int metrics_start_listener(int port) {
+    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_fd < 0) return -1;
+
+    int opt = 1;
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // Never exposed beyond this host
+    address.sin_port = htons(port);
+
+    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(server_fd, 8) < 0) {
+        close(server_fd);
+        return -1;
+    }
+
+    pthread_t tid;
+    pthread_create(&tid, NULL, listener_thread, (void *)(intptr_t)server_fd);
+    pthread_detach(tid);
+    return 0;
+}
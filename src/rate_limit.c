@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "rate_limit.h"
+#include "config.h"
+#include "metrics.h"
+
+#define RL_STRIPES 64          // Independent locks, so unrelated keys do not contend
+#define RL_SLOTS_PER_STRIPE 64 // Hash chains per stripe
+#define RL_KEY_LEN 64          // Fits an IPv6 address or a username
+
+typedef struct Bucket {
+    char key[RL_KEY_LEN];
+    double tokens;
+    uint64_t last_ns;          // Last refill
+    struct Bucket *next;
+} Bucket;
+
+typedef struct {
+    pthread_mutex_t lock;
+    Bucket *slots[RL_SLOTS_PER_STRIPE];
+} Stripe;
+
+typedef struct {
+    const char *name;
+    const int *rate;   // Tokens per minute, points into config
+    const int *burst;
+    Stripe stripes[RL_STRIPES];
+    atomic_ulong rejected;
+} Limit;
+
+static Limit limits[RL_LIMITS] = {
+    { .name = "connect_ip", .rate = &config.connect_ip_rate, .burst = &config.connect_ip_burst },
+    { .name = "login_ip", .rate = &config.login_ip_rate, .burst = &config.login_ip_burst },
+    { .name = "login_user", .rate = &config.login_user_rate, .burst = &config.login_user_burst },
+};
+
+// FNV-1a
+static uint32_t hash_key(const char *key) {
+    uint32_t h = 2166136261u;
+    for (; *key; key++) {
+        h ^= (unsigned char)*key;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Another thread may have stamped a later time than `now`; that counts as no time passing
+static void refill(const Limit *limit, Bucket *b, uint64_t now) {
+    if (now <= b->last_ns) return;
+    double added = (double)(now - b->last_ns) * *limit->rate / 60e9;
+    b->tokens = b->tokens + added > *limit->burst ? *limit->burst : b->tokens + added;
+    b->last_ns = now;
+}
+
+int rate_limit_allow(int limit_id, const char *key) {
+    Limit *limit = &limits[limit_id];
+    if (*limit->rate == 0) return 1;
+
+    char k[RL_KEY_LEN];
+    snprintf(k, sizeof(k), "%s", key);
+    uint32_t h = hash_key(k);
+    Stripe *stripe = &limit->stripes[h % RL_STRIPES];
+    Bucket **slot = &stripe->slots[(h / RL_STRIPES) % RL_SLOTS_PER_STRIPE];
+
+    pthread_mutex_lock(&stripe->lock);
+    uint64_t now = metrics_now_ns(); // Under the lock, so it never precedes a bucket's last_ns
+    Bucket *b = *slot;
+    while (b != NULL && strcmp(b->key, k) != 0) b = b->next;
+    if (b == NULL) {
+        b = malloc(sizeof(Bucket));
+        if (b == NULL) {
+            pthread_mutex_unlock(&stripe->lock);
+            return 1; // Fail open: no memory is not the client's fault
+        }
+        strcpy(b->key, k);
+        b->tokens = *limit->burst;
+        b->last_ns = now;
+        b->next = *slot;
+        *slot = b;
+    } else {
+        refill(limit, b, now);
+    }
+
+    int allowed = b->tokens >= 1.0;
+    if (allowed) b->tokens -= 1.0;
+    pthread_mutex_unlock(&stripe->lock);
+
+    if (!allowed) atomic_fetch_add(&limit->rejected, 1);
+    return allowed;
+}
+
+// Frees buckets untouched for rate_limit_idle_s. Such a bucket would have refilled to
+// `burst` anyway, so dropping it is invisible to the client.
+static void sweep() {
+    uint64_t idle_ns = (uint64_t)config.rate_limit_idle_s * 1000000000ull;
+    for (int l = 0; l < RL_LIMITS; l++) {
+        for (int s = 0; s < RL_STRIPES; s++) {
+            Stripe *stripe = &limits[l].stripes[s];
+            pthread_mutex_lock(&stripe->lock);
+            uint64_t now = metrics_now_ns();
+            for (int i = 0; i < RL_SLOTS_PER_STRIPE; i++) {
+                Bucket **link = &stripe->slots[i];
+                while (*link != NULL) {
+                    Bucket *b = *link;
+                    if (now > b->last_ns && now - b->last_ns >= idle_ns) {
+                        *link = b->next;
+                        free(b);
+                    } else {
+                        link = &b->next;
+                    }
+                }
+            }
+            pthread_mutex_unlock(&stripe->lock);
+        }
+    }
+}
+
+static void *sweeper_thread(void *arg) {
+    (void)arg;
+    unsigned int period = config.rate_limit_idle_s / 2 > 0 ? config.rate_limit_idle_s / 2 : 1;
+    while (1) {
+        sleep(period);
+        sweep();
+    }
+    return NULL;
+}
+
+void rate_limit_init() {
+    for (int l = 0; l < RL_LIMITS; l++) {
+        for (int s = 0; s < RL_STRIPES; s++) pthread_mutex_init(&limits[l].stripes[s].lock, NULL);
+    }
+
+    pthread_t tid;
+    pthread_create(&tid, NULL, sweeper_thread, NULL);
+    pthread_detach(tid);
+}
+
+uint64_t rate_limit_rejected(int limit) {
+    return atomic_load(&limits[limit].rejected);
+}
+
+const char *rate_limit_name(int limit) {
+    return limits[limit].name;
+}
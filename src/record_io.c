@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "config.h"
+#include "record_io.h"
+
+#define RING_DEPTH 64   // Operations in flight per submission; larger batches go in rounds
+
+// Registered files. Slots are only ever appended, so a reader that has seen the count
+// can use every slot below it without a lock.
+static int files[RECORD_FILES_MAX];
+static atomic_int file_count = 0;
+static pthread_mutex_t files_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int use_uring = 0;
+
+// One io_uring instance, driven through the raw system calls (no liburing dependency)
+typedef struct {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_map, *cq_map;
+    size_t sq_map_len, cq_map_len, sqes_len;
+    unsigned entries;
+    int registered;  // Files attached to this ring as fixed files
+} Ring;
+
+static __thread Ring *thread_ring = NULL;
+static __thread int thread_ring_failed = 0; // This thread could not get a ring; use posix
+static pthread_key_t ring_key;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void ring_free(Ring *ring) {
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_len);
+    if (ring->cq_map && ring->cq_map != ring->sq_map) munmap(ring->cq_map, ring->cq_map_len);
+    if (ring->sq_map) munmap(ring->sq_map, ring->sq_map_len);
+    if (ring->fd != -1) close(ring->fd);
+    free(ring);
+}
+
+static Ring *ring_create() {
+    Ring *ring = calloc(1, sizeof(Ring));
+    if (ring == NULL) return NULL;
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ring->fd = sys_io_uring_setup(RING_DEPTH, &p);
+    if (ring->fd == -1) { free(ring); return NULL; }
+
+    ring->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_map_len > ring->sq_map_len) ring->sq_map_len = ring->cq_map_len;
+        ring->cq_map_len = ring->sq_map_len;
+    }
+    ring->sq_map = mmap(NULL, ring->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) { ring->sq_map = NULL; ring_free(ring); return NULL; }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_map = ring->sq_map;
+    } else {
+        ring->cq_map = mmap(NULL, ring->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_map == MAP_FAILED) { ring->cq_map = NULL; ring_free(ring); return NULL; }
+    }
+    ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) { ring->sqes = NULL; ring_free(ring); return NULL; }
+
+    char *sq = ring->sq_map, *cq = ring->cq_map;
+    ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    ring->entries = p.sq_entries;
+    return ring;
+}
+
+static void ring_destructor(void *arg) {
+    ring_free(arg);
+}
+
+// The calling thread's ring with every registered file attached, or NULL to use posix
+static Ring *get_ring() {
+    if (!use_uring || thread_ring_failed) return NULL;
+    if (thread_ring == NULL) {
+        thread_ring = ring_create();
+        if (thread_ring == NULL) { thread_ring_failed = 1; return NULL; }
+        pthread_setspecific(ring_key, thread_ring); // Torn down when the thread exits
+    }
+
+    // Files registered since the last call: attach the whole table again
+    int count = atomic_load(&file_count);
+    if (thread_ring->registered != count) {
+        if (thread_ring->registered > 0) {
+            sys_io_uring_register(thread_ring->fd, IORING_UNREGISTER_FILES, NULL, 0);
+            thread_ring->registered = 0;
+        }
+        if (sys_io_uring_register(thread_ring->fd, IORING_REGISTER_FILES, files, count) == -1) {
+            return NULL; // Retried on the next call
+        }
+        thread_ring->registered = count;
+    }
+    return thread_ring;
+}
+
+// Queues ops[0..count) (count <= ring entries) and waits for all of them.
+// Returns -1 if the ring refused the batch before taking any of it.
+static int ring_run(Ring *ring, RecordOp *ops, int count) {
+    unsigned tail = *ring->sq_tail;
+    unsigned mask = *ring->sq_mask;
+    for (int i = 0; i < count; i++) {
+        unsigned idx = (tail + i) & mask;
+        struct io_uring_sqe *sqe = &ring->sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->fd = ops[i].file;
+        sqe->flags = IOSQE_FIXED_FILE;
+        sqe->user_data = i;
+        if (ops[i].kind == RECORD_SYNC) {
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+            sqe->flags |= IOSQE_IO_DRAIN; // After everything queued before it
+        } else {
+            sqe->opcode = ops[i].kind == RECORD_READ ? IORING_OP_READ : IORING_OP_WRITE;
+            sqe->addr = (unsigned long)ops[i].buf;
+            sqe->len = ops[i].len;
+            sqe->off = ops[i].offset;
+        }
+        ring->sq_array[idx] = idx;
+    }
+    __atomic_store_n(ring->sq_tail, tail + count, __ATOMIC_RELEASE);
+
+    int submitted = 0, completed = 0;
+    while (completed < count) {
+        int ret = sys_io_uring_enter(ring->fd, count - submitted, 1, IORING_ENTER_GETEVENTS);
+        if (ret >= 0) {
+            submitted += ret;
+        } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY && submitted == 0) {
+            __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE); // The kernel never saw them
+            return -1;
+        }
+
+        unsigned head = *ring->cq_head;
+        unsigned cq_tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != cq_tail; head++) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            ops[cqe->user_data].result = cqe->res;
+            completed++;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+static void posix_run(RecordOp *ops, int count) {
+    for (int i = 0; i < count; i++) {
+        int fd = files[ops[i].file];
+        ssize_t r;
+        if (ops[i].kind == RECORD_READ) r = pread(fd, ops[i].buf, ops[i].len, ops[i].offset);
+        else if (ops[i].kind == RECORD_WRITE) r = pwrite(fd, ops[i].buf, ops[i].len, ops[i].offset);
+        else r = fdatasync(fd);
+        ops[i].result = r == -1 ? -errno : r;
+    }
+}
+
+int record_io_submit(RecordOp *ops, int count) {
+    Ring *ring = get_ring();
+    for (int done = 0; done < count; ) {
+        int n = count - done;
+        if (ring && n > (int)ring->entries) n = ring->entries;
+        if (ring == NULL || ring_run(ring, ops + done, n) == -1) posix_run(ops + done, n);
+        done += n;
+    }
+
+    int status = 0;
+    for (int i = 0; i < count; i++) {
+        if (ops[i].result < 0 || (ops[i].kind != RECORD_SYNC && (size_t)ops[i].result != ops[i].len)) status = -1;
+    }
+    return status;
+}
+
+ssize_t record_read(int file, void *buf, size_t len, off_t offset) {
+    if (!use_uring) return pread(files[file], buf, len, offset); // Skip the op setup
+    RecordOp op = { RECORD_READ, file, buf, len, offset, 0 };
+    record_io_submit(&op, 1);
+    if (op.result < 0) { errno = -op.result; return -1; }
+    return op.result;
+}
+
+ssize_t record_write(int file, const void *buf, size_t len, off_t offset) {
+    if (!use_uring) return pwrite(files[file], buf, len, offset);
+    RecordOp op = { RECORD_WRITE, file, (void *)buf, len, offset, 0 };
+    record_io_submit(&op, 1);
+    if (op.result < 0) { errno = -op.result; return -1; }
+    return op.result;
+}
+
+int record_io_register(int fd) {
+    pthread_mutex_lock(&files_lock);
+    int slot = atomic_load(&file_count);
+    if (slot == RECORD_FILES_MAX) {
+        pthread_mutex_unlock(&files_lock);
+        return -1;
+    }
+    files[slot] = fd;
+    atomic_store(&file_count, slot + 1);
+    pthread_mutex_unlock(&files_lock);
+    return slot;
+}
+
+// The kernel must have the ring and the read, write and fsync opcodes (5.6 or later)
+static int uring_supported() {
+    Ring *ring = ring_create();
+    if (ring == NULL) return 0;
+
+    size_t len = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, len);
+    int ok = probe != NULL && sys_io_uring_register(ring->fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    const int needed[] = { IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC };
+    for (int i = 0; ok && i < 3; i++) {
+        ok = needed[i] <= probe->last_op && (probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    ring_free(ring);
+    return ok;
+}
+
+int record_io_init() {
+    use_uring = 0;
+    if (config.io_backend == IO_BACKEND_POSIX) return 0;
+
+    if (pthread_key_create(&ring_key, ring_destructor) == 0 && uring_supported()) {
+        use_uring = 1;
+        return 0;
+    }
+    if (config.io_backend == IO_BACKEND_URING) {
+        fprintf(stderr, "io_backend = uring, but io_uring is not available here\n");
+        return -1;
+    }
+    return 0;
+}
+
+const char *record_io_backend() {
+    return use_uring ? "io_uring" : "posix";
+}
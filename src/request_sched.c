@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "common.h"
+#include "config.h"
+#include "metrics.h"
+#include "request_sched.h"
+
+// A queued request. Lives on the waiting thread's stack until it is granted.
+typedef struct Waiter {
+    pthread_cond_t cond;
+    int granted;
+    struct Waiter *next;
+} Waiter;
+
+typedef struct {
+    Waiter *head, *tail;  // FIFO of queued requests
+    int queued;
+    int running;
+    int limit;    // Slots this class may hold at once
+    int weight;   // Grants per round robin round
+    int credit;   // Grants left in the current round
+} RequestClass;
+
+static const char *class_names[RC_CLASSES] = { "bid", "account", "scan" };
+
+static RequestClass classes[RC_CLASSES];
+static int running_total = 0;
+static int slots = 0; // 0 = scheduling off
+static pthread_mutex_t sched_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void request_sched_init() {
+    slots = config.sched_slots;
+    int limits[RC_CLASSES] = { config.sched_bid_slots, config.sched_account_slots, config.sched_scan_slots };
+    int weights[RC_CLASSES] = { config.sched_bid_weight, config.sched_account_weight, config.sched_scan_weight };
+    for (int c = 0; c < RC_CLASSES; c++) {
+        classes[c].limit = limits[c] < slots ? limits[c] : slots;
+        classes[c].weight = weights[c];
+        classes[c].credit = weights[c];
+    }
+}
+
+int request_class(int op) {
+    switch (op) {
+        case OP_BID:
+        case OP_PROXY_BID:
+        case OP_COND_BID:
+        case OP_BULK_BID:
+        case OP_WITHDRAW_BID:
+        case OP_CLOSE_AUCTION:
+            return RC_BID;
+        case OP_VIEW_BALANCE:
+        case OP_CHECK_ACTIVE_BIDS:
+        case OP_CHECK_SELLER:
+        case OP_CREATE_ITEM:
+            return RC_ACCOUNT;
+        case OP_LIST_ITEMS:
+        case OP_SEARCH_ITEMS:
+        case OP_MY_BIDS:
+        case OP_TRANSACTION_HISTORY:
+        case OP_BULK_CREATE_ITEMS:
+            return RC_SCAN;
+        default:
+            return RC_NONE;
+    }
+}
+
+// The class whose head waiter gets the next free slot, or -1 if nobody eligible is
+// waiting. Classes take turns in rounds of `weight` grants, in priority order; a round
+// ends early when every class that still has credit is empty or at its limit.
+static int pick_class() {
+    for (int round = 0; round < 2; round++) {
+        for (int c = 0; c < RC_CLASSES; c++) {
+            RequestClass *rc = &classes[c];
+            if (rc->head && rc->running < rc->limit && rc->credit > 0) {
+                rc->credit--;
+                return c;
+            }
+        }
+        for (int c = 0; c < RC_CLASSES; c++) classes[c].credit = classes[c].weight;
+    }
+    return -1;
+}
+
+// Hands free slots to queued requests. Caller holds sched_lock.
+static void dispatch() {
+    while (running_total < slots) {
+        int c = pick_class();
+        if (c == -1) return;
+        RequestClass *rc = &classes[c];
+        Waiter *w = rc->head;
+        rc->head = w->next;
+        if (rc->head == NULL) rc->tail = NULL;
+        rc->queued--;
+        rc->running++;
+        running_total++;
+        w->granted = 1;
+        pthread_cond_signal(&w->cond);
+    }
+}
+
+uint64_t request_sched_enter(int cls) {
+    if (cls == RC_NONE || slots == 0) return 0;
+    RequestClass *rc = &classes[cls];
+
+    pthread_mutex_lock(&sched_lock);
+    // Nobody of this class is queued ahead of us, so a free slot is ours. (If anyone
+    // eligible were queued in another class, dispatch() would already have run them.)
+    if (rc->head == NULL && running_total < slots && rc->running < rc->limit) {
+        rc->running++;
+        running_total++;
+        pthread_mutex_unlock(&sched_lock);
+        return 0;
+    }
+
+    uint64_t start = metrics_now_ns();
+    Waiter w = { .granted = 0, .next = NULL };
+    pthread_cond_init(&w.cond, NULL);
+    if (rc->tail) rc->tail->next = &w;
+    else rc->head = &w;
+    rc->tail = &w;
+    rc->queued++;
+    while (!w.granted) pthread_cond_wait(&w.cond, &sched_lock); // dispatch() dequeued us
+    pthread_mutex_unlock(&sched_lock);
+    pthread_cond_destroy(&w.cond);
+    return metrics_now_ns() - start;
+}
+
+void request_sched_leave(int cls) {
+    if (cls == RC_NONE || slots == 0) return;
+    pthread_mutex_lock(&sched_lock);
+    classes[cls].running--;
+    running_total--;
+    dispatch();
+    pthread_mutex_unlock(&sched_lock);
+}
+
+int request_sched_running(int cls) {
+    pthread_mutex_lock(&sched_lock);
+    int n = classes[cls].running;
+    pthread_mutex_unlock(&sched_lock);
+    return n;
+}
+
+int request_sched_queued(int cls) {
+    pthread_mutex_lock(&sched_lock);
+    int n = classes[cls].queued;
+    pthread_mutex_unlock(&sched_lock);
+    return n;
+}
+
+const char *request_class_name(int cls) {
+    return class_names[cls];
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "scheduler.h"
+
+// Expiry queue: a binary min-heap ordered by end_time.
+// heap_pos[item_id] remembers where each item sits in the heap (-1 if not queued),
+// so an extended auction can be re-keyed in O(log n) instead of waiting for a rescan.
+typedef struct {
+    time_t end_time;
+    int item_id;
+} ExpiryEntry;
+
+static ExpiryEntry *heap = NULL;
+static int heap_size = 0;
+static int heap_capacity = 0;
+
+static int *heap_pos = NULL;
+static int pos_capacity = 0;
+
+static pthread_mutex_t sched_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sched_cond = PTHREAD_COND_INITIALIZER;
+
+static void heap_swap(int a, int b) {
+    ExpiryEntry tmp = heap[a];
+    heap[a] = heap[b];
+    heap[b] = tmp;
+    heap_pos[heap[a].item_id] = a;
+    heap_pos[heap[b].item_id] = b;
+}
+
+static void sift_up(int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (heap[parent].end_time <= heap[i].end_time) break;
+        heap_swap(i, parent);
+        i = parent;
+    }
+}
+
+static void sift_down(int i) {
+    while (1) {
+        int left = 2 * i + 1;
+        int right = left + 1;
+        int smallest = i;
+        if (left < heap_size && heap[left].end_time < heap[smallest].end_time) smallest = left;
+        if (right < heap_size && heap[right].end_time < heap[smallest].end_time) smallest = right;
+        if (smallest == i) break;
+        heap_swap(i, smallest);
+        i = smallest;
+    }
+}
+
+// Grow the position index so item_id is addressable
+static int ensure_pos_capacity(int item_id) {
+    if (item_id < pos_capacity) return 0;
+
+    int new_cap = pos_capacity ? pos_capacity : 64;
+    while (new_cap <= item_id) new_cap *= 2;
+
+    int *grown = realloc(heap_pos, new_cap * sizeof(int));
+    if (grown == NULL) return -1;
+    for (int i = pos_capacity; i < new_cap; i++) grown[i] = -1;
+
+    heap_pos = grown;
+    pos_capacity = new_cap;
+    return 0;
+}
+
+static void remove_at(int i) {
+    int last = heap_size - 1;
+    heap_pos[heap[i].item_id] = -1;
+    if (i != last) {
+        heap[i] = heap[last];
+        heap_pos[heap[i].item_id] = i;
+        heap_size--;
+        sift_down(i);
+        sift_up(i);
+    } else {
+        heap_size--;
+    }
+}
+
+void schedule_item(int item_id, time_t end_time) {
+    if (item_id <= 0) return;
+
+    pthread_mutex_lock(&sched_lock);
+
+    if (ensure_pos_capacity(item_id) == -1) {
+        pthread_mutex_unlock(&sched_lock);
+        return;
+    }
+
+    time_t old_head = heap_size > 0 ? heap[0].end_time : 0;
+    int i = heap_pos[item_id];
+
+    if (i >= 0) {
+        // Already queued: re-key in place (decrease-key or increase-key)
+        heap[i].end_time = end_time;
+        sift_up(i);
+        sift_down(heap_pos[item_id]);
+    } else {
+        if (heap_size == heap_capacity) {
+            int new_cap = heap_capacity ? heap_capacity * 2 : 64;
+            ExpiryEntry *grown = realloc(heap, new_cap * sizeof(ExpiryEntry));
+            if (grown == NULL) {
+                pthread_mutex_unlock(&sched_lock);
+                return;
+            }
+            heap = grown;
+            heap_capacity = new_cap;
+        }
+        heap[heap_size].end_time = end_time;
+        heap[heap_size].item_id = item_id;
+        heap_pos[item_id] = heap_size;
+        heap_size++;
+        sift_up(heap_size - 1);
+    }
+
+    // Wake the monitor if the earliest deadline moved forward
+    if (heap_size == 1 || heap[0].end_time < old_head) {
+        pthread_cond_signal(&sched_cond);
+    }
+    pthread_mutex_unlock(&sched_lock);
+}
+
+void unschedule_item(int item_id) {
+    pthread_mutex_lock(&sched_lock);
+    if (item_id > 0 && item_id < pos_capacity && heap_pos[item_id] >= 0) {
+        remove_at(heap_pos[item_id]);
+    }
+    pthread_mutex_unlock(&sched_lock);
+}
+
+int wait_for_expired(int *ids, int max_ids) {
+    pthread_mutex_lock(&sched_lock);
+
+    while (1) {
+        if (heap_size == 0) {
+            pthread_cond_wait(&sched_cond, &sched_lock);
+            continue;
+        }
+
+        time_t now = time(NULL);
+        if (heap[0].end_time <= now) break;
+
+        // Sleep until the earliest deadline (or until an earlier one is scheduled)
+        struct timespec deadline;
+        deadline.tv_sec = heap[0].end_time;
+        deadline.tv_nsec = 0;
+        pthread_cond_timedwait(&sched_cond, &sched_lock, &deadline);
+    }
+
+    int count = 0;
+    time_t now = time(NULL);
+    while (heap_size > 0 && count < max_ids && heap[0].end_time <= now) {
+        ids[count++] = heap[0].item_id;
+        remove_at(0);
+    }
+
+    pthread_mutex_unlock(&sched_lock);
+    return count;
+}
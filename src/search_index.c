@@ -0,0 +1,403 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#include "common.h"
+#include "search_index.h"
+
+#define MAX_TERM_LEN 32
+#define MAX_QUERY_TERMS 8
+
+// Inverted index: a sorted term dictionary (so prefixes are a contiguous range)
+// where each term holds the IDs of the active items that contain it, in ascending order.
+// A removed ID stays in place negated until a quarter of the list is dead, then the list
+// is compacted, so removal is a binary search and amortised O(1) moves.
+typedef struct {
+    char word[MAX_TERM_LEN];
+    int *ids;
+    int count;      // Entries, dead ones included; 0 = term unused
+    int dead;
+    int capacity;
+} Term;
+
+// The dictionary is two sorted arrays: the main one, and a small one that takes new
+// terms. When the small one fills up, both are merged, dropping unused terms on the way.
+// A term whose last item closes just stays unused until then. So neither adding nor
+// dropping a term moves the whole dictionary.
+typedef struct {
+    Term *terms;
+    int count;
+    int capacity;
+} Dictionary;
+
+// Per-item bookkeeping, indexed by item ID
+typedef struct {
+    time_t end_time;
+    int indexed;
+} Doc;
+
+static Dictionary main_dict = { NULL, 0, 0 };
+static Dictionary recent_dict = { NULL, 0, 0 };
+static int unused_terms = 0; // In either dictionary
+
+static Doc *docs = NULL;
+static int doc_capacity = 0;
+
+static pthread_rwlock_t index_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+// Splits text into lowercase alphanumeric words, skipping duplicates.
+// Returns the number of words written.
+static int tokenize(const char *text, char words[][MAX_TERM_LEN], int count, int max_words) {
+    while (*text && count < max_words) {
+        while (*text && !isalnum((unsigned char)*text)) text++;
+        if (!*text) break;
+
+        char word[MAX_TERM_LEN];
+        int len = 0;
+        while (*text && isalnum((unsigned char)*text)) {
+            if (len < MAX_TERM_LEN - 1) word[len++] = tolower((unsigned char)*text);
+            text++;
+        }
+        word[len] = '\0';
+
+        int seen = 0;
+        for (int i = 0; i < count; i++) {
+            if (strcmp(words[i], word) == 0) { seen = 1; break; }
+        }
+        if (!seen) strcpy(words[count++], word);
+    }
+    return count;
+}
+
+// First term >= word (binary search over one sorted dictionary)
+static int lower_bound(const Dictionary *d, const char *word) {
+    int lo = 0, hi = d->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (strcmp(d->terms[mid].word, word) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static Term *find_term(const char *word) {
+    Dictionary *dicts[2] = { &main_dict, &recent_dict };
+    for (int i = 0; i < 2; i++) {
+        int pos = lower_bound(dicts[i], word);
+        if (pos < dicts[i]->count && strcmp(dicts[i]->terms[pos].word, word) == 0) return &dicts[i]->terms[pos];
+    }
+    return NULL;
+}
+
+// Merges the small dictionary into the main one and drops unused terms
+static int merge_dictionaries() {
+    int total = main_dict.count + recent_dict.count - unused_terms;
+    Term *merged = malloc((total > 0 ? total : 1) * sizeof(Term));
+    if (merged == NULL) return -1;
+
+    int a = 0, b = 0, n = 0;
+    while (a < main_dict.count || b < recent_dict.count) {
+        Term *t;
+        if (b == recent_dict.count ||
+            (a < main_dict.count && strcmp(main_dict.terms[a].word, recent_dict.terms[b].word) < 0)) {
+            t = &main_dict.terms[a++];
+        } else {
+            t = &recent_dict.terms[b++];
+        }
+        if (t->count > 0) merged[n++] = *t;
+    }
+    free(main_dict.terms);
+    main_dict.terms = merged;
+    main_dict.count = n;
+    main_dict.capacity = total > 0 ? total : 1;
+    recent_dict.count = 0;
+    unused_terms = 0;
+    return 0;
+}
+
+static Term *add_term(const char *word) {
+    // The small dictionary stays around 1/32 of the main one, so inserting into it is
+    // cheap and merges are rare
+    int limit = main_dict.count / 32 > 1024 ? main_dict.count / 32 : 1024;
+    if (recent_dict.count >= limit && merge_dictionaries() == -1) return NULL;
+
+    Dictionary *d = &recent_dict;
+    if (d->count == d->capacity) {
+        int new_cap = d->capacity ? d->capacity * 2 : 256;
+        Term *grown = realloc(d->terms, new_cap * sizeof(Term));
+        if (grown == NULL) return NULL;
+        d->terms = grown;
+        d->capacity = new_cap;
+    }
+    int pos = lower_bound(d, word);
+    memmove(&d->terms[pos + 1], &d->terms[pos], (d->count - pos) * sizeof(Term));
+    memset(&d->terms[pos], 0, sizeof(Term));
+    strcpy(d->terms[pos].word, word);
+    d->count++;
+    unused_terms++; // Until its first posting
+    return &d->terms[pos];
+}
+
+// Position of item_id in the posting list, or where it would go
+static int posting_search(const Term *t, int item_id) {
+    int lo = 0, hi = t->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (abs(t->ids[mid]) < item_id) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void add_posting(const char *word, int item_id) {
+    Term *t = find_term(word);
+    if (t == NULL && (t = add_term(word)) == NULL) return;
+
+    // New items get the highest ID so far, so this is nearly always an append
+    int at = (t->count == 0 || abs(t->ids[t->count - 1]) < item_id) ? t->count : posting_search(t, item_id);
+    if (at < t->count && t->ids[at] == -item_id) { // Revive its own tombstone
+        t->ids[at] = item_id;
+        t->dead--;
+        return;
+    }
+    if (t->count == t->capacity) {
+        int new_cap = t->capacity ? t->capacity * 2 : 4;
+        int *grown = realloc(t->ids, new_cap * sizeof(int));
+        if (grown == NULL) return;
+        t->ids = grown;
+        t->capacity = new_cap;
+    }
+    if (t->count == 0) unused_terms--;
+    memmove(&t->ids[at + 1], &t->ids[at], (t->count - at) * sizeof(int));
+    t->ids[at] = item_id;
+    t->count++;
+}
+
+static void remove_posting(const char *word, int item_id) {
+    Term *t = find_term(word);
+    if (t == NULL) return;
+
+    int at = posting_search(t, item_id);
+    if (at == t->count || t->ids[at] != item_id) return;
+    t->ids[at] = -item_id;
+    t->dead++;
+
+    // A term nobody uses any more is left for the next merge to drop, so the dictionary
+    // tracks live auctions only
+    if (t->dead == t->count) {
+        free(t->ids);
+        t->ids = NULL;
+        t->count = t->dead = t->capacity = 0;
+        if (++unused_terms > main_dict.count / 2 + 1024) merge_dictionaries();
+        return;
+    }
+    if (t->dead * 4 > t->count) {
+        int live = 0;
+        for (int i = 0; i < t->count; i++) {
+            if (t->ids[i] > 0) t->ids[live++] = t->ids[i];
+        }
+        t->count = live;
+        t->dead = 0;
+    }
+}
+
+static int item_words(const Item *item, char words[][MAX_TERM_LEN], int max_words) {
+    int count = tokenize(item->name, words, 0, max_words);
+    return tokenize(item->description, words, count, max_words);
+}
+
+static int ensure_doc_capacity(int item_id) {
+    if (item_id < doc_capacity) return 0;
+
+    int new_cap = doc_capacity ? doc_capacity : 256;
+    while (new_cap <= item_id) new_cap *= 2;
+
+    Doc *grown = realloc(docs, new_cap * sizeof(Doc));
+    if (grown == NULL) return -1;
+    memset(&grown[doc_capacity], 0, (new_cap - doc_capacity) * sizeof(Doc));
+
+    docs = grown;
+    doc_capacity = new_cap;
+    return 0;
+}
+
+void search_index_item(const Item *item) {
+    if (item->id <= 0) return;
+    int active = (item->status == ITEM_ACTIVE);
+
+    // Most calls are bids that change neither membership nor end time: skip the write lock
+    pthread_rwlock_rdlock(&index_lock);
+    int unchanged = (item->id < doc_capacity)
+                    ? (docs[item->id].indexed == active && (!active || docs[item->id].end_time == item->end_time))
+                    : !active;
+    pthread_rwlock_unlock(&index_lock);
+    if (unchanged) return;
+
+    char words[64][MAX_TERM_LEN];
+    int word_count = item_words(item, words, 64);
+
+    pthread_rwlock_wrlock(&index_lock);
+    if (ensure_doc_capacity(item->id) == 0) {
+        Doc *doc = &docs[item->id];
+        if (active && !doc->indexed) {
+            for (int i = 0; i < word_count; i++) add_posting(words[i], item->id);
+            doc->indexed = 1;
+        } else if (!active && doc->indexed) {
+            for (int i = 0; i < word_count; i++) remove_posting(words[i], item->id);
+            doc->indexed = 0;
+        }
+        doc->end_time = item->end_time;
+    }
+    pthread_rwlock_unlock(&index_lock);
+}
+
+// Later-ending first, so the root of a bounded heap is the worst result kept so far
+static int ends_after(int a, int b) {
+    if (docs[a].end_time != docs[b].end_time) return docs[a].end_time > docs[b].end_time;
+    return a > b;
+}
+
+static int compare_end_time(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return ends_after(x, y) ? 1 : ends_after(y, x) ? -1 : 0;
+}
+
+// Restores the heap below `at`; before(x, y) puts x nearer the root
+static void sift_down(int *heap, int count, int at, int (*before)(int, int)) {
+    while (1) {
+        int top = at, l = 2 * at + 1, r = l + 1;
+        if (l < count && before(heap[l], heap[top])) top = l;
+        if (r < count && before(heap[r], heap[top])) top = r;
+        if (top == at) return;
+        int tmp = heap[at]; heap[at] = heap[top]; heap[top] = tmp;
+        at = top;
+    }
+}
+
+// Merge cursor over one term's posting list
+typedef struct {
+    const int *ids;
+    int at, count;
+} Cursor;
+
+static int cursor_id(const Cursor *c) {
+    return c->ids[c->at];
+}
+
+// Skips tombstones; returns 0 once the list is used up
+static int cursor_live(Cursor *c) {
+    while (c->at < c->count && c->ids[c->at] < 0) c->at++;
+    return c->at < c->count;
+}
+
+// Min-heap of cursors on their current ID
+static void cursor_sift(Cursor *heap, int count, int at) {
+    while (1) {
+        int top = at, l = 2 * at + 1, r = l + 1;
+        if (l < count && cursor_id(&heap[l]) < cursor_id(&heap[top])) top = l;
+        if (r < count && cursor_id(&heap[r]) < cursor_id(&heap[top])) top = r;
+        if (top == at) return;
+        Cursor tmp = heap[at]; heap[at] = heap[top]; heap[top] = tmp;
+        at = top;
+    }
+}
+
+// Collects the ascending, de-duplicated IDs of every term matching word (or starting
+// with it). The posting lists are already sorted, so several prefix terms are merged
+// through a heap of cursors rather than concatenated and sorted.
+static int collect_matches(const char *word, int prefix, int **out) {
+    const Dictionary *dicts[2] = { &main_dict, &recent_dict };
+    size_t len = strlen(word);
+    int first[2], last[2], total = 0, ranges = 0;
+    for (int d = 0; d < 2; d++) {
+        first[d] = last[d] = lower_bound(dicts[d], word);
+        while (last[d] < dicts[d]->count &&
+               (prefix ? strncmp(dicts[d]->terms[last[d]].word, word, len) == 0
+                       : strcmp(dicts[d]->terms[last[d]].word, word) == 0)) {
+            total += dicts[d]->terms[last[d]].count - dicts[d]->terms[last[d]].dead;
+            last[d]++;
+        }
+        ranges += last[d] - first[d];
+    }
+
+    *out = malloc((total > 0 ? total : 1) * sizeof(int));
+    Cursor *heap = malloc((ranges > 0 ? ranges : 1) * sizeof(Cursor));
+    if (*out == NULL || heap == NULL) {
+        free(*out); free(heap);
+        *out = NULL;
+        return 0;
+    }
+
+    int cursors = 0;
+    for (int d = 0; d < 2; d++) {
+        for (int i = first[d]; i < last[d]; i++) {
+            Cursor c = { dicts[d]->terms[i].ids, 0, dicts[d]->terms[i].count };
+            if (cursor_live(&c)) heap[cursors++] = c;
+        }
+    }
+
+    for (int i = cursors / 2 - 1; i >= 0; i--) cursor_sift(heap, cursors, i);
+
+    int n = 0;
+    while (cursors > 0) {
+        int id = cursor_id(&heap[0]);
+        if (n == 0 || (*out)[n - 1] != id) (*out)[n++] = id;
+        heap[0].at++;
+        if (!cursor_live(&heap[0])) heap[0] = heap[--cursors];
+        cursor_sift(heap, cursors, 0);
+    }
+    free(heap);
+    return n;
+}
+
+int search_index_query(const char *query, int *ids, int max_ids) {
+    char words[MAX_QUERY_TERMS][MAX_TERM_LEN];
+    int word_count = tokenize(query, words, 0, MAX_QUERY_TERMS);
+    if (word_count == 0 || max_ids <= 0) return 0;
+
+    pthread_rwlock_rdlock(&index_lock);
+
+    // AND the words together: intersect each word's match set with the running result
+    int *result = NULL;
+    int result_count = 0;
+    for (int w = 0; w < word_count; w++) {
+        int *matches;
+        int match_count = collect_matches(words[w], w == word_count - 1, &matches);
+
+        if (w == 0) {
+            result = matches;
+            result_count = match_count;
+        } else {
+            int a = 0, b = 0, n = 0;
+            while (a < result_count && b < match_count) {
+                if (result[a] < matches[b]) a++;
+                else if (result[a] > matches[b]) b++;
+                else { result[n++] = result[a]; a++; b++; }
+            }
+            result_count = n;
+            free(matches);
+        }
+        if (result_count == 0) break;
+    }
+
+    // Rank by end time so the auctions closing soonest come first. Only max_ids are
+    // returned, so keep the best of them in a bounded heap instead of sorting every match.
+    int count = 0;
+    for (int i = 0; i < result_count; i++) {
+        if (count < max_ids) {
+            ids[count++] = result[i];
+            if (count == max_ids) {
+                for (int at = count / 2 - 1; at >= 0; at--) sift_down(ids, count, at, ends_after);
+            }
+        } else if (ends_after(ids[0], result[i])) {
+            ids[0] = result[i];
+            sift_down(ids, count, 0, ends_after);
+        }
+    }
+    qsort(ids, count, sizeof(int), compare_end_time);
+
+    pthread_rwlock_unlock(&index_lock);
+    free(result);
+    return count;
+}
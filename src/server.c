@@ -1,34 +1,186 @@
+#define _GNU_SOURCE // accept4
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/un.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include "common.h"
 #include "file_handler.h"
 #include "user_handler.h"
+#include "user_store.h"
+#include "item_store.h"
+#include "archive.h"
+#include "record_io.h"
 #include "item_handler.h"
 #include "session.h"
 #include "logger.h"
+#include "metrics.h"
+#include "lock_profile.h"
+#include "trace.h"
+#include "auth_pool.h"
+#include "rate_limit.h"
+#include "request_sched.h"
+#include "listing.h"
+#include "codec.h"
+#include "config.h"
+#include "transport.h"
+
+static atomic_int open_connections = 0; // Checked against config.max_connections
+
+#define ACCEPT_BACKOFF_US 10000 // Listener pause when accept fails for lack of resources
 
 // MONITOR THREAD
 void *auction_monitor_thread(void *arg) {
     while(1) {
-        check_expired_items();
-        sleep(1); // Check every 1 second
+        check_expired_items(); // Sleeps until the next auction deadline
     }
     return NULL;
 }
 
-int recv_all(int sock, void *buffer, size_t length) {
-    size_t total_received = 0;
-    char *ptr = (char *)buffer;
-    while (total_received < length) {
-        ssize_t received = recv(sock, ptr + total_received, length - total_received, 0);
-        if (received <= 0) return received; // Error or closed
-        total_received += received;
+// Waits for the next request to start arriving, then reads it whole.
+// *received_ns is stamped in between so idle time between requests is not counted.
+int recv_request(Transport *conn, Request *req, uint64_t *received_ns) {
+    if (trace_enabled() && !transport_wait_readable(conn)) return 0;
+    *received_ns = metrics_now_ns();
+    return transport_recv(conn, req, sizeof(Request));
+}
+
+// Sends a multi-record reply in one call: a Response header carrying the count, then the
+// records. Fixed-width rows by default; a codec frame (header "count|bytes") if the client
+// negotiated WIRE_COMPACT with OP_HELLO.
+void send_records(Transport *conn, int wire, int kind, const void *rows, int count) {
+    size_t row_size = kind == RECORD_DISPLAY ? sizeof(DisplayItem) : sizeof(HistoryRecord);
+    size_t cap = (wire & WIRE_COMPACT) ? codec_max_frame(kind, count) : count * row_size;
+    char *buf = malloc(sizeof(Response) + cap);
+    if (buf == NULL) {
+        // The client is waiting for a header either way
+        Response err;
+        memset(&err, 0, sizeof(Response));
+        err.operation = OP_ERROR;
+        strcpy(err.message, "Error: Server out of memory.");
+        transport_send(conn, &err, sizeof(Response));
+        return;
+    }
+
+    Response *res = (Response *)buf;
+    memset(res, 0, sizeof(Response));
+    res->operation = OP_SUCCESS;
+    size_t body;
+    if (wire & WIRE_COMPACT) {
+        body = codec_pack(kind, rows, count, wire, (uint8_t *)buf + sizeof(Response));
+        sprintf(res->message, "%d|%zu", count, body);
+    } else {
+        body = count * row_size;
+        memcpy(buf + sizeof(Response), rows, body);
+        sprintf(res->message, "%d", count); // Count first
+    }
+    transport_send(conn, buf, sizeof(Response) + body);
+    free(buf);
+}
+
+// Sends a listing of items as DisplayItems (OP_LIST_ITEMS uses the shared blob in listing.c)
+void send_display_items(Transport *conn, int wire, Item *items, int count) {
+    DisplayItem rows[LISTING_MAX_ITEMS];
+    if (count > LISTING_MAX_ITEMS) count = LISTING_MAX_ITEMS;
+
+    for (int i = 0; i < count; i++) {
+        DisplayItem d_item;
+        memset(&d_item, 0, sizeof(DisplayItem));
+        
+        d_item.id = items[i].id;
+        strcpy(d_item.name, items[i].name);
+        d_item.current_bid = items[i].current_bid;
+        d_item.end_time = items[i].end_time;
+        d_item.status = items[i].status;
+
+        // Resolve the Highest Bidder's Name
+        if (items[i].current_winner_id == -1) {
+            strcpy(d_item.winner_name, "None");
+        } else {
+            get_username(items[i].current_winner_id, d_item.winner_name);
+        }
+
+        rows[i] = d_item;
+    }
+    send_records(conn, wire, RECORD_DISPLAY, rows, count);
+}
+
+// Reads the entries that follow a bulk Request (payload = entry count).
+// Returns the count (entries malloc'd into *entries), or -1 if the frame is unusable.
+int recv_bulk_frame(Transport *conn, Request *req, size_t entry_size, void **entries) {
+    int count = atoi(req->payload);
+    *entries = NULL;
+    if (count < 0 || count > MAX_BULK_ENTRIES) return -1;
+    if (count == 0) return 0;
+
+    *entries = malloc(count * entry_size);
+    if (*entries == NULL) return -1;
+    if (transport_recv(conn, *entries, count * entry_size) <= 0) {
+        free(*entries); *entries = NULL;
+        return -1;
     }
-    return total_received;
+    return count;
+}
+
+// Sends the bulk reply: a Response with the count, then one status int per entry
+void send_bulk_status(Transport *conn, int *status, int count) {
+    Response res;
+    memset(&res, 0, sizeof(Response));
+    res.operation = OP_SUCCESS;
+    sprintf(res.message, "%d", count);
+    transport_send(conn, &res, sizeof(Response));
+    if (count > 0) transport_send(conn, status, count * sizeof(int));
+}
+
+// Translates a place_bid / place_proxy_bid result code into a client message
+void set_bid_response(Response *res, int result, int user_id) {
+    if (result == 1) {
+        res->operation = OP_SUCCESS;
+        sprintf(res->message, "Bid Accepted! You are the highest bidder.");
+    } else if (result == -3) {
+        res->operation = OP_ERROR;
+        sprintf(res->message, "Bid Failed: Amount too low (Current bid is higher).");
+    } else if (result == -4) {
+        res->operation = OP_ERROR;
+        sprintf(res->message, "Bid Failed: Auction is closed.");
+    } else if (result == -5) {
+        res->operation = OP_ERROR;
+        sprintf(res->message, "Bid Failed: You cannot bid on your own listed item.");
+    } else if (result == -6) {
+        res->operation = OP_ERROR;
+        sprintf(res->message, "Bid Failed: Insufficient balance to place this bid.");
+    } else if (result == -7) {
+        // --- NEW COOLDOWN ERROR ---
+        int cd_left = get_user_cooldown(user_id);
+        res->operation = OP_ERROR;
+        sprintf(res->message, "Bid Failed: You are on cooldown for %d more seconds.", cd_left);
+    } else if (result == -8) {
+        res->operation = OP_ERROR;
+        sprintf(res->message, "Outbid: Another bidder's proxy covers this amount.");
+    } else if (result == -9) {
+        res->operation = OP_ERROR;
+        sprintf(res->message, "Bid Failed: The price changed since you last saw it.");
+    } else {
+        res->operation = OP_ERROR;
+        sprintf(res->message, "Bid Failed: System Error or Invalid ID.");
+    }
+}
+
+// Login-style requests are throttled per source IP and per target username before they
+// touch users.dat. ip is NULL for local clients, which only get the username limit.
+// Returns 1 (and fills res) if this one is over the limit.
+static int login_throttled(const char *ip, const char *username, Response *res) {
+    if ((ip == NULL || rate_limit_allow(RL_LOGIN_IP, ip)) && rate_limit_allow(RL_LOGIN_USER, username)) return 0;
+    res->operation = OP_ERROR;
+    strcpy(res->message, "Too many attempts. Please wait and try again.");
+    return 1;
 }
 
 void *client_handler(void *socket_desc) {
@@ -38,11 +190,69 @@ void *client_handler(void *socket_desc) {
     Request req;
     Response res;
     int my_user_id = -1;
+    uint64_t req_start = 0, recv_start = 0;
+    int req_class = RC_NONE;
+    metrics_connection_opened();
 
-    while(recv_all(sock, &req, sizeof(Request)) > 0) {
+    Transport conn;
+    transport_init(&conn, sock);
+
+    // Login limits key on the source address. Clients on the Unix socket skip the per-IP
+    // bucket, as they do at accept: they would all share one, so one busy local client
+    // would lock every other one out. The per-username limit still applies to them.
+    char peer_ip[INET_ADDRSTRLEN] = "unknown";
+    struct sockaddr_in peer;
+    socklen_t peer_len = sizeof(peer);
+    if (!conn.local && getpeername(sock, (struct sockaddr *)&peer, &peer_len) == 0) {
+        inet_ntop(AF_INET, &peer.sin_addr, peer_ip, sizeof(peer_ip));
+    }
+    const char *login_ip = conn.local ? NULL : peer_ip;
+    ListingConn listing;
+    listing_conn_init(&listing, &conn);
+
+    // A for loop so that the cases which `continue` still give back their slot and are recorded
+    for (; recv_request(&conn, &req, &recv_start) > 0;
+           request_sched_leave(req_class), metrics_record_request(req.operation, req_start), trace_request_end()) {
+        req_start = metrics_now_ns();
+        trace_request_begin(req.operation, recv_start);
+        trace_span_end("receive", recv_start);
+        // Bulk bodies are read before taking a slot: a client that stalls mid-frame must not
+        // hold one of its class's slots while the server waits on it
+        void *bulk_entries = NULL;
+        int bulk_count = 0;
+        if (req.operation == OP_BULK_CREATE_ITEMS) {
+            bulk_count = recv_bulk_frame(&conn, &req, sizeof(BulkItemEntry), &bulk_entries);
+        } else if (req.operation == OP_BULK_BID) {
+            bulk_count = recv_bulk_frame(&conn, &req, sizeof(BulkBidEntry), &bulk_entries);
+        }
+        // Wait for a slot in the request's class; bids go ahead of queued scans
+        req_class = request_class(req.operation);
+        uint64_t queue_span = trace_span_begin();
+        uint64_t queued_ns = request_sched_enter(req_class);
+        if (queued_ns > 0) trace_span_end("queue", queue_span);
+        metrics_record_queue_wait(req_class, queued_ns);
         memset(&res, 0, sizeof(Response));
         
         switch(req.operation) {
+            case OP_HELLO:
+                // Encoding negotiation: grant the WIRE_* flags we support out of those offered
+                int offered = atoi(req.payload);
+                listing.wire = offered & (WIRE_COMPACT | (config.wire_compression ? WIRE_LZ : 0));
+                if (!(listing.wire & WIRE_COMPACT)) listing.wire = 0; // LZ only applies to compact frames
+                // WIRE_SHM moves the connection itself, so it never reaches listing.wire
+                int granted = listing.wire;
+                if ((offered & WIRE_SHM) && config.local_transport == LOCAL_TRANSPORT_SHM &&
+                    transport_shm_offer(&conn, config.shm_ring_bytes) == 0) {
+                    granted |= WIRE_SHM;
+                }
+                res.operation = OP_SUCCESS;
+                sprintf(res.message, "%d", granted);
+                transport_send(&conn, &res, sizeof(Response));
+                if ((granted & WIRE_SHM) && transport_shm_start(&conn) == -1) {
+                    shutdown(sock, SHUT_RDWR); // Client is waiting for the memfd; end it cleanly
+                }
+                continue;
+
             case OP_REGISTER:
                 int init_bal;
                 char sec_ans[50];
@@ -66,6 +276,7 @@ void *client_handler(void *socket_desc) {
                 break;
 
             case OP_LOGIN:
+                if (login_throttled(login_ip, req.username, &res)) break;
                 printf("Login request: %s\n", req.username);
                 int user_id = authenticate_user(req.username, req.password);
                 if (user_id > 0) {
@@ -94,10 +305,11 @@ void *client_handler(void *socket_desc) {
                 
                 char i_name[50], i_desc[100];
                 int i_price, i_duration;
+                int i_window = 0, i_extend = 0; // Optional soft-close settings
                 // Parse duration instead of date string
-                sscanf(req.payload, "%[^|]|%[^|]|%d|%d", i_name, i_desc, &i_price, &i_duration);
+                sscanf(req.payload, "%[^|]|%[^|]|%d|%d|%d|%d", i_name, i_desc, &i_price, &i_duration, &i_window, &i_extend);
                 
-                int item_id = create_item(i_name, i_desc, i_price, i_duration, my_user_id);
+                int item_id = create_item(i_name, i_desc, i_price, i_duration, my_user_id, i_window, i_extend);
                 
                 if (item_id > 0) {
                     res.operation = OP_SUCCESS;
@@ -109,37 +321,21 @@ void *client_handler(void *socket_desc) {
                 break;
 
             case OP_LIST_ITEMS:
-                // We need to send a list. The Response struct only has a small message buffer.
-                // We will send a header first, then the items one by one.
-                Item items[50];
-                int count = get_all_items(items, 50);
-                
-                res.operation = OP_SUCCESS;
-                sprintf(res.message, "%d", count); // Send count first
-                send(sock, &res, sizeof(Response), 0);
-                
-                // Send actual items
-                for (int i = 0; i < count; i++) {
-                    DisplayItem d_item;
-                    memset(&d_item, 0, sizeof(DisplayItem));
-                    
-                    d_item.id = items[i].id;
-                    strcpy(d_item.name, items[i].name);
-                    d_item.current_bid = items[i].current_bid;
-                    d_item.end_time = items[i].end_time;
-                    d_item.status = items[i].status;
-
-                    // Resolve the Highest Bidder's Name
-                    if (items[i].current_winner_id == -1) {
-                        strcpy(d_item.winner_name, "None");
-                    } else {
-                        get_username(items[i].current_winner_id, d_item.winner_name);
-                    }
-
-                    send(sock, &d_item, sizeof(DisplayItem), 0);
+                // We need to send a list. The Response struct only has a small message buffer,
+                // so a header goes first, then the items. Both come pre-serialized from listing.c.
+                if (listing_send(&listing) == -1) {
+                    shutdown(sock, SHUT_RDWR); // Part of a reply would desync the framing; end it
                 }
                 continue; // Skip the default send at bottom since we already sent response
 
+            case OP_SEARCH_ITEMS:
+                // Payload is the free-text query; reply has the same shape as OP_LIST_ITEMS
+                req.payload[BUFFER_SIZE - 1] = '\0';
+                Item found_items[LISTING_MAX_ITEMS];
+                int found_count = search_items(req.payload, found_items, LISTING_MAX_ITEMS);
+                send_display_items(&conn, listing.wire, found_items, found_count);
+                continue;
+
             case OP_EXIT:
                 printf("User %d logged out.\n", my_user_id);
                 if (my_user_id != -1) {
@@ -153,38 +349,82 @@ void *client_handler(void *socket_desc) {
 
             case OP_BID:
                 int b_item_id, b_amount;
+                uint64_t parse_span = trace_span_begin();
                 // Client sends "ItemID|Amount" in payload
                 sscanf(req.payload, "%d|%d", &b_item_id, &b_amount);
+                trace_span_end("parse", parse_span);
                 
                 printf("User %d trying to bid %d on Item %d\n", my_user_id, b_amount, b_item_id);
                 
                 int result = place_bid(b_item_id, my_user_id, b_amount);
-                
-                if (result == 1) {
-                    res.operation = OP_SUCCESS;
-                    sprintf(res.message, "Bid Accepted! You are the highest bidder.");
-                } else if (result == -3) {
-                    res.operation = OP_ERROR;
-                    sprintf(res.message, "Bid Failed: Amount too low (Current bid is higher).");
-                } else if (result == -4) {
-                    res.operation = OP_ERROR;
-                    sprintf(res.message, "Bid Failed: Auction is closed.");
-                } else if (result == -5) {
-                    res.operation = OP_ERROR;
-                    sprintf(res.message, "Bid Failed: You cannot bid on your own listed item.");
-                } else if (result == -6) {
-                    res.operation = OP_ERROR;
-                    sprintf(res.message, "Bid Failed: Insufficient balance to place this bid.");
-                } else if (result == -7) {
-                    // --- NEW COOLDOWN ERROR ---
-                    int cd_left = get_user_cooldown(my_user_id);
+                set_bid_response(&res, result, my_user_id);
+                break;
+
+            case OP_COND_BID:
+                // Machine-readable reply for retry loops: "<code>|<price>|<version>"
+                int cb_item_id = 0, cb_amount = 0;
+                BidCondition cond = { 0 };
+                int cb_result = -2;
+                if (sscanf(req.payload, "%d|%d|%d|%u", &cb_item_id, &cb_amount,
+                           &cond.expected_price, &cond.expected_version) >= 3) {
+                    cb_result = place_conditional_bid(cb_item_id, my_user_id, cb_amount, &cond);
+                }
+                res.operation = cb_result == 1 ? OP_SUCCESS : OP_ERROR;
+                sprintf(res.message, "%d|%d|%u", cb_result, cond.price, cond.version);
+                break;
+
+            case OP_PROXY_BID:
+                int p_item_id, p_max;
+                // Client sends "ItemID|MaxAmount" in payload
+                sscanf(req.payload, "%d|%d", &p_item_id, &p_max);
+
+                printf("User %d setting proxy ceiling %d on Item %d\n", my_user_id, p_max, p_item_id);
+
+                int p_result = place_proxy_bid(p_item_id, my_user_id, p_max);
+                set_bid_response(&res, p_result, my_user_id);
+                if (p_result == 1) {
+                    sprintf(res.message, "Proxy Bid Set! The server will bid for you up to $%d.", p_max);
+                }
+                break;
+
+            case OP_BULK_CREATE_ITEMS:
+                BulkItemEntry *bc_entries = bulk_entries;
+                int bc_count = bulk_count;
+                if (bc_count < 0) {
+                    // The rest of the stream can't be trusted after a bad frame
                     res.operation = OP_ERROR;
-                    sprintf(res.message, "Bid Failed: You are on cooldown for %d more seconds.", cd_left);
-                } else {
+                    strcpy(res.message, "Error: Invalid bulk frame.");
+                    transport_send(&conn, &res, sizeof(Response));
+                    shutdown(sock, SHUT_RDWR);
+                    continue;
+                }
+
+                printf("User %d bulk-listing %d items\n", my_user_id, bc_count);
+
+                int bc_status[MAX_BULK_ENTRIES];
+                if (create_items_bulk(bc_entries, bc_count, my_user_id, bc_status) < 0) {
+                    for (int i = 0; i < bc_count; i++) bc_status[i] = -1;
+                }
+                send_bulk_status(&conn, bc_status, bc_count);
+                free(bc_entries);
+                continue; // Reply already sent
+
+            case OP_BULK_BID:
+                BulkBidEntry *bb_entries = bulk_entries;
+                int bb_count = bulk_count;
+                if (bb_count < 0) {
                     res.operation = OP_ERROR;
-                    sprintf(res.message, "Bid Failed: System Error or Invalid ID.");
+                    strcpy(res.message, "Error: Invalid bulk frame.");
+                    transport_send(&conn, &res, sizeof(Response));
+                    shutdown(sock, SHUT_RDWR);
+                    continue;
                 }
-                break;
+
+                int bb_status[MAX_BULK_ENTRIES];
+                place_bids_bulk(bb_entries, bb_count, my_user_id, bb_status);
+                send_bulk_status(&conn, bb_status, bb_count);
+                free(bb_entries);
+                continue;
 
             case OP_CLOSE_AUCTION:
                 int c_item_id;
@@ -227,11 +467,8 @@ void *client_handler(void *socket_desc) {
 
             case OP_MY_BIDS:
                 Item my_items[50];
+                DisplayItem my_rows[50];
                 int my_count = get_my_bids(my_user_id, my_items, 50);
-                
-                res.operation = OP_SUCCESS;
-                sprintf(res.message, "%d", my_count);
-                send(sock, &res, sizeof(Response), 0);
 
                 for (int i = 0; i < my_count; i++) {
                     DisplayItem d_item;
@@ -258,18 +495,16 @@ void *client_handler(void *socket_desc) {
                         get_username(my_items[i].current_winner_id, d_item.winner_name);
                     }
 
-                    send(sock, &d_item, sizeof(DisplayItem), 0);
+                    my_rows[i] = d_item;
                 }
+                send_records(&conn, listing.wire, RECORD_DISPLAY, my_rows, my_count);
                 continue;
             
             case OP_TRANSACTION_HISTORY:
                 Item hist_items[50];
+                HistoryRecord hist_rows[50];
                 int hist_count = get_transaction_history(my_user_id, hist_items, 50);
                 
-                res.operation = OP_SUCCESS;
-                sprintf(res.message, "%d", hist_count);
-                send(sock, &res, sizeof(Response), 0);
-                
                 // Package and send HistoryRecords instead of raw Items
                 for(int i = 0; i < hist_count; i++) {
                     HistoryRecord hr;
@@ -291,8 +526,9 @@ void *client_handler(void *socket_desc) {
                         get_username(hist_items[i].current_winner_id, hr.winner_name);
                     }
                     
-                    send(sock, &hr, sizeof(HistoryRecord), 0);
+                    hist_rows[i] = hr;
                 }
+                send_records(&conn, listing.wire, RECORD_HISTORY, hist_rows, hist_count);
                 continue; // Skip the default send at the bottom
             
             case OP_CHECK_SELLER:
@@ -358,6 +594,7 @@ void *client_handler(void *socket_desc) {
                 
                 // Extract data (putting answer last handles any spaces typed by the user)
                 sscanf(req.payload, "%[^|]|%[^|]|%[^\n]", f_username, f_new_pass, f_sec_ans);
+                if (login_throttled(login_ip, f_username, &res)) break;
                 
                 int f_res = process_forgot_password(f_username, f_sec_ans, f_new_pass);
                 if (f_res == 1) {
@@ -371,55 +608,258 @@ void *client_handler(void *socket_desc) {
                     strcpy(res.message, "Error: Username not found.");
                 }
                 break;
+
+            case OP_METRICS:
+                // Admin only. Header carries the text length, then the Prometheus text follows
+                if (my_user_id == -1 || get_user_role(my_user_id) != ROLE_ADMIN) {
+                    res.operation = OP_ERROR;
+                    strcpy(res.message, "Error: Admin access required.");
+                    break;
+                }
+                size_t m_len;
+                char *m_text = metrics_render(&m_len);
+                res.operation = OP_SUCCESS;
+                sprintf(res.message, "%zu", m_len);
+                transport_send(&conn, &res, sizeof(Response));
+                if (m_len > 0) transport_send(&conn, m_text, m_len);
+                free(m_text);
+                continue;
+
+            case OP_LOCK_PROFILE:
+                // Admin only. Same shape as OP_METRICS: text length, then the report
+                if (my_user_id == -1 || get_user_role(my_user_id) != ROLE_ADMIN) {
+                    res.operation = OP_ERROR;
+                    strcpy(res.message, "Error: Admin access required.");
+                    break;
+                }
+                size_t p_len;
+                char *p_text = lock_profile_render(&p_len);
+                res.operation = OP_SUCCESS;
+                sprintf(res.message, "%zu", p_len);
+                transport_send(&conn, &res, sizeof(Response));
+                if (p_len > 0) transport_send(&conn, p_text, p_len);
+                free(p_text);
+                continue;
         }
-        send(sock, &res, sizeof(Response), 0);
+        uint64_t send_span = trace_span_begin();
+        transport_send(&conn, &res, sizeof(Response));
+        trace_span_end("send", send_span);
     }
     
     if (my_user_id != -1) remove_session(my_user_id);
-    close(sock);
+    listing_conn_close(&listing);
+    metrics_connection_closed();
+    atomic_fetch_sub(&open_connections, 1);
+    transport_close(&conn);
     return NULL;
 }
 
-int main() {
-    init_sessions(); // Initialize the session array
-    
-    int server_fd, new_socket, *new_sock;
-    struct sockaddr_in address;
-    int addrlen = sizeof(address);
-
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) { 
-            perror("Socket failed"); 
-            exit(EXIT_FAILURE); 
-        }
+// Binds one listening socket on config.port. SO_REUSEPORT lets every listener thread
+// bind its own; SO_REUSEADDR lets a restart bind while old connections sit in TIME_WAIT.
+static int open_listener() {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        perror("Socket failed");
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("SO_REUSEPORT"); // The first socket still works on its own
+    }
 
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
     address.sin_family = AF_INET; 
     address.sin_addr.s_addr = INADDR_ANY; 
-    address.sin_port = htons(PORT);
+    address.sin_port = htons(config.port);
+
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) { 
+        perror("Bind failed");
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, config.backlog) < 0) { 
+        perror("Listen failed"); 
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
 
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) { 
-            perror("Bind failed");
-            exit(EXIT_FAILURE); 
+// Binds the Unix socket for clients on this host. A socket file left by an earlier
+// run would make bind fail, so it is removed first.
+static int open_unix_listener() {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(config.unix_socket) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "unix_socket path is too long: %s\n", config.unix_socket);
+        return -1;
+    }
+    strcpy(address.sun_path, config.unix_socket);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        perror("Unix socket failed");
+        return -1;
+    }
+    unlink(config.unix_socket);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+        perror("Unix socket bind failed");
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, config.backlog) < 0) {
+        perror("Unix socket listen failed");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Admission for one accepted socket: rate limit, connection cap, then a handler thread
+static void start_connection(int new_socket, const struct sockaddr_storage *peer) {
+    // Local clients skip the per-IP limiter: they would all share one bucket
+    char ip[INET_ADDRSTRLEN] = "local";
+    int port = 0;
+    int tcp = peer->ss_family == AF_INET;
+    if (tcp) {
+        const struct sockaddr_in *address = (const struct sockaddr_in *)peer;
+        inet_ntop(AF_INET, &address->sin_addr, ip, sizeof(ip));
+        port = ntohs(address->sin_port);
+    }
+    // Throttled before a thread (or a log line) is spent on it; counted in metrics
+    if (tcp && !rate_limit_allow(RL_CONNECT_IP, ip)) {
+        close(new_socket);
+        return;
+    }
+    char log_msg[100];
+    // Claim the slot first: several listeners admit connections at once
+    int already_open = atomic_fetch_add(&open_connections, 1);
+    if (config.max_connections > 0 && already_open >= config.max_connections) {
+        atomic_fetch_sub(&open_connections, 1);
+        sprintf(log_msg, "Connection from %s:%d refused: max_connections reached", ip, port);
+        write_log(log_msg);
+        close(new_socket);
+        return;
+    }
+    // Some replies are a header plus a body in separate sends; without this Nagle
+    // holds the second one back until the client ACKs the first
+    int nodelay = 1;
+    if (tcp) setsockopt(new_socket, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    sprintf(log_msg, "New connection accepted from %s:%d", ip, port);
+    write_log(log_msg);
+    pthread_t thread_id;
+    int *new_sock = malloc(sizeof(int)); *new_sock = new_socket;
+    pthread_create(&thread_id, NULL, client_handler, (void*)new_sock);
+    pthread_detach(thread_id); // Nobody joins connection threads
+}
+
+// LISTENER THREAD: an epoll loop on its own SO_REUSEPORT socket. Each wake-up drains
+// the accept queue, so a login storm is taken in batches rather than one wake-up each.
+static void *listener_thread(void *arg) {
+    int listen_fd = (int)(intptr_t)arg;
+    int reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC); // Spare, for shedding at EMFILE
+    int epfd = epoll_create1(0);
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = listen_fd };
+    if (epfd == -1 || epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev) == -1) {
+        perror("epoll");
+        return NULL;
+    }
+
+    while (1) {
+        struct epoll_event ready;
+        if (epoll_wait(epfd, &ready, 1, -1) <= 0) continue;
+        while (1) {
+            struct sockaddr_storage address;
+            socklen_t addrlen = sizeof(address);
+            int new_socket = accept4(listen_fd, (struct sockaddr *)&address, &addrlen, SOCK_CLOEXEC);
+            if (new_socket < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break; // Queue drained
+                if ((errno == EMFILE || errno == ENFILE) && reserve_fd != -1) {
+                    // Out of descriptors. The connection stays queued and epoll is level-triggered,
+                    // so leaving it there spins this thread; spend the spare fd to drop it instead
+                    close(reserve_fd);
+                    int shed = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+                    if (shed >= 0) close(shed);
+                    reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                    if (shed >= 0) {
+                        write_log("Connection dropped: out of file descriptors");
+                        continue;
+                    }
+                }
+                usleep(ACCEPT_BACKOFF_US); // No spare fd, or ENOBUFS and the like: let some free up
+                break;
+            }
+            start_connection(new_socket, &address);
         }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    int config_status = config_load(argc, argv); // server.conf, AUCTION_* env, --key=value
+    if (config_status != 0) return config_status == 1 ? 0 : EXIT_FAILURE;
 
-    if (listen(server_fd, 3) < 0) { 
-            perror("Listen failed"); 
-            exit(EXIT_FAILURE); 
+    lock_profile_init(); // No-op unless lock_profile = 1
+    trace_init();        // No-op unless trace = 1
+    start_sync_thread(); // Only for sync = interval
+    auth_pool_start(); // Password hashing workers
+    rate_limit_init();
+    request_sched_init(); // Request classes and their slots
+    if (record_io_init() == -1) return EXIT_FAILURE; // io_uring or posix, per io_backend
+    if (init_users() == -1) { // Load users.dat into memory and start the write-back thread
+        perror("Loading users");
+        return EXIT_FAILURE;
+    }
+    if (item_store_init() == -1) return EXIT_FAILURE; // Open (or migrate into) the item segments
+    init_sessions(); // Initialize the session array
+    init_items();    // Load the read snapshot and seed the expiry queue
+    if (archive_init() == -1) return EXIT_FAILURE; // Archive index and compactor
+    
+    // One SO_REUSEPORT socket per listener thread; the kernel spreads new connections
+    // across them. All are bound before any thread starts, so a bad port fails startup.
+    int listeners = config.listen_threads > 0 ? config.listen_threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (listeners < 1) listeners = 1;
+    int listen_fds[listeners];
+    for (int i = 0; i < listeners; i++) {
+        listen_fds[i] = open_listener();
+        if (listen_fds[i] == -1) {
+            if (i == 0) exit(EXIT_FAILURE);
+            listeners = i; // Enough to serve; run with what we have
+            break;
         }
+    }
     
     // START MONITOR THREAD
     pthread_t monitor_tid;
     pthread_create(&monitor_tid, NULL, auction_monitor_thread, NULL);
     pthread_detach(monitor_tid); // Run in background
     
-    printf("Auction Server running on port %d\n", PORT);
-    while (1) {
-        if ((new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t*)&addrlen)) < 0) continue;
-        char log_msg[100];
-        sprintf(log_msg, "New connection accepted from %s:%d", inet_ntoa(address.sin_addr), ntohs(address.sin_port));
-        write_log(log_msg);
-        pthread_t thread_id;
-        new_sock = malloc(sizeof(int)); *new_sock = new_socket;
-        pthread_create(&thread_id, NULL, client_handler, (void*)new_sock);
+    if (config.metrics_port > 0 && metrics_start_listener(config.metrics_port) == -1) {
+        perror("Metrics listener failed"); // Not fatal: OP_METRICS still works
+    }
+
+    // Same-host clients: the Unix socket gets a listener thread of its own
+    if (config.local_transport != LOCAL_TRANSPORT_OFF) {
+        int unix_fd = open_unix_listener();
+        if (unix_fd == -1) exit(EXIT_FAILURE);
+        pthread_t unix_tid;
+        pthread_create(&unix_tid, NULL, listener_thread, (void *)(intptr_t)unix_fd);
+        pthread_detach(unix_tid);
+        printf("Local clients: %s (%s)\n", config.unix_socket,
+               config.local_transport == LOCAL_TRANSPORT_SHM ? "shared memory on request" : "socket only");
+    }
+
+    printf("Auction Server running on port %d (%d listener%s, storage I/O: %s)\n",
+           config.port, listeners, listeners == 1 ? "" : "s", record_io_backend());
+    for (int i = 1; i < listeners; i++) {
+        pthread_t listener_tid;
+        pthread_create(&listener_tid, NULL, listener_thread, (void *)(intptr_t)listen_fds[i]);
+        pthread_detach(listener_tid);
     }
+    listener_thread((void *)(intptr_t)listen_fds[0]); // The main thread is listener 0
     return 0;
 }
\ No newline at end of file
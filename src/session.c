@@ -1,12 +1,19 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <pthread.h>
 #include "common.h"
+#include "config.h"
 
-int loggedInUsers[MAX_CLIENTS];
+int *loggedInUsers = NULL; // config.max_clients slots
 pthread_mutex_t session_lock = PTHREAD_MUTEX_INITIALIZER; // Create the lock
 
 void init_sessions() {
-    for(int i=0; i<MAX_CLIENTS; i++) {
+    loggedInUsers = malloc(config.max_clients * sizeof(int));
+    if (loggedInUsers == NULL) {
+        perror("Session table");
+        exit(EXIT_FAILURE);
+    }
+    for(int i=0; i<config.max_clients; i++) {
         loggedInUsers[i] = -1;
     }
 }
@@ -15,14 +22,14 @@ int create_session(int user_id) {
     pthread_mutex_lock(&session_lock); // LOCK
     
     // Check if already logged in
-    for(int i=0; i<MAX_CLIENTS; i++) {
+    for(int i=0; i<config.max_clients; i++) {
         if(loggedInUsers[i] == user_id) {
             pthread_mutex_unlock(&session_lock); // UNLOCK
             return -1; // Already logged in
         }
     }
     
-    for(int i=0; i<MAX_CLIENTS; i++) {
+    for(int i=0; i<config.max_clients; i++) {
         if(loggedInUsers[i] == -1) {
             loggedInUsers[i] = user_id;
             pthread_mutex_unlock(&session_lock); // UNLOCK
@@ -36,7 +43,7 @@ int create_session(int user_id) {
 
 void remove_session(int user_id) {
     pthread_mutex_lock(&session_lock); // LOCK
-    for(int i=0; i<MAX_CLIENTS; i++) {
+    for(int i=0; i<config.max_clients; i++) {
         if(loggedInUsers[i] == user_id) {
             loggedInUsers[i] = -1;
             break;
@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "common.h"
+#include "snapshot.h"
+
+// Items live in fixed-size chunks at the leaves of a persistent radix tree. Every
+// version shares all of its nodes and chunks with the previous one except those on the
+// paths it touched: publishing one item copies its chunk and one node per level, so a
+// bid costs the same at 1M items as at 1K. A NULL link stands for a subtree of empty slots.
+#define SNAPSHOT_CHUNK_ITEMS 16
+#define SNAPSHOT_RADIX_BITS 6
+#define SNAPSHOT_RADIX (1 << SNAPSHOT_RADIX_BITS)
+#define SNAPSHOT_MAX_HEIGHT 5   // 16 * 64^5 slots, past any int ID
+
+typedef struct {
+    atomic_int refs;
+    unsigned long version;   // The version that created it may still write it in place
+    Item items[SNAPSHOT_CHUNK_ITEMS];
+} ItemChunk;
+
+typedef struct {
+    atomic_int refs;
+    unsigned long version;
+    void *slots[SNAPSHOT_RADIX]; // Nodes one level down, or ItemChunks at level 1
+} TreeNode;
+
+struct CatalogSnapshot {
+    atomic_int refs;
+    unsigned long version;
+    int count;      // Highest item ID seen (slots 0 .. count-1)
+    int height;     // Levels of TreeNodes above the chunks (at least 1)
+    TreeNode *root;
+};
+
+// current_lock only guards the pointer swap and the reference bump (a few instructions).
+// publish_lock serialises writers while they build the next version off to the side.
+static CatalogSnapshot *current = NULL;
+static const Item empty_item; // What snapshot_get returns for a slot under a NULL link
+static pthread_mutex_t current_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t publish_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Drops one reference to a node (level >= 1) or chunk (level 0) and, if it was the
+// last, to everything below it
+static void tree_release(void *p, int level) {
+    if (p == NULL) return;
+    if (level == 0) {
+        ItemChunk *chunk = p;
+        if (atomic_fetch_sub(&chunk->refs, 1) == 1) free(chunk);
+        return;
+    }
+    TreeNode *node = p;
+    if (atomic_fetch_sub(&node->refs, 1) != 1) return;
+    for (int i = 0; i < SNAPSHOT_RADIX; i++) {
+        tree_release(node->slots[i], level - 1);
+    }
+    free(node);
+}
+
+static void tree_retain(void *p, int level) {
+    if (p == NULL) return;
+    if (level == 0) atomic_fetch_add(&((ItemChunk *)p)->refs, 1);
+    else atomic_fetch_add(&((TreeNode *)p)->refs, 1);
+}
+
+CatalogSnapshot *snapshot_acquire() {
+    pthread_mutex_lock(&current_lock);
+    CatalogSnapshot *snap = current;
+    if (snap != NULL) atomic_fetch_add(&snap->refs, 1);
+    pthread_mutex_unlock(&current_lock);
+    return snap;
+}
+
+void snapshot_release(CatalogSnapshot *snap) {
+    if (snap == NULL) return;
+    if (atomic_fetch_sub(&snap->refs, 1) != 1) return;
+
+    // Last reader of an old version frees it; subtrees still shared with newer versions survive
+    tree_release(snap->root, snap->height);
+    free(snap);
+}
+
+int snapshot_count(const CatalogSnapshot *snap) {
+    return snap ? snap->count : 0;
+}
+
+const Item *snapshot_get(const CatalogSnapshot *snap, int index) {
+    if (snap == NULL || index < 0 || index >= snap->count) return NULL;
+    int c = index / SNAPSHOT_CHUNK_ITEMS;
+    void *p = snap->root;
+    for (int level = snap->height; level > 0 && p != NULL; level--) {
+        p = ((TreeNode *)p)->slots[(c >> ((level - 1) * SNAPSHOT_RADIX_BITS)) & (SNAPSHOT_RADIX - 1)];
+    }
+    return p ? &((ItemChunk *)p)->items[index % SNAPSHOT_CHUNK_ITEMS] : &empty_item;
+}
+
+int snapshot_next(const CatalogSnapshot *snap, int index) {
+    if (snap == NULL) return 0;
+    if (index < 0) index = 0;
+    while (index < snap->count) {
+        long c = index / SNAPSHOT_CHUNK_ITEMS;
+        void *p = snap->root;
+        int level = snap->height;
+        for (; level > 0 && p != NULL; level--) {
+            void *child = ((TreeNode *)p)->slots[(c >> ((level - 1) * SNAPSHOT_RADIX_BITS)) & (SNAPSHOT_RADIX - 1)];
+            if (child == NULL) {
+                // Nothing live under this link: jump to the first chunk after its subtree
+                int shift = (level - 1) * SNAPSHOT_RADIX_BITS;
+                c = ((c >> shift) + 1) << shift;
+                break;
+            }
+            p = child;
+        }
+        if (p == NULL) return snap->count; // Empty tree
+        if (level > 0) {
+            index = c * SNAPSHOT_CHUNK_ITEMS < snap->count ? (int)(c * SNAPSHOT_CHUNK_ITEMS) : snap->count;
+            continue;
+        }
+        const ItemChunk *chunk = p;
+        for (int i = index % SNAPSHOT_CHUNK_ITEMS; i < SNAPSHOT_CHUNK_ITEMS; i++) {
+            if (chunk->items[i].id != 0) {
+                int at = (int)(c * SNAPSHOT_CHUNK_ITEMS) + i;
+                return at < snap->count ? at : snap->count;
+            }
+        }
+        index = (int)((c + 1) * SNAPSHOT_CHUNK_ITEMS);
+    }
+    return snap->count;
+}
+
+unsigned long snapshot_version(const CatalogSnapshot *snap) {
+    return snap ? snap->version : 0;
+}
+
+static long tree_capacity(int height) {
+    long slots = SNAPSHOT_CHUNK_ITEMS;
+    for (int i = 0; i < height; i++) slots *= SNAPSHOT_RADIX;
+    return slots;
+}
+
+// Returns a node or chunk that `next` may write: the one at *link if this publish made
+// it, otherwise a private copy (or a zeroed one for a NULL link) that replaces it at *link
+static void *tree_writable(void **link, int level, unsigned long version) {
+    void *old = *link;
+    if (level == 0) {
+        ItemChunk *chunk = old;
+        if (chunk != NULL && chunk->version == version) return chunk;
+        ItemChunk *fresh = malloc(sizeof(ItemChunk));
+        if (fresh == NULL) return NULL;
+        if (chunk) memcpy(fresh->items, chunk->items, sizeof(fresh->items));
+        else memset(fresh->items, 0, sizeof(fresh->items));
+        atomic_init(&fresh->refs, 1);
+        fresh->version = version;
+        *link = fresh;
+        tree_release(chunk, 0);
+        return fresh;
+    }
+    TreeNode *node = old;
+    if (node != NULL && node->version == version) return node;
+    TreeNode *fresh = malloc(sizeof(TreeNode));
+    if (fresh == NULL) return NULL;
+    if (node) {
+        memcpy(fresh->slots, node->slots, sizeof(fresh->slots));
+        for (int i = 0; i < SNAPSHOT_RADIX; i++) tree_retain(fresh->slots[i], level - 1);
+    } else {
+        memset(fresh->slots, 0, sizeof(fresh->slots));
+    }
+    atomic_init(&fresh->refs, 1);
+    fresh->version = version;
+    *link = fresh;
+    tree_release(node, level);
+    return fresh;
+}
+
+// Writes (item != NULL) or empties the slot of `id` in the version being built. A chunk
+// left with no live slot is dropped, and so is every node left with no child, so memory
+// follows the records that are still live and scans can step over archived ranges.
+static void tree_store(CatalogSnapshot *next, int id, const Item *item) {
+    int slot = id - 1;
+    int c = slot / SNAPSHOT_CHUNK_ITEMS;
+    void **links[SNAPSHOT_MAX_HEIGHT + 1]; // links[level]: where the level's node or chunk hangs
+    void **link = (void **)&next->root;
+    for (int level = next->height; level > 0; level--) {
+        if (item == NULL && *link == NULL) return; // Already empty
+        TreeNode *node = tree_writable(link, level, next->version);
+        if (node == NULL) return;
+        links[level] = link;
+        link = &node->slots[(c >> ((level - 1) * SNAPSHOT_RADIX_BITS)) & (SNAPSHOT_RADIX - 1)];
+    }
+    if (item == NULL && *link == NULL) return;
+    ItemChunk *chunk = tree_writable(link, 0, next->version);
+    if (chunk == NULL) return;
+    if (item) {
+        chunk->items[slot % SNAPSHOT_CHUNK_ITEMS] = *item;
+        return;
+    }
+    memset(&chunk->items[slot % SNAPSHOT_CHUNK_ITEMS], 0, sizeof(Item));
+    for (int i = 0; i < SNAPSHOT_CHUNK_ITEMS; i++) {
+        if (chunk->items[i].id != 0) return;
+    }
+    *link = NULL;
+    tree_release(chunk, 0);
+
+    // The nodes on the path are this version's own copies, so they can be cut loose
+    for (int level = 1; level <= next->height; level++) {
+        TreeNode *node = *links[level];
+        for (int i = 0; i < SNAPSHOT_RADIX; i++) {
+            if (node->slots[i] != NULL) return;
+        }
+        *links[level] = NULL;
+        tree_release(node, level);
+    }
+}
+
+// Builds and installs the next version. Writes items[i] into its slot, or, when items
+// is NULL, empties the slot of ids[i].
+static void publish(const Item *items, const int *ids, int count) {
+    if (count <= 0) return;
+
+    pthread_mutex_lock(&publish_lock);
+
+    // Only writers replace `current`, and we are the only writer, so reading it here is safe
+    CatalogSnapshot *old = current;
+
+    CatalogSnapshot *next = malloc(sizeof(CatalogSnapshot));
+    if (next == NULL) {
+        pthread_mutex_unlock(&publish_lock);
+        return;
+    }
+    atomic_init(&next->refs, 1); // The reference held by `current`
+    next->version = old ? old->version + 1 : 1;
+    next->count = old ? old->count : 0;
+    next->height = old ? old->height : 1;
+    next->root = old ? old->root : NULL; // Shared until a write copies its path
+    tree_retain(next->root, next->height);
+
+    for (int i = 0; items && i < count; i++) {
+        if (items[i].id > next->count) next->count = items[i].id;
+    }
+    // Grow upwards: the old tree becomes the first subtree of a new root
+    while (tree_capacity(next->height) < next->count && next->height < SNAPSHOT_MAX_HEIGHT) {
+        TreeNode *top = calloc(1, sizeof(TreeNode));
+        if (top == NULL) break;
+        atomic_init(&top->refs, 1);
+        top->version = next->version;
+        top->slots[0] = next->root;
+        next->root = top;
+        next->height++;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int id = items ? items[i].id : ids[i];
+        if (id <= 0 || id > next->count || id > tree_capacity(next->height)) continue;
+        tree_store(next, id, items ? &items[i] : NULL);
+    }
+
+    pthread_mutex_lock(&current_lock);
+    current = next;
+    pthread_mutex_unlock(&current_lock);
+
+    pthread_mutex_unlock(&publish_lock);
+
+    // Drop the old version; readers that still hold it keep it alive until they release
+    snapshot_release(old);
+}
+
+void snapshot_publish_items(const Item *items, int count) {
+    publish(items, NULL, count);
+}
+
+void snapshot_publish_item(const Item *item) {
+    snapshot_publish_items(item, 1);
+}
+
+void snapshot_remove_items(const int *ids, int count) {
+    publish(NULL, ids, count);
+}
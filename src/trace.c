@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include "trace.h"
+#include "metrics.h"
+#include "config.h"
+
+#define TRACE_FILE config.trace_file
+#define TRACE_RING 16        // Recent requests kept per thread
+#define TRACE_MAX_SPANS 32   // Spans recorded per request; later ones are counted, not kept
+
+typedef struct {
+    const char *stage;
+    const char *detail; // May be NULL
+    uint64_t start_ns;
+    uint64_t end_ns;
+} TraceSpan;
+
+typedef struct {
+    uint64_t id;
+    int op;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    int span_count;
+    int spans_dropped;
+    TraceSpan spans[TRACE_MAX_SPANS];
+} TraceRecord;
+
+typedef struct {
+    TraceRecord ring[TRACE_RING];
+    unsigned int head;      // Next ring slot to use
+    TraceRecord *current;   // Request in progress, or NULL
+    int tid;
+} TraceThread;
+
+static int enabled = 0;
+static uint64_t slow_ns = 0;
+static int sample_every = 1;
+static uint64_t epoch_ns = 0; // Trace timestamps are relative to trace_init()
+
+static atomic_ulong next_request_id = 1;
+static atomic_ulong slow_seen = 0;
+
+static __thread TraceThread *me = NULL;
+static pthread_key_t thread_key;
+
+static FILE *trace_file = NULL;
+static pthread_mutex_t file_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static TraceThread *get_thread() {
+    if (me) return me;
+    me = calloc(1, sizeof(TraceThread));
+    if (me == NULL) return NULL;
+    me->tid = (int)syscall(SYS_gettid);
+    pthread_setspecific(thread_key, me); // Freed when the thread exits
+    return me;
+}
+
+void trace_init() {
+    if (!config.trace) return;
+    slow_ns = (uint64_t)config.trace_slow_us * 1000ull;
+    sample_every = config.trace_sample;
+
+    trace_file = fopen(TRACE_FILE, "a");
+    if (trace_file == NULL) { perror("trace file"); return; }
+    // The closing ']' is optional in this format, so appending across restarts stays valid
+    fseek(trace_file, 0, SEEK_END);
+    if (ftell(trace_file) == 0) fprintf(trace_file, "[\n");
+
+    pthread_key_create(&thread_key, free);
+    epoch_ns = metrics_now_ns();
+    enabled = 1;
+}
+
+int trace_enabled() {
+    return enabled;
+}
+
+void trace_request_begin(int op, uint64_t received_ns) {
+    if (!enabled) return;
+    TraceThread *t = get_thread();
+    if (t == NULL) return;
+
+    TraceRecord *r = &t->ring[t->head];
+    t->head = (t->head + 1) % TRACE_RING;
+    r->id = atomic_fetch_add(&next_request_id, 1);
+    r->op = op;
+    r->start_ns = received_ns;
+    r->end_ns = 0;
+    r->span_count = 0;
+    r->spans_dropped = 0;
+    t->current = r;
+}
+
+uint64_t trace_span_begin() {
+    return (me && me->current) ? metrics_now_ns() : 0;
+}
+
+void trace_span_end_detail(const char *stage, const char *detail, uint64_t start_ns) {
+    if (start_ns == 0 || me == NULL || me->current == NULL) return;
+    TraceRecord *r = me->current;
+    if (r->span_count == TRACE_MAX_SPANS) { r->spans_dropped++; return; }
+    r->spans[r->span_count++] = (TraceSpan){ stage, detail, start_ns, metrics_now_ns() };
+}
+
+void trace_span_end(const char *stage, uint64_t start_ns) {
+    trace_span_end_detail(stage, NULL, start_ns);
+}
+
+static void write_event(const char *name, const char *detail, const char *cat, uint64_t start_ns,
+                        uint64_t end_ns, int tid, const TraceRecord *r, int is_root) {
+    fprintf(trace_file, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+            "\"pid\":%d,\"tid\":%d,\"args\":{\"req\":%lu",
+            name, cat, (start_ns - epoch_ns) / 1000.0, (end_ns - start_ns) / 1000.0,
+            (int)getpid(), tid, (unsigned long)r->id);
+    if (detail) fprintf(trace_file, ",\"detail\":\"%s\"", detail);
+    if (is_root && r->spans_dropped) fprintf(trace_file, ",\"spans_dropped\":%d", r->spans_dropped);
+    fprintf(trace_file, "}},\n");
+}
+
+void trace_request_end() {
+    if (me == NULL || me->current == NULL) return;
+    TraceRecord *r = me->current;
+    me->current = NULL;
+    r->end_ns = metrics_now_ns();
+
+    if (r->end_ns - r->start_ns < slow_ns) return;
+    if (atomic_fetch_add(&slow_seen, 1) % sample_every != 0) return;
+
+    const char *op_name = metrics_op_name(r->op);
+    pthread_mutex_lock(&file_lock);
+    write_event(op_name, NULL, op_name, r->start_ns, r->end_ns, me->tid, r, 1);
+    for (int i = 0; i < r->span_count; i++) {
+        TraceSpan *s = &r->spans[i];
+        write_event(s->stage, s->detail, op_name, s->start_ns, s->end_ns, me->tid, r, 0);
+    }
+    fflush(trace_file);
+    pthread_mutex_unlock(&file_lock);
+}
@@ -0,0 +1,271 @@
+#define _GNU_SOURCE // memfd_create, POLLRDHUP
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "transport.h"
+
+#define SHM_SPIN 4096       // Polls of an idle ring before sleeping on the futex (multi-CPU hosts)
+#define SHM_POLL_MS 200     // Sleepers wake this often to check the socket is still open
+
+struct ShmChannel {
+    void *base;
+    size_t size;
+    int fd;               // memfd, until it has been handed to the client
+    ShmRing *in, *out;    // We read `in` and write `out`
+    uint8_t *in_data, *out_data;
+    uint32_t mask;        // ring_bytes - 1
+};
+
+void transport_init(Transport *t, int sock) {
+    memset(t, 0, sizeof(Transport));
+    t->sock = sock;
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    t->local = getsockname(sock, (struct sockaddr *)&addr, &len) == 0 && addr.ss_family == AF_UNIX;
+}
+
+// ---- Shared-memory rings ----
+
+// Cross-process futexes: the words live in a MAP_SHARED mapping, so no FUTEX_PRIVATE_FLAG
+static void futex_wait(_Atomic uint32_t *word, uint32_t expected) {
+    struct timespec timeout = { SHM_POLL_MS / 1000, (SHM_POLL_MS % 1000) * 1000000L };
+    syscall(SYS_futex, word, FUTEX_WAIT, expected, &timeout, NULL, 0);
+}
+
+static void futex_wake(_Atomic uint32_t *word) {
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// The socket is the session's lifeline; a hang-up on it ends the shared-memory session too
+static int peer_gone(int sock) {
+    struct pollfd pfd = { .fd = sock, .events = POLLRDHUP };
+    return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLHUP | POLLRDHUP | POLLERR | POLLNVAL));
+}
+
+// On one CPU the peer cannot make progress while we spin, so sleep straight away
+static int spin_limit() {
+    static int limit = -1;
+    if (limit == -1) limit = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SHM_SPIN : 0;
+    return limit;
+}
+
+// Waits until `counter` moves off `value`. flag is this side's *_waiting word.
+// Returns 0 if the peer went away first.
+static int ring_wait(Transport *t, _Atomic uint32_t *counter, uint32_t value, _Atomic uint32_t *flag) {
+    int spins = spin_limit();
+    for (int spin = 0; spin < spins; spin++) {
+        if (atomic_load_explicit(counter, memory_order_acquire) != value) return 1;
+    }
+    while (1) {
+        // Flag first, then re-check: the other side advances, then checks the flag
+        atomic_store(flag, 1);
+        if (atomic_load(counter) != value) break;
+        futex_wait(counter, value);
+        if (atomic_load(counter) != value) break;
+        if (peer_gone(t->sock)) {
+            atomic_store(flag, 0);
+            return 0;
+        }
+    }
+    atomic_store(flag, 0);
+    return 1;
+}
+
+static int shm_recv(Transport *t, void *buf, size_t len) {
+    ShmChannel *ch = t->shm;
+    ShmRing *r = ch->in;
+    uint8_t *dst = buf;
+    size_t done = 0;
+    while (done < len) {
+        uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed); // Ours alone
+        uint32_t avail = atomic_load_explicit(&r->tail, memory_order_acquire) - head;
+        if (avail > ch->mask + 1) return -1; // The peer wrote a bad tail; end the session
+        if (avail == 0) {
+            if (!ring_wait(t, &r->tail, head, &r->reader_waiting)) return 0;
+            continue;
+        }
+        size_t n = len - done < avail ? len - done : avail;
+        size_t at = head & ch->mask;
+        size_t first = n < ch->mask + 1 - at ? n : ch->mask + 1 - at;
+        memcpy(dst + done, ch->in_data + at, first);
+        memcpy(dst + done + first, ch->in_data, n - first);
+        atomic_store(&r->head, head + (uint32_t)n);
+        if (atomic_load(&r->writer_waiting)) futex_wake(&r->head);
+        done += n;
+    }
+    return (int)len;
+}
+
+static int shm_send(Transport *t, const void *buf, size_t len) {
+    ShmChannel *ch = t->shm;
+    ShmRing *r = ch->out;
+    const uint8_t *src = buf;
+    size_t done = 0;
+    while (done < len) {
+        uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed); // Ours alone
+        uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        if (tail - head > ch->mask + 1) return -1; // The peer wrote a bad head; end the session
+        uint32_t space = ch->mask + 1 - (tail - head);
+        if (space == 0) {
+            if (!ring_wait(t, &r->head, head, &r->writer_waiting)) return -1;
+            continue;
+        }
+        size_t n = len - done < space ? len - done : space;
+        size_t at = tail & ch->mask;
+        size_t first = n < ch->mask + 1 - at ? n : ch->mask + 1 - at;
+        memcpy(ch->out_data + at, src + done, first);
+        memcpy(ch->out_data, src + done + first, n - first);
+        atomic_store(&r->tail, tail + (uint32_t)n);
+        if (atomic_load(&r->reader_waiting)) futex_wake(&r->tail);
+        done += n;
+    }
+    return (int)len;
+}
+
+// Points the channel's in/out rings at the mapping (the server reads requests)
+static void shm_bind(ShmChannel *ch, int server) {
+    ShmHeader *h = ch->base;
+    ShmRing *requests = (ShmRing *)((uint8_t *)ch->base + h->request_offset);
+    ShmRing *responses = (ShmRing *)((uint8_t *)ch->base + h->response_offset);
+    ch->in = server ? requests : responses;
+    ch->out = server ? responses : requests;
+    ch->in_data = (uint8_t *)(ch->in + 1);
+    ch->out_data = (uint8_t *)(ch->out + 1);
+    ch->mask = h->ring_bytes - 1;
+}
+
+static void shm_free(ShmChannel *ch) {
+    if (ch == NULL) return;
+    if (ch->base) munmap(ch->base, ch->size);
+    if (ch->fd != -1) close(ch->fd);
+    free(ch);
+}
+
+int transport_shm_offer(Transport *t, size_t ring_bytes) {
+    if (!t->local || t->shm || t->offer) return -1;
+    uint32_t bytes = 4096;
+    while (bytes < ring_bytes && bytes < (1u << 30)) bytes <<= 1;
+
+    ShmChannel *ch = calloc(1, sizeof(ShmChannel));
+    if (ch == NULL) return -1;
+    ch->fd = memfd_create("auction-shm", MFD_CLOEXEC);
+    ch->size = sizeof(ShmHeader) + 2 * (sizeof(ShmRing) + bytes);
+    if (ch->fd == -1 || ftruncate(ch->fd, ch->size) == -1) { shm_free(ch); return -1; }
+    ch->base = mmap(NULL, ch->size, PROT_READ | PROT_WRITE, MAP_SHARED, ch->fd, 0);
+    if (ch->base == MAP_FAILED) { ch->base = NULL; shm_free(ch); return -1; }
+
+    ShmHeader *h = ch->base; // The memfd starts zeroed, so both rings start empty
+    memcpy(h->magic, SHM_MAGIC, sizeof(h->magic));
+    h->ring_bytes = bytes;
+    h->request_offset = sizeof(ShmHeader);
+    h->response_offset = sizeof(ShmHeader) + sizeof(ShmRing) + bytes;
+    shm_bind(ch, 1);
+    t->offer = ch;
+    return 0;
+}
+
+int transport_shm_start(Transport *t) {
+    ShmChannel *ch = t->offer;
+    if (ch == NULL) return -1;
+    t->offer = NULL;
+
+    char byte = 'S';
+    struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control, .msg_controllen = sizeof(control) };
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cm), &ch->fd, sizeof(int));
+    if (sendmsg(t->sock, &msg, MSG_NOSIGNAL) != 1) { shm_free(ch); return -1; }
+
+    close(ch->fd); // The mapping keeps the memory alive
+    ch->fd = -1;
+    t->shm = ch;
+    return 0;
+}
+
+int transport_shm_attach(Transport *t) {
+    char byte;
+    struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+    char control[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control, .msg_controllen = sizeof(control) };
+    if (recvmsg(t->sock, &msg, MSG_CMSG_CLOEXEC) != 1) return -1;
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    if (cm == NULL || cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS) return -1;
+
+    ShmChannel *ch = calloc(1, sizeof(ShmChannel));
+    if (ch == NULL) return -1;
+    memcpy(&ch->fd, CMSG_DATA(cm), sizeof(int));
+    struct stat st;
+    if (fstat(ch->fd, &st) == -1 || st.st_size < (off_t)sizeof(ShmHeader)) { shm_free(ch); return -1; }
+    ch->size = st.st_size;
+    ch->base = mmap(NULL, ch->size, PROT_READ | PROT_WRITE, MAP_SHARED, ch->fd, 0);
+    if (ch->base == MAP_FAILED) { ch->base = NULL; shm_free(ch); return -1; }
+    close(ch->fd);
+    ch->fd = -1;
+
+    ShmHeader *h = ch->base;
+    if (memcmp(h->magic, SHM_MAGIC, sizeof(h->magic)) != 0 ||
+        (h->ring_bytes & (h->ring_bytes - 1)) != 0 ||
+        h->response_offset + sizeof(ShmRing) + (size_t)h->ring_bytes > ch->size) {
+        shm_free(ch);
+        return -1;
+    }
+    shm_bind(ch, 0);
+    t->shm = ch;
+    return 0;
+}
+
+// ---- Either transport ----
+
+int transport_recv(Transport *t, void *buf, size_t len) {
+    if (t->shm) return shm_recv(t, buf, len);
+    size_t total = 0;
+    while (total < len) {
+        ssize_t received = recv(t->sock, (char *)buf + total, len - total, 0);
+        if (received <= 0) return received; // Error or closed
+        total += received;
+    }
+    return (int)total;
+}
+
+int transport_wait_readable(Transport *t) {
+    if (t->shm) {
+        ShmRing *r = t->shm->in;
+        uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+        return ring_wait(t, &r->tail, head, &r->reader_waiting);
+    }
+    char first_byte;
+    return recv(t->sock, &first_byte, 1, MSG_PEEK) > 0;
+}
+
+int transport_send(Transport *t, const void *buf, size_t len) {
+    if (t->shm) return shm_send(t, buf, len);
+    size_t total = 0;
+    while (total < len) {
+        ssize_t sent = send(t->sock, (const char *)buf + total, len - total, MSG_NOSIGNAL);
+        if (sent <= 0) return -1;
+        total += sent;
+    }
+    return (int)total;
+}
+
+void transport_close(Transport *t) {
+    shm_free(t->shm);
+    shm_free(t->offer);
+    t->shm = t->offer = NULL;
+    close(t->sock);
+}
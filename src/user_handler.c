@@ -1,185 +1,164 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
-#include <fcntl.h>
+#include <pthread.h>
 #include "common.h"
+#include "config.h"
 #include "logger.h"
-#include "file_handler.h"
+#include "auth_pool.h"
+#include "kdf.h"
+#include "user_store.h"
 #include <time.h>
 
-#define USER_FILE "data/users.dat"
-
-// Helper to get next ID
-int get_next_user_id() {
-    int fd = open(USER_FILE, O_RDONLY);
-    if (fd == -1) return 1; // File doesn't exist, start at 1
-
-    User u;
-    int max_id = 0;
-    
-    // Read sequentially to find max ID (Locking not strictly needed for just reading size)
-    while(read(fd, &u, sizeof(User)) > 0) {
-        if (u.id > max_id) max_id = u.id;
-    }
-    close(fd);
-    return max_id + 1;
-}
+// Users live in the in-memory store (user_store.c); it owns users.dat while the server runs.
+// Every function here works on a UserEntry under its mutex, never on the file.
 
 int register_user(const char *username, const char *password, int role, int initial_balance, const char *sec_answer) {
-    int fd = open(USER_FILE, O_RDWR | O_CREAT, 0666);
-    if (fd == -1) return -1;
-
-    if (lock_record(fd, F_WRLCK, 0, 0) == -1) { close(fd); return -1; }
-
-    User u;
-    lseek(fd, 0, SEEK_SET);
-    while (read(fd, &u, sizeof(User)) > 0) {
-        if (strcmp(u.username, username) == 0) {
-            unlock_record(fd, 0, 0); close(fd); return -2; 
-        }
-    }
-
-    off_t file_size = lseek(fd, 0, SEEK_END);
-    int new_id = (file_size / sizeof(User)) + 1;
+    // Hash first; scrypt is far slower than the registration itself
+    char hashed_pw[50], hashed_ans[50];
+    if (auth_hash(password, hashed_pw) == -1 || auth_hash(sec_answer, hashed_ans) == -1) return -1;
 
     User new_user;
-    new_user.id = new_id;
+    memset(&new_user, 0, sizeof(User));
     strcpy(new_user.username, username);
-    hash_password(password, new_user.password); 
+    strcpy(new_user.password, hashed_pw);
     new_user.role = role;
     new_user.balance = initial_balance;
-    new_user.cooldown_until = 0; 
-    
-    // --- HASH AND SAVE SECURITY ANSWER ---
-    hash_password(sec_answer, new_user.security_answer);
-
-    write(fd, &new_user, sizeof(User));
-    unlock_record(fd, 0, 0); close(fd);
-    
-    return new_id;
+    new_user.cooldown_until = 0;
+
+    // --- SAVE HASHED SECURITY ANSWER ---
+    strcpy(new_user.security_answer, hashed_ans);
+
+    return user_store_add(&new_user); // New ID, or -2 if the username is taken
 }
 
 int get_user_balance(int user_id) {
-    int fd = open(USER_FILE, O_RDONLY);
-    if (fd == -1) return -1;
+    UserEntry *e = user_store_get(user_id);
+    if (e == NULL) return -1;
 
-    off_t offset = (user_id - 1) * sizeof(User);
-    
-    if (lock_record(fd, F_RDLCK, offset, sizeof(User)) == -1) {
-        close(fd); return -1;
-    }
+    pthread_mutex_lock(&e->lock);
+    int balance = e->rec.balance;
+    pthread_mutex_unlock(&e->lock);
+    return balance;
+}
 
-    User u;
-    lseek(fd, offset, SEEK_SET);
-    if (read(fd, &u, sizeof(User)) <= 0) {
-        unlock_record(fd, offset, sizeof(User));
-        close(fd); 
-        return -1;
+int get_user_role(int user_id) {
+    UserEntry *e = user_store_get(user_id);
+    return e ? e->rec.role : -1; // Role never changes after registration
+}
+
+// Password checks run without the entry lock held, so by the time we write, another
+// login or reset may have changed the record. Store the new hashes (NULL = keep) only if
+// the credentials are still the ones in `seen`.
+// Returns 1 if written, 0 if the record changed in the meantime.
+static int replace_credentials(UserEntry *e, const User *seen, const char *password, const char *answer) {
+    int status = 0;
+    pthread_mutex_lock(&e->lock);
+    if (strcmp(e->rec.password, seen->password) == 0 &&
+        strcmp(e->rec.security_answer, seen->security_answer) == 0) {
+        if (password) strcpy(e->rec.password, password);
+        if (answer) strcpy(e->rec.security_answer, answer);
+        user_store_mark_dirty(e);
+        status = 1;
     }
+    pthread_mutex_unlock(&e->lock);
+    return status;
+}
 
-    unlock_record(fd, offset, sizeof(User));
-    close(fd);
-    return u.balance;
+// Copies a user's record out under its lock
+static UserEntry *copy_user(int user_id, User *out) {
+    UserEntry *e = user_store_get(user_id);
+    if (e == NULL) return NULL;
+    pthread_mutex_lock(&e->lock);
+    *out = e->rec;
+    pthread_mutex_unlock(&e->lock);
+    return e;
 }
 
-int authenticate_user(const char *username, const char *password) {
-    int fd = open(USER_FILE, O_RDONLY);
-    if (fd == -1) return -1;
+// Legacy DJB2 hashes, or scrypt hashes made with other cost settings
+static int needs_rehash(const char *stored) {
+    return kdf_needs_rehash(stored, config.kdf_log_n, config.kdf_r, config.kdf_p);
+}
 
-    // Apply a read lock
-    if (lock_record(fd, F_RDLCK, 0, 0) == -1) {
-        close(fd); 
-        return -1;
+// Verified against when the username is unknown, so that costs the same scrypt as a
+// wrong password and login timing does not reveal which names exist
+static char dummy_hash[KDF_HASH_LEN + 1];
+static pthread_once_t dummy_once = PTHREAD_ONCE_INIT;
+
+static void make_dummy_hash() {
+    if (kdf_hash("", config.kdf_log_n, config.kdf_r, config.kdf_p, dummy_hash) == -1) {
+        strcpy(dummy_hash, "$"); // Never matches; only the timing cover is lost
     }
+}
 
+int authenticate_user(const char *username, const char *password) {
     User u;
-    int authenticated_id = -1; // <--- We declare the variable here!
-
-    // Scan the file for the username
-    while (read(fd, &u, sizeof(User)) > 0) {
-        if (strcmp(u.username, username) == 0) {
-            
-            // Hash the incoming password to compare it against the stored hash
-            char hashed_incoming[50];
-            hash_password(password, hashed_incoming);
-            
-            // If the hashes match, grab the user's ID
-            if (strcmp(u.password, hashed_incoming) == 0) {
-                authenticated_id = u.id;
-            }
-            break; // Username found, no need to keep reading the file
-        }
+    UserEntry *e = copy_user(user_store_find(username), &u);
+    if (e == NULL) {
+        pthread_once(&dummy_once, make_dummy_hash);
+        auth_verify(password, dummy_hash);
+        return -1; // Not found
+    }
+    if (!auth_verify(password, u.password)) {
+        return -1; // Wrong password
     }
 
-    unlock_record(fd, 0, 0);
-    close(fd);
-    
-    return authenticated_id; // Will return -1 if not found or wrong password
+    // Upgrade old hashes while we have the plaintext; losing the race just means
+    // someone else already changed the password, so it is not an error.
+    if (needs_rehash(u.password)) {
+        char fresh[50];
+        if (auth_hash(password, fresh) == 0) replace_credentials(e, &u, fresh, NULL);
+    }
+    return u.id;
 }
 
 int transfer_funds(int from_user_id, int to_user_id, int amount) {
-    int fd = open(USER_FILE, O_RDWR);
-    if (fd == -1) return -1;
+    UserEntry *from = user_store_get(from_user_id);
+    UserEntry *to = user_store_get(to_user_id);
+    if (from == NULL || to == NULL || from == to) return -1;
 
     // DEADLOCK PREVENTION: Always lock smaller ID first
-    int first_id = (from_user_id < to_user_id) ? from_user_id : to_user_id;
-    int second_id = (from_user_id < to_user_id) ? to_user_id : from_user_id;
-
-    off_t offset1 = (first_id - 1) * sizeof(User);
-    off_t offset2 = (second_id - 1) * sizeof(User);
+    UserEntry *first = (from_user_id < to_user_id) ? from : to;
+    UserEntry *second = (from_user_id < to_user_id) ? to : from;
 
     // 1. Lock First User
-    if (lock_record(fd, F_WRLCK, offset1, sizeof(User)) == -1) {
-        close(fd); return -1;
-    }
-    
+    pthread_mutex_lock(&first->lock);
     // 2. Lock Second User
-    if (lock_record(fd, F_WRLCK, offset2, sizeof(User)) == -1) {
-        unlock_record(fd, offset1, sizeof(User)); // Rollback
-        close(fd); return -1;
-    }
+    pthread_mutex_lock(&second->lock);
 
-    // 3. Read Both Users
-    User u1, u2;
-    lseek(fd, offset1, SEEK_SET); read(fd, &u1, sizeof(User));
-    lseek(fd, offset2, SEEK_SET); read(fd, &u2, sizeof(User));
-
-    // 4. Identify Payer and Payee (since we swapped IDs for locking)
-    User *payer = (u1.id == from_user_id) ? &u1 : &u2;
-    User *payee = (u1.id == to_user_id) ? &u1 : &u2;
+    // 3. Payer and Payee are the entries themselves
+    User *payer = &from->rec;
+    User *payee = &to->rec;
 
     char log_msg[200];
-    sprintf(log_msg, "Transaction in progress: User %d (%s) transferring $%d to User %d (%s)", 
+    sprintf(log_msg, "Transaction in progress: User %d (%s) transferring $%d to User %d (%s)",
             from_user_id, payer->username, amount, to_user_id, payee->username);
     write_log(log_msg);
 
-    // 5. Check Balance
+    // 4. Check Balance
     if (payer->balance < amount) {
         // Insufficient funds
-        unlock_record(fd, offset2, sizeof(User));
-        unlock_record(fd, offset1, sizeof(User));
-        close(fd);
-        sprintf(log_msg, "Transaction failed: User %d (%s) has insufficient funds.", 
+        pthread_mutex_unlock(&second->lock);
+        pthread_mutex_unlock(&first->lock);
+        sprintf(log_msg, "Transaction failed: User %d (%s) has insufficient funds.",
                 from_user_id, payer->username);
         write_log(log_msg);
         return -2;
     }
 
-    // 6. Perform Transfer
+    // 5. Perform Transfer
     payer->balance -= amount;
     payee->balance += amount;
 
-    // 7. Write Back
-    lseek(fd, offset1, SEEK_SET); write(fd, &u1, sizeof(User));
-    lseek(fd, offset2, SEEK_SET); write(fd, &u2, sizeof(User));
+    // 6. Queue both for write-back
+    user_store_mark_dirty(from);
+    user_store_mark_dirty(to);
+
+    // 7. Unlock Both
+    pthread_mutex_unlock(&second->lock);
+    pthread_mutex_unlock(&first->lock);
 
-    // 8. Unlock Both
-    unlock_record(fd, offset2, sizeof(User));
-    unlock_record(fd, offset1, sizeof(User));
-    
-    close(fd);
-    sprintf(log_msg, "Transaction successful: User %d (%s) transferred $%d to User %d (%s)", 
+    sprintf(log_msg, "Transaction successful: User %d (%s) transferred $%d to User %d (%s)",
             from_user_id, payer->username, amount, to_user_id, payee->username);
     write_log(log_msg);
     return 1;
@@ -187,165 +166,91 @@ int transfer_funds(int from_user_id, int to_user_id, int amount) {
 
 void get_username(int user_id, char *buffer) {
     strcpy(buffer, "Unknown"); // Default fallback
-    if (user_id <= 0) return;
-    
-    int fd = open(USER_FILE, O_RDONLY);
-    if (fd == -1) return;
-
-    User u;
-    // Jump directly to the user's record
-    lseek(fd, (user_id - 1) * sizeof(User), SEEK_SET);
-    if (read(fd, &u, sizeof(User)) > 0) {
-        strcpy(buffer, u.username); // Copy name to buffer
-    }
-    close(fd);
+    UserEntry *e = user_store_get(user_id);
+    if (e) strcpy(buffer, e->rec.username); // Usernames never change
 }
 
 int update_balance(int user_id, int amount_change) {
-    int fd = open(USER_FILE, O_RDWR);
-    if (fd == -1) return -1;
-    
-    off_t offset = (user_id - 1) * sizeof(User);
-    if (lock_record(fd, F_WRLCK, offset, sizeof(User)) == -1) {
-        close(fd); return -1;
-    }
-    
-    User u;
-    lseek(fd, offset, SEEK_SET);
-    if (read(fd, &u, sizeof(User)) <= 0) {
-        unlock_record(fd, offset, sizeof(User));
-        close(fd); return -1;
-    }
-    
+    UserEntry *e = user_store_get(user_id);
+    if (e == NULL) return -1;
+
+    pthread_mutex_lock(&e->lock);
+
     // If deducting, check if balance is sufficient
-    if (amount_change < 0 && u.balance < -amount_change) {
-        unlock_record(fd, offset, sizeof(User));
-        close(fd); return -2; // Insufficient Funds
+    if (amount_change < 0 && e->rec.balance < -amount_change) {
+        pthread_mutex_unlock(&e->lock);
+        return -2; // Insufficient Funds
     }
-    
-    u.balance += amount_change;
-    
-    lseek(fd, offset, SEEK_SET);
-    write(fd, &u, sizeof(User));
-    
-    unlock_record(fd, offset, sizeof(User));
-    close(fd);
+
+    e->rec.balance += amount_change;
+    user_store_mark_dirty(e);
+
+    pthread_mutex_unlock(&e->lock);
     return 1;
 }
 
 int get_user_cooldown(int user_id) {
-    int fd = open(USER_FILE, O_RDONLY);
-    if (fd == -1) return 0;
-    
-    User u;
-    lseek(fd, (user_id - 1) * sizeof(User), SEEK_SET);
-    if (read(fd, &u, sizeof(User)) > 0) {
-        close(fd);
-        time_t now = time(NULL);
-        if (u.cooldown_until > now) {
-            return (int)(u.cooldown_until - now);
-        }
-    } else {
-        close(fd);
-    }
-    return 0;
+    UserEntry *e = user_store_get(user_id);
+    if (e == NULL) return 0;
+
+    pthread_mutex_lock(&e->lock);
+    time_t until = e->rec.cooldown_until;
+    pthread_mutex_unlock(&e->lock);
+
+    time_t now = time(NULL);
+    return until > now ? (int)(until - now) : 0;
 }
 
 void set_user_cooldown(int user_id, int cooldown_seconds) {
-    int fd = open(USER_FILE, O_RDWR);
-    if (fd == -1) return;
-    
-    off_t offset = (user_id - 1) * sizeof(User);
-    if (lock_record(fd, F_WRLCK, offset, sizeof(User)) != -1) {
-        User u;
-        lseek(fd, offset, SEEK_SET);
-        if (read(fd, &u, sizeof(User)) > 0) {
-            u.cooldown_until = time(NULL) + cooldown_seconds;
-            lseek(fd, offset, SEEK_SET);
-            write(fd, &u, sizeof(User));
-        }
-        unlock_record(fd, offset, sizeof(User));
-    }
-    close(fd);
+    UserEntry *e = user_store_get(user_id);
+    if (e == NULL) return;
+
+    pthread_mutex_lock(&e->lock);
+    e->rec.cooldown_until = time(NULL) + cooldown_seconds;
+    user_store_mark_dirty(e);
+    pthread_mutex_unlock(&e->lock);
 }
 
-// Lightweight DJB2 Hash Algorithm to safely scramble passwords
+// Salted scrypt via the auth pool (see kdf.h for the stored format)
 void hash_password(const char *str, char *output) {
-    unsigned long hash = 5381;
-    int c;
-    while ((c = *str++)) {
-        hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
-    }
-    // Convert the numeric hash into a string we can store
-    sprintf(output, "%lu", hash); 
+    if (auth_hash(str, output) == -1) output[0] = '\0'; // Matches no password
 }
 
 int reset_password(int user_id, const char *old_pwd, const char *new_pwd) {
-    int fd = open(USER_FILE, O_RDWR);
-    if (fd == -1) return -1;
-
-    off_t offset = (user_id - 1) * sizeof(User);
-    if (lock_record(fd, F_WRLCK, offset, sizeof(User)) == -1) {
-        close(fd); return -1;
-    }
-
     User u;
-    lseek(fd, offset, SEEK_SET);
-    if (read(fd, &u, sizeof(User)) <= 0) {
-        unlock_record(fd, offset, sizeof(User)); close(fd); return -1;
-    }
+    UserEntry *e = copy_user(user_id, &u);
+    if (e == NULL) return -1;
 
-    // Verify old password
-    char hashed_old[50];
-    hash_password(old_pwd, hashed_old);
-    if (strcmp(u.password, hashed_old) != 0) {
-        unlock_record(fd, offset, sizeof(User)); close(fd); return -2; // Incorrect old password
+    // Verify old password and hash the new one outside the lock
+    if (!auth_verify(old_pwd, u.password)) {
+        return -2; // Incorrect old password
     }
+    char hashed_new[50];
+    if (auth_hash(new_pwd, hashed_new) == -1) return -1;
 
-    // Hash and save new password
-    hash_password(new_pwd, u.password);
-
-    lseek(fd, offset, SEEK_SET);
-    write(fd, &u, sizeof(User));
-
-    unlock_record(fd, offset, sizeof(User));
-    close(fd);
+    if (replace_credentials(e, &u, hashed_new, NULL) == 0) return -2; // Changed by someone else since we checked the old one
     return 1;
 }
 
 int process_forgot_password(const char *username, const char *sec_answer, const char *new_password) {
-    int fd = open(USER_FILE, O_RDWR);
-    if (fd == -1) return -1;
-    if (lock_record(fd, F_WRLCK, 0, 0) == -1) { close(fd); return -1; }
-
     User u;
-    int found = 0;
-    off_t offset = 0;
-    
-    // Scan for the username
-    while (read(fd, &u, sizeof(User)) > 0) {
-        if (strcmp(u.username, username) == 0) {
-            found = 1;
-            break;
-        }
-        offset += sizeof(User);
-    }
-
-    if (!found) { unlock_record(fd, 0, 0); close(fd); return -1; } // User not found
+    UserEntry *e = copy_user(user_store_find(username), &u);
+    if (e == NULL) return -1; // User not found
 
-    // Hash the provided answer to compare it
-    char hashed_ans[50];
-    hash_password(sec_answer, hashed_ans);
-
-    if (strcmp(u.security_answer, hashed_ans) != 0) {
-        unlock_record(fd, 0, 0); close(fd); return -2; // Wrong answer
+    if (!auth_verify(sec_answer, u.security_answer)) {
+        return -2; // Wrong answer
     }
 
-    // Answer is correct! Hash and save the new password
-    hash_password(new_password, u.password);
-    lseek(fd, offset, SEEK_SET);
-    write(fd, &u, sizeof(User));
+    // Answer is correct! Hash the new password (and upgrade an old answer hash)
+    char hashed_pw[50], hashed_ans[50];
+    int rehash_answer = needs_rehash(u.security_answer);
+    if (auth_hash(new_password, hashed_pw) == -1 ||
+        (rehash_answer && auth_hash(sec_answer, hashed_ans) == -1)) {
+        return -1;
+    }
 
-    unlock_record(fd, 0, 0); close(fd);
+    if (replace_credentials(e, &u, hashed_pw, rehash_answer ? hashed_ans : NULL) == 0) {
+        return -2; // Credentials changed since the answer was checked
+    }
     return 1; // Success
-}
\ No newline at end of file
+}
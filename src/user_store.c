@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "config.h"
+#include "file_handler.h"
+#include "user_store.h"
+#include "record_io.h"
+
+#define USER_CHUNK 1024          // Entries per allocation; chunks never move
+#define USER_MAX_CHUNKS 16384    // Up to 16M users
+
+static _Atomic(UserEntry *) chunks[USER_MAX_CHUNKS];
+static atomic_int next_user_id = 1;  // Next ID to hand out; lower IDs may still be being written
+static int users_fd = -1;            // Kept open for write-back
+static int users_file = -1;          // Its record_io slot
+
+// Username -> ID, open addressing. Readers take the read lock, registration the write lock.
+static pthread_rwlock_t names_lock = PTHREAD_RWLOCK_INITIALIZER;
+static int *name_slots = NULL;       // 0 = empty, otherwise a user ID
+static size_t name_capacity = 0;     // Power of two
+
+// Dirty IDs waiting for write-back
+static pthread_mutex_t dirty_lock = PTHREAD_MUTEX_INITIALIZER;
+static int *dirty_ids = NULL;
+static size_t dirty_count = 0, dirty_capacity = 0;
+
+// FNV-1a
+static size_t hash_name(const char *name) {
+    uint32_t h = 2166136261u;
+    for (; *name; name++) {
+        h ^= (unsigned char)*name;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// The slot for an ID, whether or not its registration has finished
+static UserEntry *entry_at(int user_id) {
+    UserEntry *chunk = atomic_load(&chunks[(user_id - 1) / USER_CHUNK]);
+    return chunk ? &chunk[(user_id - 1) % USER_CHUNK] : NULL;
+}
+
+UserEntry *user_store_get(int user_id) {
+    if (user_id <= 0 || user_id >= atomic_load(&next_user_id)) return NULL;
+    UserEntry *entry = entry_at(user_id);
+    return entry && atomic_load(&entry->live) ? entry : NULL;
+}
+
+int user_store_next_id() {
+    return atomic_load(&next_user_id);
+}
+
+// Caller holds names_lock for writing and has made room
+static void insert_name(int user_id) {
+    const char *name = entry_at(user_id)->rec.username; // Never changes once registered
+    size_t i = hash_name(name) & (name_capacity - 1);
+    while (name_slots[i] != 0) i = (i + 1) & (name_capacity - 1);
+    name_slots[i] = user_id;
+}
+
+static int grow_names(size_t min_capacity) {
+    size_t capacity = name_capacity ? name_capacity : 1024;
+    while (capacity < min_capacity * 2) capacity *= 2; // Keep the load under one half
+    if (capacity == name_capacity) return 0;
+
+    int *old = name_slots;
+    size_t old_capacity = name_capacity;
+    name_slots = calloc(capacity, sizeof(int));
+    if (name_slots == NULL) {
+        name_slots = old;
+        return -1;
+    }
+    name_capacity = capacity;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i] != 0) insert_name(old[i]);
+    }
+    free(old);
+    return 0;
+}
+
+// Any ID holding `username`, including a registration still in flight. Caller holds names_lock.
+static int lookup_name(const char *username) {
+    if (name_capacity == 0) return -1;
+    size_t i = hash_name(username) & (name_capacity - 1);
+    for (; name_slots[i] != 0; i = (i + 1) & (name_capacity - 1)) {
+        if (strcmp(entry_at(name_slots[i])->rec.username, username) == 0) return name_slots[i];
+    }
+    return -1;
+}
+
+int user_store_find(const char *username) {
+    pthread_rwlock_rdlock(&names_lock);
+    int found = lookup_name(username);
+    pthread_rwlock_unlock(&names_lock);
+    return user_store_get(found) ? found : -1; // Not until its record is on disk
+}
+
+// Makes room for entry `user_id` and initialises it (not live yet).
+// The first entry of a chunk also reserves the chunk's range of users.dat.
+static UserEntry *new_entry(int user_id, const User *rec) {
+    int c = (user_id - 1) / USER_CHUNK;
+    if (c >= USER_MAX_CHUNKS) return NULL;
+    UserEntry *chunk = atomic_load(&chunks[c]);
+    if (chunk == NULL) {
+        UserEntry *fresh = calloc(USER_CHUNK, sizeof(UserEntry));
+        if (fresh == NULL) return NULL;
+        if (atomic_compare_exchange_strong(&chunks[c], &chunk, fresh)) {
+            chunk = fresh;
+            preallocate_records(users_fd, (off_t)c * USER_CHUNK * sizeof(User), USER_CHUNK * sizeof(User));
+        } else {
+            free(fresh); // Another registration got there first; chunk now holds its table
+        }
+    }
+    UserEntry *entry = &chunk[(user_id - 1) % USER_CHUNK];
+    pthread_mutex_init(&entry->lock, NULL);
+    entry->rec = *rec;
+    entry->dirty = 0;
+    return entry;
+}
+
+static void write_record(const User *rec) {
+    record_write(users_file, rec, sizeof(User), (off_t)(rec->id - 1) * sizeof(User));
+}
+
+int user_store_add(User *rec) {
+    // Claim the name and an ID together, so a second registration of the same name
+    // sees the first one even before it reaches the disk
+    pthread_rwlock_wrlock(&names_lock);
+    if (lookup_name(rec->username) != -1) {
+        pthread_rwlock_unlock(&names_lock);
+        return -2;
+    }
+    int user_id = atomic_fetch_add(&next_user_id, 1);
+    rec->id = user_id;
+    UserEntry *entry = new_entry(user_id, rec);
+    if (entry == NULL || grow_names(user_id) == -1) {
+        pthread_rwlock_unlock(&names_lock);
+        return -1; // The ID is simply never used
+    }
+    insert_name(user_id);
+    pthread_rwlock_unlock(&names_lock);
+
+    // Every registration owns its slot, so the write and sync run in parallel
+    if (record_write(users_file, rec, sizeof(User), (off_t)(user_id - 1) * sizeof(User)) != sizeof(User)) {
+        pthread_rwlock_wrlock(&names_lock);
+        entry->rec.username[0] = '\0'; // Frees the name; the slot stays in the map but never matches
+        pthread_rwlock_unlock(&names_lock);
+        return -1;
+    }
+    sync_record_write(users_fd);
+    atomic_store(&entry->live, 1); // Publish
+    return user_id;
+}
+
+void user_store_mark_dirty(UserEntry *entry) {
+    if (config.sync == SYNC_ALWAYS) {
+        // Write-through: the caller still holds the entry lock, so writes land in order
+        write_record(&entry->rec);
+        sync_record_write(users_fd);
+        return;
+    }
+    if (entry->dirty) return; // Already queued; the write-back will copy the latest state
+    entry->dirty = 1;
+
+    pthread_mutex_lock(&dirty_lock);
+    if (dirty_count == dirty_capacity) {
+        size_t capacity = dirty_capacity ? dirty_capacity * 2 : 1024;
+        int *grown = realloc(dirty_ids, capacity * sizeof(int));
+        if (grown == NULL) {
+            pthread_mutex_unlock(&dirty_lock);
+            write_record(&entry->rec); // Cannot queue it; write it now instead
+            entry->dirty = 0;
+            return;
+        }
+        dirty_ids = grown;
+        dirty_capacity = capacity;
+    }
+    dirty_ids[dirty_count++] = entry->rec.id;
+    pthread_mutex_unlock(&dirty_lock);
+}
+
+void user_store_flush() {
+    // Take the whole queue; entries changed again meanwhile re-queue themselves
+    pthread_mutex_lock(&dirty_lock);
+    int *ids = dirty_ids;
+    size_t count = dirty_count;
+    dirty_ids = NULL;
+    dirty_count = dirty_capacity = 0;
+    pthread_mutex_unlock(&dirty_lock);
+
+    // Copy each record under its lock, then write the lot in one batch
+    User *copies = malloc(count * sizeof(User));
+    RecordOp *ops = malloc(count * sizeof(RecordOp));
+    for (size_t i = 0; i < count; i++) {
+        UserEntry *entry = user_store_get(ids[i]);
+        pthread_mutex_lock(&entry->lock);
+        User copy = entry->rec;
+        entry->dirty = 0;
+        pthread_mutex_unlock(&entry->lock);
+        if (copies == NULL || ops == NULL) {
+            write_record(&copy);
+            continue;
+        }
+        copies[i] = copy;
+        ops[i] = (RecordOp){ RECORD_WRITE, users_file, &copies[i], sizeof(User), (off_t)(copy.id - 1) * sizeof(User), 0 };
+    }
+    if (copies && ops && count > 0) record_io_submit(ops, count);
+    free(copies);
+    free(ops);
+    free(ids);
+}
+
+static void *writeback_thread(void *arg) {
+    (void)arg;
+    struct timespec period = { config.user_writeback_ms / 1000, (config.user_writeback_ms % 1000) * 1000000L };
+    while (1) {
+        nanosleep(&period, NULL);
+        user_store_flush();
+    }
+    return NULL;
+}
+
+int init_users() {
+    users_fd = open(config.users_file, O_RDWR | O_CREAT, 0666);
+    if (users_fd == -1) {
+        perror("users file");
+        return -1;
+    }
+    users_file = record_io_register(users_fd);
+
+    User batch[256];
+    ssize_t n;
+    off_t offset = 0;
+    int slots = 0;
+    while ((n = record_read(users_file, batch, sizeof(batch), offset)) > 0) {
+        int records = n / sizeof(User);
+        if (records == 0) break; // Trailing partial record
+        for (int i = 0; i < records; i++) {
+            slots++;
+            // Zeroed slots are registrations that never finished writing
+            if (batch[i].username[0] == '\0') continue;
+            batch[i].id = slots; // The file position is the ID
+            UserEntry *entry = new_entry(slots, &batch[i]);
+            if (entry == NULL) {
+                fprintf(stderr, "users file: out of memory at user %d\n", slots);
+                return -1;
+            }
+            atomic_store(&entry->live, 1);
+        }
+        offset += records * sizeof(User);
+    }
+    atomic_store(&next_user_id, slots + 1);
+
+    pthread_rwlock_wrlock(&names_lock);
+    grow_names(slots);
+    for (int id = 1; id <= slots; id++) {
+        if (user_store_get(id)) insert_name(id);
+    }
+    pthread_rwlock_unlock(&names_lock);
+
+    pthread_t tid;
+    pthread_create(&tid, NULL, writeback_thread, NULL);
+    pthread_detach(tid);
+    return 0;
+}
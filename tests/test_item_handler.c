@@ -0,0 +1,120 @@
+#define _GNU_SOURCE // nftw, mkdtemp
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <ftw.h>
+#include "common.h"
+#include "config.h"
+#include "item_handler.h"
+#include "item_store.h"
+#include "record_io.h"
+#include "user_handler.h"
+#include "user_store.h"
+
+// Withdrawal under proxy bidding: the bidder who inherits the lead must be priced like a
+// proxy (one increment over what is left against them), not at their recorded ceiling.
+
+#define SELLER 1
+#define ALICE 2   // Proxy, ceiling 100
+#define BOB 3     // Proxy, ceiling 60
+#define CAROL 4   // Plain bid of 30
+#define START_BALANCE 1000
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+static int seed_users() {
+    int fd = open(config.users_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1) return -1;
+    const char *names[] = { "seller", "alice", "bob", "carol" };
+    User users[4];
+    memset(users, 0, sizeof(users));
+    for (int i = 0; i < 4; i++) {
+        users[i].id = i + 1;
+        strcpy(users[i].username, names[i]);
+        users[i].role = ROLE_USER;
+        users[i].balance = START_BALANCE;
+    }
+    int ok = write(fd, users, sizeof(users)) == sizeof(users);
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+static Item read_item(int item_id) {
+    Item item;
+    memset(&item, 0, sizeof(item));
+    record_read(item_store_file(item_id), &item, sizeof(Item), item_store_offset(item_id));
+    return item;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st; (void)type; (void)ftw;
+    return remove(path);
+}
+
+int main() {
+    char scratch[] = "/tmp/auction-test-XXXXXX";
+    if (mkdtemp(scratch) == NULL || chdir(scratch) == -1) { perror("scratch dir"); return 1; }
+    mkdir("data", 0755);
+    mkdir("logs", 0755);
+
+    if (seed_users() == -1) { perror("seed users"); return 1; }
+    if (record_io_init() == -1 || init_users() == -1 || item_store_init() == -1) return 1;
+    init_items();
+
+    int item_id = create_item("clock", "mantel clock", 10, 60, SELLER, 0, 0);
+    CHECK(item_id == 1);
+
+    CHECK(place_proxy_bid(item_id, ALICE, 100) == 1);
+    CHECK(place_proxy_bid(item_id, BOB, 60) == -8);  // Alice's ceiling defends
+    CHECK(place_bid(item_id, CAROL, 30) == -3);      // Below the price Bob pushed it to
+    Item item = read_item(item_id);
+    CHECK(item.current_winner_id == ALICE);
+    CHECK(item.current_bid == 61);
+    CHECK(get_user_balance(ALICE) == START_BALANCE - 100);
+
+    // Alice withdraws: Bob leads, and with nobody else left he pays one increment over the
+    // base price while his ceiling stays escrowed
+    CHECK(withdraw_bid(item_id, ALICE) == 1);
+    item = read_item(item_id);
+    CHECK(item.current_winner_id == BOB);
+    CHECK(item.current_bid == 11);
+    CHECK(item.winner_max == 60);
+    CHECK(get_user_balance(ALICE) == START_BALANCE);
+    CHECK(get_user_balance(BOB) == START_BALANCE - 60);
+
+    // Bob's proxy still defends up to its ceiling against a plain bid
+    CHECK(place_bid(item_id, CAROL, 30) == -8);
+    item = read_item(item_id);
+    CHECK(item.current_winner_id == BOB);
+    CHECK(item.current_bid == 31);
+    CHECK(get_user_balance(CAROL) == START_BALANCE);
+
+    // Closing charges Bob the price and refunds the rest of his ceiling
+    CHECK(close_auction(item_id, SELLER) == 1);
+    CHECK(get_user_balance(BOB) == START_BALANCE - 31);
+    CHECK(get_user_balance(SELLER) == START_BALANCE + 31);
+
+    // A second item: two proxies and a plain bid still standing under them. After the
+    // leader withdraws, the next proxy pays one increment over the plain bid.
+    item_id = create_item("vase", "blue vase", 10, 60, SELLER, 0, 0);
+    CHECK(place_bid(item_id, CAROL, 20) == 1);
+    CHECK(place_proxy_bid(item_id, BOB, 60) == 1);
+    CHECK(place_proxy_bid(item_id, ALICE, 100) == 1);
+    CHECK(withdraw_bid(item_id, ALICE) == 1);
+    item = read_item(item_id);
+    CHECK(item.current_winner_id == BOB);
+    CHECK(item.current_bid == 21);
+    CHECK(item.winner_max == 60);
+
+    chdir("/");
+    nftw(scratch, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    printf("test_item_handler: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
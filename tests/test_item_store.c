@@ -0,0 +1,127 @@
+#define _GNU_SOURCE // nftw, mkdtemp
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <ftw.h>
+#include "common.h"
+#include "config.h"
+#include "item_store.h"
+#include "record_io.h"
+
+// Migrates an items.dat written in the original record layout (before proxy ceilings,
+// soft close and record versions) and checks every field comes through.
+
+// The original Item, as the first release wrote it
+typedef struct {
+    int id;
+    char name[50];
+    char description[100];
+    int seller_id;
+    int current_winner_id;
+    int base_price;
+    int current_bid;
+    time_t end_time;
+    int status;
+    int past_bidders[MAX_BIDDERS];
+    int past_bid_amounts[MAX_BIDDERS];
+    int past_bidders_count;
+} BaselineItem;
+
+#define RECORDS 3
+
+static Item loaded[RECORDS + 1];
+static int loaded_count = 0;
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+static void collect(Item *items, int count) {
+    for (int i = 0; i < count; i++) {
+        if (items[i].id >= 1 && items[i].id <= RECORDS) loaded[items[i].id] = items[i];
+        loaded_count++;
+    }
+}
+
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st; (void)type; (void)ftw;
+    return remove(path);
+}
+
+int main() {
+    char scratch[] = "/tmp/auction-test-XXXXXX";
+    if (mkdtemp(scratch) == NULL || chdir(scratch) == -1) { perror("scratch dir"); return 1; }
+    mkdir("data", 0755);
+
+    BaselineItem records[RECORDS];
+    memset(records, 0, sizeof(records));
+    for (int i = 0; i < RECORDS; i++) {
+        BaselineItem *r = &records[i];
+        r->id = i + 1;
+        sprintf(r->name, "lamp %d", r->id);
+        strcpy(r->description, "brass, working");
+        r->seller_id = 1;
+        r->current_winner_id = -1;
+        r->base_price = 10 * r->id;
+        r->current_bid = r->base_price;
+        r->end_time = 1700000000 + r->id;
+        r->status = ITEM_ACTIVE;
+    }
+    // Item 2 has two bids and user 3 leading; item 3 was sold to user 2
+    records[1].current_winner_id = 3;
+    records[1].current_bid = 45;
+    records[1].past_bidders[0] = 2; records[1].past_bid_amounts[0] = 30;
+    records[1].past_bidders[1] = 3; records[1].past_bid_amounts[1] = 45;
+    records[1].past_bidders_count = 2;
+    records[2].current_winner_id = 2;
+    records[2].current_bid = 70;
+    records[2].status = ITEM_SOLD;
+
+    int fd = open(config.items_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1 || write(fd, records, sizeof(records)) != sizeof(records)) { perror("items file"); return 1; }
+    close(fd);
+
+    if (record_io_init() == -1) return 1;
+    CHECK(item_store_init() == 0);
+    item_store_load(collect);
+
+    CHECK(loaded_count == RECORDS);
+    for (int id = 1; id <= RECORDS; id++) {
+        Item *item = &loaded[id];
+        BaselineItem *r = &records[id - 1];
+        CHECK(item->id == id);
+        CHECK(strcmp(item->name, r->name) == 0);
+        CHECK(strcmp(item->description, r->description) == 0);
+        CHECK(item->seller_id == 1);
+        CHECK(item->current_winner_id == r->current_winner_id);
+        CHECK(item->base_price == r->base_price);
+        CHECK(item->current_bid == r->current_bid);
+        CHECK(item->end_time == r->end_time);
+        CHECK(item->status == r->status);
+        CHECK(item->past_bidders_count == r->past_bidders_count);
+        CHECK(memcmp(item->past_bidders, r->past_bidders, sizeof(r->past_bidders)) == 0);
+        CHECK(memcmp(item->past_bid_amounts, r->past_bid_amounts, sizeof(r->past_bid_amounts)) == 0);
+        CHECK(item->soft_close_window == 0 && item->soft_close_extend == 0);
+        CHECK(item->version == 1);
+    }
+    // The original layout always held the leader's current bid in escrow
+    CHECK(loaded[1].winner_max == 0);
+    CHECK(loaded[2].winner_max == 45);
+    CHECK(loaded[3].winner_max == 70);
+
+    struct stat st;
+    char moved[CONFIG_PATH_LEN + 16];
+    snprintf(moved, sizeof(moved), "%s.migrated", config.items_file);
+    CHECK(stat(moved, &st) == 0 && st.st_size == sizeof(records));
+    CHECK(stat(config.items_file, &st) == -1);
+
+    chdir("/");
+    nftw(scratch, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    printf("test_item_store: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}